@@ -6,10 +6,29 @@ size_t kBlockSize = 2048;
 
 void Vector::Append(Vector &other, size_t num, size_t offset) {
   assert(count_ + num <= kBlockSize);
+  // A reset vector may still reference the storage of the vector it was sliced from, e.g., a chunk that a compactor
+  // recycles. Writing into it would overwrite the values of that vector, so it gets its own storage first.
+  if (count_ == 0 && data_.use_count() > 1) data_ = AllocateStorage();
+  assert(data_.use_count() == 1);
+
   // current selection vector = [0, 1, 2, ..., count_ - 1]
+  size_t start = count_;
   for (size_t i = 0; i < num; ++i) {
     auto r_idx = other.selection_vector_[i + offset];
-    GetValue(count_++) = other.GetValue(r_idx);
+    GetValue(count_) = other.GetValue(r_idx);
+    selection_vector_[count_] = count_;
+    count_++;
+  }
+
+  auto &counters = CopyCounters::Local();
+  counters.values_ += num;
+  // only a string column has characters to count
+  if (type_ == AttributeType::STRING) {
+    size_t string_bytes = 0;
+    for (size_t i = start; i < count_; ++i) {
+      if (auto *str = std::get_if<string>(&GetValue(i))) string_bytes += str->size();
+    }
+    counters.string_bytes_ += string_bytes;
   }
 }
 
@@ -20,6 +39,7 @@ void Vector::Slice(Vector &other, vector<uint32_t> &selection_vector, size_t cou
     selection_vector_[i + count_] = key_idx;
   }
   count_ += count;
+  CopyCounters::Local().sel_bytes_ += count * sizeof(uint32_t);
 }
 
 void Vector::Reference(Vector &other) {
@@ -58,4 +78,16 @@ void DataChunk::Slice(DataChunk &other, vector<uint32_t> &selection_vector, size
   }
   this->count_ += count;
 }
+
+void DataChunk::Reference(DataChunk &other, size_t offset, size_t count) {
+  assert(types_ == other.types_);
+  for (size_t c = 0; c < data_.size(); ++c) {
+    auto &col = data_[c];
+    auto &other_col = other.data_[c];
+    col.Reference(other_col);
+    for (size_t i = 0; i < count; ++i) col.selection_vector_[i] = other_col.selection_vector_[offset + i];
+    col.count_ = count;
+  }
+  count_ = count;
+}
 }
@@ -16,6 +16,11 @@
 #include <cassert>
 #include <list>
 #include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <thread>
 
 namespace compaction {
 // Some data structures
@@ -39,6 +44,115 @@ enum class AttributeType : uint8_t {
   INVALID = 3
 };
 
+// Byte accounting of the kernels. Each thread counts what its kernels copy and allocate, and a profiled region
+// (RegionProfiler) attributes the difference between its start and its end to its record.
+struct CopyCounters {
+  // values copied, sizeof(Attribute) bytes each
+  size_t values_ = 0;
+  // characters of the copied strings
+  size_t string_bytes_ = 0;
+  // selection vector entries written, in bytes
+  size_t sel_bytes_ = 0;
+  // vector storage allocated, in bytes
+  size_t alloc_bytes_ = 0;
+
+  static inline CopyCounters &Local() {
+    thread_local CopyCounters counters;
+    return counters;
+  }
+};
+
+// Runs fn(0), ..., fn(n_tasks - 1) on [n_threads] threads (all hardware threads if 0), which claim the tasks one by
+// one. Each task must be independent of the others.
+template<class F>
+inline void ParallelFor(size_t n_tasks, const F &fn, size_t n_threads = 0) {
+  if (n_threads == 0) n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  n_threads = std::min(n_threads, n_tasks);
+  std::atomic<size_t> cursor{0};
+  auto work = [&]() {
+    for (size_t task; (task = cursor.fetch_add(1, std::memory_order_relaxed)) < n_tasks;) fn(task);
+  };
+  if (n_threads <= 1) {
+    work();
+    return;
+  }
+  vector<std::thread> threads;
+  for (size_t i = 0; i < n_threads; ++i) threads.emplace_back(work);
+  for (auto &thread : threads) thread.join();
+}
+
+// The live and the peak bytes of the vector storage of all threads. Each thread counts its own bytes, so an allocation
+// writes no shared cache line, and Live() and Peak() merge the counts of the threads. A thread that exits folds its
+// counts into the retired ones. The storage can be freed by another thread than the one that allocated it, so the live
+// bytes of a thread can be negative. Peak() is the sum of the peaks of the threads, an upper bound of the peak of
+// their sum.
+class MemoryCounters {
+ public:
+  static inline void Allocate(size_t bytes) {
+    CopyCounters::Local().alloc_bytes_ += bytes;
+    auto &local = Local();
+    // only this thread writes its counters, so relaxed stores do without a read-modify-write
+    int64_t live = local.live_.load(std::memory_order_relaxed) + int64_t(bytes);
+    local.live_.store(live, std::memory_order_relaxed);
+    if (live > local.peak_.load(std::memory_order_relaxed)) local.peak_.store(live, std::memory_order_relaxed);
+  }
+
+  static inline void Free(size_t bytes) {
+    auto &local = Local();
+    local.live_.store(local.live_.load(std::memory_order_relaxed) - int64_t(bytes), std::memory_order_relaxed);
+  }
+
+  static inline size_t Live() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    int64_t live = retired_live_;
+    for (auto *local : locals_) live += local->live_.load(std::memory_order_relaxed);
+    return std::max<int64_t>(live, 0);
+  }
+
+  static inline size_t Peak() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    int64_t peak = retired_peak_;
+    for (auto *local : locals_) peak += local->peak_.load(std::memory_order_relaxed);
+    return std::max<int64_t>(peak, 0);
+  }
+
+  // Starts a new peak from the live bytes. The threads must not allocate meanwhile.
+  static inline void ResetPeak() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto *local : locals_) local->peak_.store(local->live_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    retired_peak_ = retired_live_;
+  }
+
+ private:
+  struct LocalCounters {
+    std::atomic<int64_t> live_{0};
+    std::atomic<int64_t> peak_{0};
+
+    LocalCounters() {
+      std::lock_guard<std::mutex> lock(mtx_);
+      locals_.push_back(this);
+    }
+
+    ~LocalCounters() {
+      std::lock_guard<std::mutex> lock(mtx_);
+      retired_live_ += live_.load(std::memory_order_relaxed);
+      retired_peak_ += peak_.load(std::memory_order_relaxed);
+      locals_.erase(std::find(locals_.begin(), locals_.end(), this));
+    }
+  };
+
+  static inline LocalCounters &Local() {
+    thread_local LocalCounters counters;
+    return counters;
+  }
+
+  static inline std::mutex mtx_;
+  // the counters of the running threads, and the sums of the threads that exited
+  static inline vector<LocalCounters *> locals_;
+  static inline int64_t retired_live_ = 0;
+  static inline int64_t retired_peak_ = 0;
+};
+
 // The vector uses Row ID.
 class Vector {
  public:
@@ -47,7 +161,7 @@ class Vector {
   vector<uint32_t> selection_vector_;
 
   explicit Vector(AttributeType type)
-      : type_(type), count_(0), selection_vector_(kBlockSize), data_(std::make_shared<vector<Attribute>>(kBlockSize)) {
+      : type_(type), count_(0), selection_vector_(kBlockSize), data_(AllocateStorage()) {
     for (size_t i = 0; i < kBlockSize; ++i) selection_vector_[i] = i;
   }
 
@@ -65,8 +179,27 @@ class Vector {
     count_ = 0;
   }
 
+  // Empties the vector to write [count] values in place: the selection becomes the identity, and the vector gets its
+  // own storage if it shares it, e.g., with the vectors that were sliced from it.
+  inline void Prepare(size_t count) {
+    assert(count <= kBlockSize);
+    if (data_.use_count() > 1) data_ = AllocateStorage();
+    for (size_t i = 0; i < count; ++i) selection_vector_[i] = i;
+    count_ = count;
+  }
+
  private:
   shared_ptr<vector<Attribute>> data_;
+
+  // The storage is shared by the vectors that reference it, and counted as live until the last of them is gone.
+  static inline shared_ptr<vector<Attribute>> AllocateStorage() {
+    size_t bytes = kBlockSize * sizeof(Attribute);
+    MemoryCounters::Allocate(bytes);
+    return shared_ptr<vector<Attribute>>(new vector<Attribute>(kBlockSize), [bytes](vector<Attribute> *data) {
+      MemoryCounters::Free(bytes);
+      delete data;
+    });
+  }
 };
 
 // A data chunk has some columns.
@@ -84,6 +217,9 @@ class DataChunk {
 
   void Slice(DataChunk &other, vector<uint32_t> &selection_vector, size_t count);
 
+  // Points the columns to the tuples [offset, offset + count) of [other], without copying them.
+  void Reference(DataChunk &other, size_t offset, size_t count);
+
   void Reset() {
     count_ = 0;
     for (Vector &col : data_) col.Reset();
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "base.h"
+#include "hash_table.h"
+#include "profiler.h"
+#include "compactor.h"
+#include "filter_operator.h"
+
+using namespace compaction;
+
+// Microbenchmarks of the kernels in isolation. Each benchmark runs over the grid of the parameters it depends on, and
+// prints one CSV line per grid point with the statistics of the per-call time over the repetitions.
+
+// parameter grid
+vector<size_t> kBlockSizes{2048};
+vector<double> kFullness{0.1, 0.5, 1.0};
+vector<size_t> kPayloadLengths{0, 64};
+vector<size_t> kColumns{1, 4};
+vector<size_t> kChainLengths{1, 8};
+
+size_t kRepetitions = 10;
+size_t kIterations = 1000;
+size_t kRHSSize = 1 << 16;
+double kSelectivity = 0.5;
+string kBenchmark;
+
+struct BenchParams {
+  size_t block_size_;
+  double fullness_;
+  size_t payload_length_;
+  size_t n_cols_;
+  size_t chain_length_;
+
+  // the number of tuples in an input chunk
+  inline size_t NumTuples() const { return std::max(size_t(1), size_t(fullness_ * double(block_size_))); }
+};
+
+// One iteration of a benchmark returns the time of its measured part, so that it can prepare its input untimed.
+using Iteration = std::function<double()>;
+
+// Sets up a benchmark for a grid point, and returns its iteration.
+using Setup = std::function<Iteration(const BenchParams &, std::mt19937 &)>;
+
+// parameters that a benchmark depends on
+enum BenchParam : uint8_t { FULLNESS = 1, PAYLOAD = 2, COLUMNS = 4, CHAIN = 8 };
+
+struct Benchmark {
+  string name_;
+  uint8_t params_;
+  Setup setup_;
+};
+
+// a key column, followed by (n_cols - 1) string columns
+vector<AttributeType> ChunkTypes(size_t n_cols) {
+  vector<AttributeType> types{AttributeType::INTEGER};
+  for (size_t i = 1; i < n_cols; ++i) types.push_back(AttributeType::STRING);
+  return types;
+}
+
+// Fills [chunk] with [n] tuples, the keys are drawn by [key].
+void FillChunk(DataChunk &chunk, size_t n, size_t payload_length, const std::function<size_t()> &key) {
+  vector<Attribute> tuple(chunk.types_.size());
+  for (size_t i = 0; i < n; ++i) {
+    tuple[0] = key();
+    for (size_t c = 1; c < tuple.size(); ++c) tuple[c] = string(payload_length, 'x') + std::to_string(i) + "|";
+    chunk.AppendTuple(tuple);
+  }
+}
+
+// A selection vector that keeps [n] of [count] tuples, evenly spread.
+vector<uint32_t> SpreadSelection(size_t n, size_t count) {
+  vector<uint32_t> selection_vector(kBlockSize);
+  for (size_t i = 0; i < n; ++i) selection_vector[i] = uint32_t(i * count / n);
+  return selection_vector;
+}
+
+Iteration SetupAppend(const BenchParams &params, std::mt19937 &gen) {
+  auto types = ChunkTypes(params.n_cols_);
+  auto source = std::make_shared<DataChunk>(types);
+  auto target = std::make_shared<DataChunk>(types);
+  FillChunk(*source, params.NumTuples(), params.payload_length_, [&]() { return size_t(gen()); });
+
+  // With one column, DataChunk::Append is a single Vector::Append.
+  return [source, target]() {
+    target->Reset();
+    Profiler profiler;
+    profiler.Start();
+    target->Append(*source, source->count_);
+    return profiler.Elapsed();
+  };
+}
+
+Iteration SetupSlice(const BenchParams &params, std::mt19937 &gen) {
+  auto types = ChunkTypes(params.n_cols_);
+  auto source = std::make_shared<DataChunk>(types);
+  auto target = std::make_shared<DataChunk>(types);
+  FillChunk(*source, kBlockSize, params.payload_length_, [&]() { return size_t(gen()); });
+  auto selection_vector = std::make_shared<vector<uint32_t>>(SpreadSelection(params.NumTuples(), kBlockSize));
+  size_t n = params.NumTuples();
+
+  return [source, target, selection_vector, n]() {
+    target->Reset();
+    Profiler profiler;
+    profiler.Start();
+    target->Slice(*source, *selection_vector, n);
+    return profiler.Elapsed();
+  };
+}
+
+// The state of a join benchmark: the hash table, and a probe chunk whose keys all hit a chain.
+struct JoinState {
+  vector<AttributeType> types_;
+  unique_ptr<HashTable> ht_;
+  unique_ptr<DataChunk> input_;
+  unique_ptr<DataChunk> result_;
+
+  JoinState(const BenchParams &params, std::mt19937 &gen) : types_(ChunkTypes(params.n_cols_)) {
+    vector<AttributeType> result_types(types_);
+    result_types.push_back(AttributeType::INTEGER);
+    result_types.push_back(AttributeType::STRING);
+
+    ht_ = std::make_unique<HashTable>(kRHSSize, params.chain_length_, params.payload_length_, result_types);
+    input_ = std::make_unique<DataChunk>(types_);
+    result_ = std::make_unique<DataChunk>(result_types);
+
+    // the same keys as in the hash table
+    size_t n_unique = kRHSSize / params.chain_length_ + (kRHSSize % params.chain_length_ != 0);
+    FillChunk(*input_, params.NumTuples(), params.payload_length_, [&]() {
+      return size_t(gen() % n_unique) * (kRHSSize / n_unique);
+    });
+  }
+};
+
+Iteration SetupProbe(const BenchParams &params, std::mt19937 &gen) {
+  auto state = std::make_shared<JoinState>(params, gen);
+  return [state]() {
+    Profiler profiler;
+    profiler.Start();
+    auto ss = state->ht_->Probe(state->input_->data_[0]);
+    return profiler.Elapsed();
+  };
+}
+
+// Drains the scan structure of a probe, the probe itself is not measured.
+Iteration SetupNext(const BenchParams &params, std::mt19937 &gen) {
+  auto state = std::make_shared<JoinState>(params, gen);
+  return [state]() {
+    auto &join_key = state->input_->data_[0];
+    auto ss = state->ht_->Probe(join_key);
+
+    Profiler profiler;
+    profiler.Start();
+    while (ss.HasNext()) ss.Next(join_key, *state->input_, *state->result_);
+    return profiler.Elapsed();
+  };
+}
+
+Iteration SetupCompact(const BenchParams &params, std::mt19937 &gen) {
+  auto types = ChunkTypes(params.n_cols_);
+  auto source = std::make_shared<DataChunk>(types);
+  FillChunk(*source, params.NumTuples(), params.payload_length_, [&]() { return size_t(gen()); });
+  auto compactor = std::make_shared<NaiveCompactor>(types);
+  auto chunk = std::make_shared<unique_ptr<DataChunk>>(std::make_unique<DataChunk>(types));
+
+  // The input is copied rather than sliced, so that no chunk in the compactor references the source.
+  return [source, compactor, chunk]() {
+    (*chunk)->Reset();
+    (*chunk)->Append(*source, source->count_);
+
+    Profiler profiler;
+    profiler.Start();
+    compactor->Compact(*chunk);
+    return profiler.Elapsed();
+  };
+}
+
+Iteration SetupFilter(const BenchParams &params, std::mt19937 &gen) {
+  auto types = ChunkTypes(params.n_cols_);
+  auto input = std::make_shared<DataChunk>(types);
+  auto result = std::make_shared<DataChunk>(types);
+  FillChunk(*input, params.NumTuples(), params.payload_length_, [&]() { return size_t(gen() % 100); });
+  auto filter = std::make_shared<FilterOperator>(kSelectivity);
+
+  auto spike = std::make_shared<RegionProfiler>();
+
+  return [input, result, filter, spike]() {
+    Profiler profiler;
+    profiler.Start();
+    filter->Execute(*input, 0, *result, *spike);
+    return profiler.Elapsed();
+  };
+}
+
+struct Statistics {
+  double mean_;
+  double stddev_;
+  double min_;
+  double median_;
+  double max_;
+
+  explicit Statistics(vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    double sum = 0, sum_sq = 0;
+    for (double v : samples) sum += v;
+    mean_ = sum / double(samples.size());
+    for (double v : samples) sum_sq += (v - mean_) * (v - mean_);
+    stddev_ = samples.size() > 1 ? std::sqrt(sum_sq / double(samples.size() - 1)) : 0;
+    min_ = samples.front();
+    max_ = samples.back();
+    size_t mid = samples.size() / 2;
+    median_ = samples.size() % 2 == 1 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+  }
+};
+
+// Returns the mean time per call, in ns, of each repetition. The first repetition warms up the caches and is dropped.
+vector<double> Measure(const Iteration &iteration) {
+  vector<double> samples;
+  for (size_t r = 0; r <= kRepetitions; ++r) {
+    double time = 0;
+    for (size_t i = 0; i < kIterations; ++i) time += iteration();
+    if (r > 0) samples.push_back(time / double(kIterations) * 1e9);
+  }
+  return samples;
+}
+
+void PrintHeader() {
+  std::cout << "benchmark,block_size,fullness,payload_length,columns,chain_length,tuples,repetitions,iterations,"
+               "mean_ns,stddev_ns,min_ns,median_ns,max_ns,ns_per_tuple\n";
+}
+
+void PrintResult(const Benchmark &benchmark, const BenchParams &params, const Statistics &stats) {
+  std::cout << benchmark.name_ << ',' << params.block_size_ << ',' << params.fullness_ << ','
+            << params.payload_length_ << ',' << params.n_cols_ << ',' << params.chain_length_ << ','
+            << params.NumTuples() << ',' << kRepetitions << ',' << kIterations << ',' << stats.mean_ << ','
+            << stats.stddev_ << ',' << stats.min_ << ',' << stats.median_ << ',' << stats.max_ << ','
+            << stats.mean_ / double(params.NumTuples()) << std::endl;
+}
+
+// Runs [benchmark] over the grid. The parameters it does not depend on stay at their first value.
+void RunBenchmark(const Benchmark &benchmark) {
+  auto first = [&](auto &list, BenchParam param) {
+    return (benchmark.params_ & param) ? list : std::remove_reference_t<decltype(list)>{list.front()};
+  };
+
+  for (size_t block_size : kBlockSizes) {
+    // The vectors are allocated with kBlockSize entries.
+    kBlockSize = block_size;
+    for (double fullness : first(kFullness, FULLNESS)) {
+      for (size_t payload_length : first(kPayloadLengths, PAYLOAD)) {
+        for (size_t n_cols : first(kColumns, COLUMNS)) {
+          for (size_t chain_length : first(kChainLengths, CHAIN)) {
+            BenchParams params{block_size, std::min(fullness, 1.0), payload_length, n_cols, chain_length};
+            std::mt19937 gen(2);
+            auto iteration = benchmark.setup_(params, gen);
+            PrintResult(benchmark, params, Statistics(Measure(iteration)));
+          }
+        }
+      }
+    }
+  }
+}
+
+template<class T>
+vector<T> ParseList(const string &s) {
+  string list = s;
+  if (!list.empty() && list.front() == '[') list = list.substr(1, list.size() - 2); // Ignore brackets
+  std::stringstream ss(list);
+  vector<T> result;
+  string item;
+  while (std::getline(ss, item, ',')) {
+    std::stringstream is(item);
+    T value;
+    if (is >> value) result.push_back(value);
+  }
+  if (result.empty()) throw std::invalid_argument("Empty parameter list: " + s);
+  return result;
+}
+
+void PrintHelp() {
+  std::cerr << "Usage: bench [options]\n";
+  std::cerr << "Options:\n";
+  std::cerr << "  --benchmark [name]          Run only this benchmark: append, slice, probe, next, compact, filter\n";
+  std::cerr << "  --block-size=[list]         Block sizes, Example: --block-size=[1024,2048]\n";
+  std::cerr << "  --fullness=[list]           Input chunk fullness in (0, 1], Example: --fullness=[0.1,0.5,1]\n";
+  std::cerr << "  --payload-length=[list]     Lengths of the string payloads\n";
+  std::cerr << "  --cols-num=[list]           Numbers of columns in the input chunk\n";
+  std::cerr << "  --chain-length=[list]       Numbers of tuples per key in the hash table\n";
+  std::cerr << "  --rhs-size [value]          Number of tuples in the hash table\n";
+  std::cerr << "  --selectivity [value]       Filter selectivity\n";
+  std::cerr << "  --repetitions [value]       Number of measured repetitions\n";
+  std::cerr << "  --iterations [value]        Number of calls per repetition\n";
+}
+
+int ParseParameters(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+
+    if (arg == "--help") {
+      PrintHelp();
+      return 1;
+    } else if (arg == "--benchmark") {
+      if (i + 1 < argc) {
+        kBenchmark = argv[i + 1];
+        i++;
+      }
+    } else if (arg.substr(0, 13) == "--block-size=") {
+      kBlockSizes = ParseList<size_t>(arg.substr(13));
+    } else if (arg.substr(0, 11) == "--fullness=") {
+      kFullness = ParseList<double>(arg.substr(11));
+    } else if (arg.substr(0, 17) == "--payload-length=") {
+      kPayloadLengths = ParseList<size_t>(arg.substr(17));
+    } else if (arg.substr(0, 11) == "--cols-num=") {
+      kColumns = ParseList<size_t>(arg.substr(11));
+    } else if (arg.substr(0, 15) == "--chain-length=") {
+      kChainLengths = ParseList<size_t>(arg.substr(15));
+    } else if (arg == "--rhs-size") {
+      if (i + 1 < argc) {
+        kRHSSize = std::stoi(argv[i + 1]);
+        i++;
+      }
+    } else if (arg == "--selectivity") {
+      if (i + 1 < argc) {
+        kSelectivity = std::stod(argv[i + 1]);
+        i++;
+      }
+    } else if (arg == "--repetitions") {
+      if (i + 1 < argc) {
+        kRepetitions = std::max(1, std::stoi(argv[i + 1]));
+        i++;
+      }
+    } else if (arg == "--iterations") {
+      if (i + 1 < argc) {
+        kIterations = std::max(1, std::stoi(argv[i + 1]));
+        i++;
+      }
+    }
+  }
+  return 0;
+}
+
+// example: bench --benchmark next --fullness=[0.1,1] --chain-length=[1,4,16] --repetitions 20
+int main(int argc, char *argv[]) {
+  if (ParseParameters(argc, argv)) return 0;
+
+  vector<Benchmark> benchmarks{
+      {"append", FULLNESS | PAYLOAD | COLUMNS, SetupAppend},
+      {"slice", FULLNESS | COLUMNS, SetupSlice},
+      {"probe", FULLNESS | CHAIN, SetupProbe},
+      {"next", FULLNESS | PAYLOAD | COLUMNS | CHAIN, SetupNext},
+      {"compact", FULLNESS | PAYLOAD | COLUMNS, SetupCompact},
+      {"filter", FULLNESS | COLUMNS, SetupFilter},
+  };
+
+  PrintHeader();
+  bool found = false;
+  for (auto &benchmark : benchmarks) {
+    if (!kBenchmark.empty() && benchmark.name_ != kBenchmark) continue;
+    found = true;
+    RunBenchmark(benchmark);
+  }
+  if (!found) {
+    std::cerr << "Unknown benchmark: " << kBenchmark << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -2,18 +2,21 @@
 
 namespace compaction {
 void NaiveCompactor::Compact(unique_ptr<DataChunk> &chunk) {
-  if (chunk->count_ == kBlockSize) return;
+  size_t n_input = chunk->count_;
+  if (n_input == kBlockSize) {
+    ZebraProfiler::Get().InsertRecord(hist_id_, n_input, n_input, 0.0);
+    return;
+  }
 
-  Profiler profiler;
+  RegionProfiler profiler;
   profiler.Start();
   {
     // move
     if (chunk->count_ <= kBlockSize - cached_chunk_->count_) {
       cached_chunk_->Append(*chunk, chunk->count_);
 
-      double time = profiler.Elapsed();
-      BeeProfiler::Get().InsertStatRecord("[Naive Compact - Append] " + name_, time);
-      ZebraProfiler::Get().InsertRecord("[Naive Compact - Append] " + name_, chunk->count_, time);
+      double time = profiler.Record(append_id_);
+      ZebraProfiler::Get().InsertRecord(hist_id_, n_input, 0, time);
       chunk->Reset();
       return;
     }
@@ -22,9 +25,7 @@ void NaiveCompactor::Compact(unique_ptr<DataChunk> &chunk) {
     cached_chunk_->Append(*chunk, n_move);
     temp_chunk_->Append(*chunk, chunk->count_ - n_move, n_move);
   }
-  double time = profiler.Elapsed();
-  BeeProfiler::Get().InsertStatRecord("[Naive Compact - Append] " + name_, time);
-  ZebraProfiler::Get().InsertRecord("[Naive Compact - Append] " + name_, chunk->count_, time);
+  double time = profiler.Record(append_id_);
 
   // profiler.Start();
   {
@@ -34,16 +35,18 @@ void NaiveCompactor::Compact(unique_ptr<DataChunk> &chunk) {
     temp_chunk_->Reset();
     // temp_chunk_ = std::make_unique<DataChunk>(chunk->types_);
   }
-  time = profiler.Elapsed();
-  BeeProfiler::Get().InsertStatRecord("[Naive Compact - Fetch] " + name_, time);
-  ZebraProfiler::Get().InsertRecord("[Naive Compact - Fetch] " + name_, chunk->count_, time);
+  time = profiler.Record(fetch_id_);
+  ZebraProfiler::Get().InsertRecord(hist_id_, n_input, chunk->count_, time);
 }
 
-void DynamicCompactor::Compact(unique_ptr<DataChunk> &chunk) {
-  if (chunk->count_ >= compact_threshold_) return;
+bool DynamicCompactor::Compact(unique_ptr<DataChunk> &chunk) {
+  size_t n_input = chunk->count_;
 
-  // Because the compaction threshold can be changed during execution, we must add this code.
-  if (chunk->count_ > kBlockSize - cached_chunk_->count_) return;
+  // Because the compaction threshold can be changed during execution, we must check the cache size as well.
+  if (n_input >= compact_threshold_ || n_input > kBlockSize - cached_chunk_->count_) {
+    ZebraProfiler::Get().InsertRecord(hist_id_, n_input, n_input, 0.0);
+    return false;
+  }
 
   profiler_.Start();
   cached_chunk_->Append(*chunk, chunk->count_);
@@ -53,8 +56,8 @@ void DynamicCompactor::Compact(unique_ptr<DataChunk> &chunk) {
     chunk = std::move(cached_chunk_);
     cached_chunk_ = std::make_unique<DataChunk>(chunk->types_);
   }
-  double time = profiler_.Elapsed();
-  BeeProfiler::Get().InsertStatRecord(name_, time);
-  ZebraProfiler::Get().InsertRecord(name_, chunk->count_, time);
+  double time = profiler_.Record(id_);
+  ZebraProfiler::Get().InsertRecord(hist_id_, n_input, chunk->count_, time);
+  return true;
 }
 }
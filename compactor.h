@@ -18,7 +18,9 @@ class NaiveCompactor {
   explicit NaiveCompactor(vector<AttributeType> &types)
       : cached_chunk_(std::make_unique<DataChunk>(types)),
         temp_chunk_(std::make_unique<DataChunk>(types)),
-        name_("0x" + std::to_string(size_t(this))) {}
+        append_id_(BeeProfiler::Get().Register("[Naive Compact - Append] 0x" + std::to_string(size_t(this)))),
+        fetch_id_(BeeProfiler::Get().Register("[Naive Compact - Fetch] 0x" + std::to_string(size_t(this)))),
+        hist_id_(ZebraProfiler::Get().Register("[Naive Compact]")) {}
 
   void Compact(unique_ptr<DataChunk> &chunk);
 
@@ -27,7 +29,11 @@ class NaiveCompactor {
  private:
   unique_ptr<DataChunk> cached_chunk_;
   unique_ptr<DataChunk> temp_chunk_;
-  const string name_;
+
+  // profiling records
+  const idx_t append_id_;
+  const idx_t fetch_id_;
+  const idx_t hist_id_;
 };
 
 class DynamicCompactor {
@@ -39,9 +45,12 @@ class DynamicCompactor {
  public:
   explicit DynamicCompactor(const vector<AttributeType> &types)
       : cached_chunk_(std::make_unique<DataChunk>(types)),
-        name_("[Dynamic Compact] 0x" + std::to_string(size_t(this))) {}
+        id_(BeeProfiler::Get().Register("[Dynamic Compact] 0x" + std::to_string(size_t(this)))),
+        hist_id_(ZebraProfiler::Get().Register("[Dynamic Compact]")) {}
 
-  void Compact(unique_ptr<DataChunk> &chunk);
+  // Returns true if the chunk was absorbed into the cache (and [chunk] is either empty or the full cache), false if it
+  // was passed through.
+  bool Compact(unique_ptr<DataChunk> &chunk);
 
   inline void Flush(unique_ptr<DataChunk> &chunk) {
     chunk = std::move(cached_chunk_);
@@ -51,7 +60,9 @@ class DynamicCompactor {
   size_t compact_threshold_;
   unique_ptr<DataChunk> cached_chunk_;
 
-  const string name_;
-  Profiler profiler_;
+  // profiling records
+  const idx_t id_;
+  const idx_t hist_id_;
+  RegionProfiler profiler_;
 };
 }
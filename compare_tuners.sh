@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Compare the threshold tuning policies on the same query.
+# Usage: bash ./compare_tuners.sh [options of filter_and_join]
+#   The executable is ./build/filter_and_join of build_versions.sh, or $EXECUTABLE.
+#   e.g. bash ./compare_tuners.sh --join-num 4 --lhs-size 20000000 --payload-length=[0,1000,0,0]
+
+# one executable for all policies: --strategy picks the dynamic compaction at run time
+executable=${EXECUTABLE:-./build/filter_and_join}
+if [ ! -f "${executable}" ]; then
+    echo "Please build the executables first: bash ./build_versions.sh (missing ${executable})"
+    exit 1
+fi
+
+policies=("ucb" "thompson" "contextual" "model")
+
+for policy in "${policies[@]}"; do
+    echo "------------------ ${policy} ------------------"
+    "${executable}" "$@" --strategy logical+dynamic --tuner ${policy} 2>&1 | grep -E "Total Time|Tuner Report"
+done
@@ -0,0 +1,214 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// cost_model.hpp
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+#include "base.h"
+#include "tuner_policy.hpp"
+
+namespace compaction {
+
+// A linear cost function (fixed per-call overhead + per-tuple cost), fitted from a per-chunk-size histogram.
+// The histogram has the same layout as the one in ZebraProfiler: the total time and the number of calls for each
+// chunk size. Old records decay, so the model keeps following the workload.
+class CostModel {
+ public:
+  CostModel() : values_(kBlockSize + 1, 0), cnt_(kBlockSize + 1, 0), fixed_(0), per_tuple_(0), calibrated_(false) {}
+
+  inline void Observe(size_t n_tuples, double time) {
+    assert(n_tuples <= kBlockSize);
+    values_[n_tuples] += time;
+    cnt_[n_tuples] += 1;
+  }
+
+  // Weighted least squares over the histogram bins, then decay the histogram.
+  inline void Fit() {
+    double s_w = 0, s_x = 0, s_y = 0, s_xx = 0, s_xy = 0;
+    for (size_t i = 1; i <= kBlockSize; ++i) {
+      if (cnt_[i] == 0) continue;
+      double w = cnt_[i], x = double(i), y = values_[i] / cnt_[i];
+      s_w += w;
+      s_x += w * x;
+      s_y += w * y;
+      s_xx += w * x * x;
+      s_xy += w * x * y;
+    }
+    if (s_w < kMinRecords) return;
+
+    // The chunk sizes are too concentrated to separate the fixed cost from the per-tuple cost, keep the last fit.
+    double var = s_xx / s_w - (s_x / s_w) * (s_x / s_w);
+    if (var < kMinVariance) return;
+
+    per_tuple_ = std::max(0.0, (s_w * s_xy - s_x * s_y) / (s_w * s_xx - s_x * s_x));
+    fixed_ = std::max(0.0, (s_y - per_tuple_ * s_x) / s_w);
+    calibrated_ = true;
+
+    for (size_t i = 0; i <= kBlockSize; ++i) {
+      values_[i] *= kDecay;
+      cnt_[i] *= kDecay;
+    }
+  }
+
+  inline double Cost(double n_tuples) const { return fixed_ + per_tuple_ * n_tuples; }
+
+  inline double Fixed() const { return fixed_; }
+
+  inline double PerTuple() const { return per_tuple_; }
+
+  inline bool Calibrated() const { return calibrated_; }
+
+  inline void Save(std::ostream &out) const { out << fixed_ << ' ' << per_tuple_ << ' ' << calibrated_ << ' '; }
+
+  inline bool Load(std::istream &in) { return bool(in >> fixed_ >> per_tuple_ >> calibrated_); }
+
+ private:
+  const double kDecay = 0.9;
+  const double kMinRecords = 16;
+  const double kMinVariance = 16;
+
+  vector<double> values_;
+  vector<double> cnt_;
+
+  double fixed_;
+  double per_tuple_;
+  bool calibrated_;
+};
+
+// The cost-model policy picks the compaction threshold analytically. For its compactor, it calibrates
+//  1. the downstream cost of a chunk, i.e., the rest of the pipeline, and
+//  2. the cost of the compactor to absorb a chunk,
+// as well as the distribution of chunk sizes entering the compactor. With a threshold t, chunks smaller than t are
+// copied into the cache and leave it as chunks of about (kBlockSize - t / 2) tuples, so the expected cost per chunk is
+//
+//    sum_{n >= t} p(n) * down(n) + sum_{n < t} p(n) * (copy(n) + n * (down.per_tuple + down.fixed / (kBlockSize - t / 2)))
+//
+// The policy returns the candidate threshold that minimizes it. During the warm-up, it alternates between the smallest
+// and the largest candidate so that both cost functions see a range of chunk sizes.
+class CostModelPolicy : public TunerPolicy {
+ public:
+  explicit CostModelPolicy(const std::vector<size_t> &arms)
+      : sizes_(kBlockSize + 1, 0), value_(arms), arm_(0), n_select_(0), n_observe_(0) {}
+
+  // Returns the arm that minimizes the expected cost
+  size_t SelectArm(const TunerContext & /*context*/) override {
+    if (n_select_ < kWarmup) {
+      return n_select_++ % 2 == 0 ? 0 : value_.size() - 1;
+    }
+    n_select_++;
+
+    if (n_observe_ >= kRefit) Refit();
+    return arm_;
+  }
+
+  void UpdateArm(const TunerContext & /*context*/, size_t /*arm*/, double /*reward*/) override {}
+
+  void Replay(const TunerContext & /*context*/, size_t arm, double /*reward*/) override {
+    if (n_select_++ >= kWarmup) arm_ = arm;
+  }
+
+  std::unique_ptr<TunerPolicy> Clone() const override { return std::make_unique<CostModelPolicy>(*this); }
+
+  bool ObserveCosts() const override { return true; }
+
+  void ObserveChunk(size_t n_tuples) override { sizes_[n_tuples] += 1; }
+
+  void ObserveCompact(size_t n_tuples, double time) override { copy_.Observe(n_tuples, time); }
+
+  void ObserveDownstream(size_t n_tuples, double time) override {
+    down_.Observe(n_tuples, time);
+    n_observe_++;
+  }
+
+  void Save(std::ostream &out) const override {
+    auto policy = Fitted();
+    policy.down_.Save(out);
+    policy.copy_.Save(out);
+    SaveVector(out, policy.sizes_);
+    out << policy.arm_ << ' ';
+  }
+
+  // A saved model that is already calibrated skips the warm-up.
+  bool Load(std::istream &in) override {
+    if (!down_.Load(in) || !copy_.Load(in) || !LoadVector(in, sizes_) || !(in >> arm_)) return false;
+    if (arm_ >= value_.size()) return false;
+    if (down_.Calibrated() && copy_.Calibrated()) n_select_ = kWarmup;
+    return true;
+  }
+
+  void Print(const std::vector<size_t> &values) override {
+    auto policy = Fitted();
+    std::cerr << " [PARAMETERS] Downstream cost: " << policy.down_.Fixed() * 1e9 << " ns + "
+              << policy.down_.PerTuple() * 1e9 << " ns/tuple - Compact cost: " << policy.copy_.Fixed() * 1e9
+              << " ns + " << policy.copy_.PerTuple() * 1e9 << " ns/tuple - Threshold: " << values[policy.arm_] << "\n";
+  }
+
+ private:
+  // A copy that has fitted what has been observed since the last fit, without touching this policy. The policy of
+  // CompactTuner only replays the events of the threads, and never fits them itself.
+  inline CostModelPolicy Fitted() const {
+    CostModelPolicy policy(*this);
+    if (policy.n_observe_ > 0) policy.Refit();
+    return policy;
+  }
+
+  inline void Refit() {
+    n_observe_ = 0;
+    down_.Fit();
+    copy_.Fit();
+    if (down_.Calibrated() && copy_.Calibrated()) arm_ = BestArm();
+  }
+
+  inline size_t BestArm() {
+    // prefix sums of the chunk size distribution
+    vector<double> n_chunk(kBlockSize + 2, 0);
+    vector<double> n_tuple(kBlockSize + 2, 0);
+    for (size_t i = 1; i <= kBlockSize; ++i) {
+      n_chunk[i + 1] = n_chunk[i] + sizes_[i];
+      n_tuple[i + 1] = n_tuple[i] + sizes_[i] * double(i);
+    }
+    double total_chunk = n_chunk[kBlockSize + 1];
+    double total_tuple = n_tuple[kBlockSize + 1];
+    if (total_chunk == 0) return arm_;
+
+    size_t best = arm_;
+    double best_cost = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < value_.size(); ++i) {
+      size_t t = std::min(value_[i], kBlockSize);
+      double small_chunk = n_chunk[t], small_tuple = n_tuple[t];
+      double cost = down_.Fixed() * (total_chunk - small_chunk) + down_.PerTuple() * (total_tuple - small_tuple);
+      cost += copy_.Fixed() * small_chunk + copy_.PerTuple() * small_tuple;
+      cost += small_tuple * (down_.PerTuple() + down_.Fixed() / (kBlockSize - t / 2.0));
+
+      if (cost < best_cost) {
+        best_cost = cost;
+        best = i;
+      }
+    }
+
+    // decay the distribution
+    for (auto &size : sizes_) size *= kDecay;
+    return best;
+  }
+
+  const size_t kWarmup = 8;
+  const size_t kRefit = 64;
+  const double kDecay = 0.9;
+
+  CostModel down_;
+  CostModel copy_;
+  vector<double> sizes_;
+  vector<size_t> value_;
+
+  size_t arm_;
+  size_t n_select_;
+  size_t n_observe_;
+};
+}
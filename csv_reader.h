@@ -0,0 +1,310 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// csv_reader.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+
+#include "base.h"
+#include "data_collection.h"
+#include "mapped_file.h"
+#include "profiler.h"
+
+namespace compaction {
+// Reads a CSV file into a DataCollection on all hardware threads.
+//
+// A row ends with "\n" (or "\r\n"), and its fields are separated by the delimiter; a delimiter at the end of a row
+// (as in the TPC-H dbgen output) is ignored, and so are the blank lines at the end of the file. A field can be quoted
+// with '"', with "" for a quote, but it cannot contain a line break, so that the rows can be found without parsing.
+// There are no NULLs: an INTEGER field is a non-negative integer, and a DOUBLE field a number. The first row is a
+// header if one of its fields does not parse as the type of its column (a number in an INTEGER column makes it a
+// DOUBLE column, if the types are inferred).
+//
+// The file is mapped and cut into byte ranges. The threads count the rows that start in each range, find the first
+// row of each segment of kBlockSize tuples, and then parse the rows of each segment straight into its columns.
+class CSVReader {
+ public:
+  // the rows that the schema is inferred from
+  static constexpr size_t kSampleRows = 1024;
+  // the smallest byte range of a thread
+  static constexpr size_t kMinRangeBytes = 1 << 20;
+
+  // [types]: the types of the columns, or empty to infer them from the first rows
+  CSVReader(const string &path, char delimiter, vector<AttributeType> types = {})
+      : path_(path), file_(path), delimiter_(delimiter), types_(std::move(types)) {}
+
+  unique_ptr<DataCollection> Read() {
+    file_.Advise(0, file_.Size(), MADV_SEQUENTIAL);
+    const char *data = file_.Data();
+    const char *end = TrimBlankLines(data, data + file_.Size());
+    const char *begin = ReadSchema(data, end);
+
+    // Count the rows that start in each byte range. A row starts at [begin], or after a line break.
+    size_t n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t n_ranges = std::max<size_t>(1, std::min<size_t>(n_threads * 8, (end - begin) / kMinRangeBytes));
+    size_t range_size = (end - begin + n_ranges - 1) / n_ranges;
+    auto range_start = [&](size_t r) { return std::min(begin + r * range_size, end); };
+    vector<size_t> first_row(n_ranges + 1, 0);
+    ParallelFor(n_ranges, [&](size_t r) {
+      ForEachRow(range_start(r), range_start(r + 1), begin, [&](const char *) { first_row[r + 1]++; });
+    });
+    for (size_t r = 0; r < n_ranges; ++r) first_row[r + 1] += first_row[r];
+    size_t n_rows = first_row[n_ranges];
+
+    // the first row of each segment
+    vector<const char *> segment_start((n_rows + kBlockSize - 1) / kBlockSize);
+    ParallelFor(n_ranges, [&](size_t r) {
+      size_t row = first_row[r];
+      ForEachRow(range_start(r), range_start(r + 1), begin, [&](const char *pos) {
+        if (row % kBlockSize == 0) segment_start[row / kBlockSize] = pos;
+        row++;
+      });
+    });
+
+    auto table = std::make_unique<DataCollection>(types_);
+    table->Generate(n_rows, [&](DataChunk &segment, size_t start) {
+      const char *pos = segment_start[start / kBlockSize];
+      string scratch;
+      for (size_t i = 0; i < segment.count_; ++i) {
+        if (!ParseRow(pos, end, segment, i, scratch)) {
+          Fail(start + i);
+          return;
+        }
+      }
+    });
+    if (error_row_ != SIZE_MAX) {
+      throw std::runtime_error("Cannot parse the row " + std::to_string(error_row_) + " of the CSV file " + path_ +
+                               ": " + error_);
+    }
+    return table;
+  }
+
+  inline const vector<AttributeType> &Types() const { return types_; }
+
+ private:
+  string path_;
+  MappedFile file_;
+  char delimiter_;
+  vector<AttributeType> types_;
+
+  // the first row that could not be parsed (SIZE_MAX: none), and why
+  std::mutex error_lock_;
+  size_t error_row_ = SIZE_MAX;
+  string error_;
+  static thread_local inline string reason_;
+
+  inline void Fail(size_t row) {
+    std::lock_guard<std::mutex> guard(error_lock_);
+    if (row < error_row_) {
+      error_row_ = row;
+      error_ = reason_;
+    }
+  }
+
+  // The end of the last line of [data, end) that is not blank, i.e., empty or only whitespace.
+  static inline const char *TrimBlankLines(const char *data, const char *end) {
+    const char *last = end;
+    while (last > data && std::isspace(static_cast<unsigned char>(last[-1]))) last--;
+    if (last == data) return data;
+    auto *line_break = static_cast<const char *>(std::memchr(last, '\n', end - last));
+    return line_break == nullptr ? end : line_break + 1;
+  }
+
+  // Calls fn(start of the row) for each row that starts in [lo, hi), in order. [begin] is the start of the file.
+  template<class F>
+  static inline void ForEachRow(const char *lo, const char *hi, const char *begin, const F &fn) {
+    if (lo >= hi) return;
+    if (lo == begin) fn(lo);
+    // a line break at p starts a row at p + 1, if p + 1 is in the range: a break at hi - 1 starts the next range, or
+    // ends the file
+    const char *p = lo == begin ? lo : lo - 1;
+    while (p < hi - 1 && (p = static_cast<const char *>(std::memchr(p, '\n', hi - 1 - p))) != nullptr) fn(++p);
+  }
+
+  // Moves [pos] past the field at [pos], and points [field] to its value. Returns false if the field is the last of
+  // its row. A quoted field with "" is unquoted into [scratch].
+  inline bool NextField(const char *&pos, const char *end, std::string_view &field, string &scratch) const {
+    if (pos < end && *pos == '"') {
+      const char *start = ++pos;
+      bool escaped = false;
+      while (true) {
+        const char *quote = static_cast<const char *>(std::memchr(pos, '"', end - pos));
+        const char *line_break = static_cast<const char *>(std::memchr(pos, '\n', (quote ? quote : end) - pos));
+        if (quote == nullptr || line_break != nullptr) throw std::runtime_error("unterminated quote");
+        pos = quote + 1;
+        if (pos < end && *pos == '"') {
+          escaped = true;
+          pos++;
+          continue;
+        }
+        field = std::string_view(start, quote - start);
+        break;
+      }
+      if (escaped) {
+        scratch.clear();
+        for (size_t i = 0; i < field.size(); ++i) {
+          scratch += field[i];
+          if (field[i] == '"') i++;
+        }
+        field = scratch;
+      }
+      if (pos < end && *pos == '\r') pos++;
+      if (pos == end || *pos == '\n') {
+        if (pos < end) pos++;
+        return false;
+      }
+      if (*pos != delimiter_) throw std::runtime_error("a quoted field must be followed by a delimiter");
+      pos++;
+      return true;
+    }
+
+    const char *start = pos;
+    while (pos < end && *pos != delimiter_ && *pos != '\n') pos++;
+    const char *stop = pos;
+    bool last = pos == end || *pos == '\n';
+    if (last && stop > start && stop[-1] == '\r') stop--;
+    field = std::string_view(start, stop - start);
+    if (pos < end) pos++;
+    return !last;
+  }
+
+  // Whether [field] is a value of [type], and its value, if [value] is given.
+  static inline bool ParseValue(std::string_view field, AttributeType type, Attribute *value) {
+    const char *first = field.data(), *last = field.data() + field.size();
+    if (type == AttributeType::INTEGER) {
+      size_t v;
+      auto result = std::from_chars(first, last, v);
+      if (field.empty() || result.ec != std::errc() || result.ptr != last) return false;
+      if (value != nullptr) *value = v;
+    } else if (type == AttributeType::DOUBLE) {
+      double v;
+      auto result = std::from_chars(first, last, v);
+      if (field.empty() || result.ec != std::errc() || result.ptr != last) return false;
+      if (value != nullptr) *value = v;
+    } else if (value != nullptr) {
+      value->emplace<string>(field);
+    }
+    return true;
+  }
+
+  // Parses the row at [pos] into the tuple [idx] of [chunk], and moves [pos] to the next row. Returns false, and sets
+  // the reason, if the row does not match the types.
+  inline bool ParseRow(const char *&pos, const char *end, DataChunk &chunk, size_t idx, string &scratch) const {
+    try {
+      std::string_view field;
+      for (size_t c = 0; c < types_.size(); ++c) {
+        bool more = NextField(pos, end, field, scratch);
+        if (!ParseValue(field, types_[c], &chunk.data_[c].GetValue(idx))) {
+          reason_ = "the column " + std::to_string(c) + " is not of its type";
+          return false;
+        }
+        if (more == (c + 1 == types_.size())) {
+          // a delimiter at the end of the row is fine
+          if (more && NextRowEnds(pos, end)) return true;
+          reason_ = "expected " + std::to_string(types_.size()) + " columns";
+          return false;
+        }
+      }
+    } catch (std::exception &e) {
+      reason_ = e.what();
+      return false;
+    }
+    return true;
+  }
+
+  // Moves [pos] past the line break, if it is at one.
+  static inline bool NextRowEnds(const char *&pos, const char *end) {
+    if (pos < end && *pos == '\r') pos++;
+    if (pos == end) return true;
+    if (*pos != '\n') return false;
+    pos++;
+    return true;
+  }
+
+  // The fields of the row at [pos], and moves [pos] to the next row.
+  inline vector<string> SplitRow(const char *&pos, const char *end) const {
+    vector<string> fields;
+    std::string_view field;
+    string scratch;
+    bool more = true;
+    while (more) {
+      more = NextField(pos, end, field, scratch);
+      fields.emplace_back(field);
+    }
+    return fields;
+  }
+
+  // Infers the types from the first rows, if they are not given, and decides whether the first row is a header.
+  // Returns the start of the first row of data.
+  inline const char *ReadSchema(const char *data, const char *end) {
+    vector<vector<string>> sample;
+    const char *pos = data;
+    vector<const char *> row_end;
+    while (pos < end && sample.size() < kSampleRows) {
+      sample.push_back(SplitRow(pos, end));
+      row_end.push_back(pos);
+    }
+    if (sample.empty()) {
+      if (types_.empty()) throw std::runtime_error("Cannot infer the columns of the empty CSV file " + path_);
+      return end;
+    }
+
+    bool infer = types_.empty();
+    for (auto &fields : sample) {
+      // a delimiter at the end of the row
+      bool trailing = infer || fields.size() == types_.size() + 1;
+      if (fields.size() > 1 && fields.back().empty() && trailing) fields.pop_back();
+    }
+    if (infer) {
+      // the narrowest type of each column that all rows after the first one (or the first one, if it is alone) fit
+      types_.assign(sample[0].size(), AttributeType::INTEGER);
+      for (size_t r = sample.size() > 1 ? 1 : 0; r < sample.size(); ++r) {
+        for (size_t c = 0; c < types_.size() && c < sample[r].size(); ++c) {
+          if (types_[c] == AttributeType::INTEGER && !ParseValue(sample[r][c], AttributeType::INTEGER, nullptr)) {
+            types_[c] = AttributeType::DOUBLE;
+          }
+          if (types_[c] == AttributeType::DOUBLE && !ParseValue(sample[r][c], AttributeType::DOUBLE, nullptr)) {
+            types_[c] = AttributeType::STRING;
+          }
+        }
+      }
+      // a number in the first row is data, which widens an INTEGER column, rather than the name of the column
+      for (size_t c = 0; c < types_.size() && c < sample[0].size(); ++c) {
+        if (types_[c] == AttributeType::INTEGER && !ParseValue(sample[0][c], AttributeType::INTEGER, nullptr) &&
+            ParseValue(sample[0][c], AttributeType::DOUBLE, nullptr)) {
+          types_[c] = AttributeType::DOUBLE;
+        }
+      }
+    }
+    if (sample[0].size() != types_.size()) {
+      throw std::runtime_error("The CSV file " + path_ + " has " + std::to_string(sample[0].size()) +
+                               " columns, expected " + std::to_string(types_.size()));
+    }
+
+    for (size_t c = 0; c < types_.size(); ++c) {
+      if (!ParseValue(sample[0][c], types_[c], nullptr)) return row_end[0];
+    }
+    return data;
+  }
+};
+
+// Reads the CSV file [path], with the columns [types] (empty: inferred), and reports the load time.
+inline unique_ptr<DataCollection> ReadCSV(const string &path, char delimiter, const vector<AttributeType> &types = {}) {
+  Profiler timer;
+  timer.Start();
+  CSVReader reader(path, delimiter, types);
+  auto table = reader.Read();
+  double time = timer.Elapsed();
+  std::cerr << "[CSV Load]: " << table->NumTuples() << " tuples from " << path << " in " << time << "s\n";
+  return table;
+}
+}
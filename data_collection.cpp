@@ -3,50 +3,94 @@
 
 namespace compaction {
 void compaction::DataCollection::AppendTuple(std::vector<compaction::Attribute> &tuple) {
-  collection_.push_back(tuple);
+  AppendSegment().AppendTuple(tuple);
   ++n_tuples_;
 }
 
 void compaction::DataCollection::AppendChunk(compaction::DataChunk &chunk) {
   assert(types_ == chunk.types_);
-  collection_.resize(chunk.count_ + n_tuples_);
+  RegionProfiler profiler;
+  profiler.Start();
 
-  vector<Attribute> tuple(types_.size());
-  for (size_t i = 0; i < chunk.count_; ++i) {
-    for (size_t j = 0; j < tuple.size(); ++j) {
-      auto idx = chunk.data_[j].selection_vector_[i];
-      tuple[j] = chunk.data_[j].GetValue(idx);
-    }
-    collection_[n_tuples_ + i] = tuple;
+  // Column by column, into the free space of the last segment, and then into new segments.
+  for (size_t offset = 0; offset < chunk.count_;) {
+    auto &segment = AppendSegment();
+    size_t n = std::min(chunk.count_ - offset, kBlockSize - segment.count_);
+    segment.Append(chunk, n, offset);
+    offset += n;
+    n_tuples_ += n;
+  }
+  profiler.Record(append_id_);
+}
+
+void compaction::DataCollection::Merge(compaction::DataCollection &other) {
+  assert(types_ == other.types_);
+  for (size_t i = 0; i < other.segments_.size(); ++i) {
+    offsets_.push_back(n_tuples_ + other.offsets_[i]);
+    segments_.push_back(std::move(other.segments_[i]));
   }
-  n_tuples_ += chunk.count_;
+  n_tuples_ += other.n_tuples_;
+  other.segments_.clear();
+  other.offsets_.clear();
+  other.n_tuples_ = 0;
 }
 
 compaction::DataChunk compaction::DataCollection::FetchChunk(size_t start, size_t end) {
   DataChunk chunk(types_);
-  for (size_t i = start; i < end; ++i) {
-    chunk.AppendTuple(collection_[i]);
-  }
+  ScanChunk(start, end, chunk);
   return chunk;
 }
 
+void compaction::DataCollection::ScanChunk(size_t start, size_t end, compaction::DataChunk &chunk) {
+  size_t segment = FindSegment(start);
+  if (end <= offsets_[segment] + segments_[segment]->count_) {
+    chunk.Reference(*segments_[segment], start - offsets_[segment], end - start);
+    return;
+  }
+
+  // The tuples span several segments, e.g., after a merge: copy them.
+  chunk.Reset();
+  for (size_t idx = start; idx < end;) {
+    segment = FindSegment(idx);
+    size_t offset = idx - offsets_[segment];
+    size_t n = std::min(end - idx, segments_[segment]->count_ - offset);
+    chunk.Append(*segments_[segment], n, offset);
+    idx += n;
+  }
+}
+
+void compaction::DataCollection::FetchTuple(size_t idx, std::vector<compaction::Attribute> &tuple) {
+  size_t segment = FindSegment(idx);
+  size_t offset = idx - offsets_[segment];
+  tuple.resize(types_.size());
+  for (size_t j = 0; j < tuple.size(); ++j) tuple[j] = segments_[segment]->data_[j].GetValue(offset);
+}
+
+compaction::DataChunk &compaction::DataCollection::AppendSegment() {
+  if (segments_.empty() || segments_.back()->count_ == kBlockSize) {
+    offsets_.push_back(n_tuples_);
+    segments_.push_back(std::make_unique<DataChunk>(types_));
+  }
+  return *segments_.back();
+}
+
 void compaction::DataCollection::Print(size_t n_tuple) {
   n_tuple = std::min(n_tuple, n_tuples_);
 
   for (size_t i = 0; i < n_tuple; ++i) {
-    auto &tuple = collection_[i];
-    for (size_t j = 0; j < tuple.size(); ++j) {
+    for (size_t j = 0; j < types_.size(); ++j) {
+      auto &value = GetValue(i, j);
       switch (types_[j]) {
         case AttributeType::INTEGER: {
-          std::cout << std::get<size_t>(tuple[j]) << ", ";
+          std::cout << std::get<size_t>(value) << ", ";
           break;
         }
         case AttributeType::DOUBLE: {
-          std::cout << std::get<double>(tuple[j]) << ", ";
+          std::cout << std::get<double>(value) << ", ";
           break;
         }
         case AttributeType::STRING: {
-          std::cout << std::get<std::string>(tuple[j]) << ", ";
+          std::cout << std::get<std::string>(value) << ", ";
           break;
         }
         case AttributeType::INVALID:break;
@@ -55,4 +99,4 @@ void compaction::DataCollection::Print(size_t n_tuple) {
     std::cout << "\n";
   }
 }
-}
\ No newline at end of file
+}
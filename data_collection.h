@@ -9,26 +9,98 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include "base.h"
+#include "profiler.h"
 
 namespace compaction {
-class DataCollection {
+// A table that a scan reads chunk by chunk: a DataCollection in memory, or a table file (table_file.h).
+class Table {
+ public:
+  virtual ~Table() = default;
+
+  virtual size_t NumTuples() const = 0;
+
+  virtual const vector<AttributeType> &Types() const = 0;
+
+  // Fills [chunk] with the tuples [start, end), at most kBlockSize.
+  virtual void ScanChunk(size_t start, size_t end, DataChunk &chunk) = 0;
+};
+
+// A collection of tuples, stored column by column in segments of up to kBlockSize tuples. A segment is a DataChunk,
+// so that a scan can reference its columns instead of copying them.
+class DataCollection final : public Table {
  public:
-  explicit DataCollection(vector<AttributeType> &types) : types_(types), n_tuples_(0) {}
+  explicit DataCollection(const vector<AttributeType> &types)
+      : types_(types), n_tuples_(0),
+        append_id_(BeeProfiler::Get().Register("[Collect - Append] 0x" + std::to_string(size_t(this)))) {}
 
   void AppendTuple(vector<Attribute> &tuple);
 
   void AppendChunk(DataChunk &chunk);
 
+  // Moves the segments of [other] to the end of this collection.
+  void Merge(DataCollection &other);
+
+  // Adds [n_tuples] tuples to the empty collection, in segments that fill(segment, index of its first tuple) fills
+  // in place, on all hardware threads.
+  template<class F>
+  void Generate(size_t n_tuples, const F &fill) {
+    assert(n_tuples_ == 0);
+    size_t n_segments = (n_tuples + kBlockSize - 1) / kBlockSize;
+    segments_.resize(n_segments);
+    offsets_.resize(n_segments);
+    ParallelFor(n_segments, [&](size_t s) {
+      auto segment = std::make_unique<DataChunk>(types_);
+      size_t start = s * kBlockSize;
+      segment->count_ = std::min(kBlockSize, n_tuples - start);
+      for (auto &col : segment->data_) col.count_ = segment->count_;
+      fill(*segment, start);
+      segments_[s] = std::move(segment);
+      offsets_[s] = start;
+    });
+    n_tuples_ = n_tuples;
+  }
+
+  // Returns the tuples [start, end), at most kBlockSize.
   DataChunk FetchChunk(size_t start, size_t end);
 
-  inline size_t NumTuples() const { return n_tuples_; }
+  // Fills [chunk] with the tuples [start, end), at most kBlockSize. If they are in one segment, the chunk references
+  // its columns instead of copying them, so a scan can reuse one chunk. The segments of a table built tuple by tuple
+  // are aligned to kBlockSize.
+  void ScanChunk(size_t start, size_t end, DataChunk &chunk) override;
+
+  inline Attribute &GetValue(size_t idx, size_t col_id) {
+    size_t segment = FindSegment(idx);
+    return segments_[segment]->data_[col_id].GetValue(idx - offsets_[segment]);
+  }
+
+  // Copies the tuple [idx] into [tuple].
+  void FetchTuple(size_t idx, vector<Attribute> &tuple);
+
+  inline size_t NumTuples() const override { return n_tuples_; }
+
+  inline const vector<AttributeType> &Types() const override { return types_; }
 
   void Print(size_t n_tuple);
 
  private:
   vector<AttributeType> types_;
   size_t n_tuples_;
-  vector<vector<Attribute>> collection_;
+  vector<unique_ptr<DataChunk>> segments_;
+  // the index of the first tuple of each segment
+  vector<size_t> offsets_;
+
+  // profiling records
+  const idx_t append_id_;
+
+  // the segment of the tuple [idx]
+  inline size_t FindSegment(size_t idx) const {
+    return std::upper_bound(offsets_.begin(), offsets_.end(), idx) - offsets_.begin() - 1;
+  }
+
+  // the last segment, or a new one if it is full
+  DataChunk &AppendSegment();
 };
 }
@@ -0,0 +1,222 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Compaction
+//
+// driver.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "setting.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "tracer.h"
+
+// The parts that the drivers (main.cpp, filters_and_joins.cpp, plan_main.cpp, filter_main.cpp) share: the sink at the
+// end of the pipeline, and the command line flags of the settings in setting.h that all of them take.
+namespace compaction {
+
+// The sink of the results: the aggregation if aggregates are given, or else the sort if an order is given, or else
+// the result file if kResultPath is given, or else the collector, which keeps the results if flag_collect_tuples.
+class ResultSinks {
+ public:
+  ResultSinks(const vector<AttributeType> &types, const vector<size_t> &group_by,
+              const vector<AggregateSpec> &aggregates, const vector<SortSpec> &order_by, size_t limit)
+      : result_table_(types), collector_(flag_collect_tuples ? &result_table_ : nullptr) {
+    if (!aggregates.empty()) {
+      aggregate_ = std::make_unique<PhysicalHashAggregate>(types, group_by, aggregates);
+    } else if (!order_by.empty()) {
+      sorted_ = CreateSortedSink(types, order_by, limit);
+    } else if (!kResultPath.empty()) {
+      file_sink_ = std::make_unique<PhysicalFileSink>(types, kResultPath, kResultFormat, kCSVDelimiter);
+    }
+  }
+
+  PhysicalSink &Sink() {
+    if (aggregate_ != nullptr) return *aggregate_;
+    if (sorted_ != nullptr) return *sorted_;
+    if (file_sink_ != nullptr) return *file_sink_;
+    return collector_;
+  }
+
+  // Delivers the results: the results of a file are delivered once the file is written.
+  void Close() {
+    if (file_sink_ != nullptr) file_sink_->Close();
+  }
+
+  void PrintStatistics() const {
+    if (file_sink_ != nullptr) file_sink_->PrintStatistics();
+  }
+
+  // Shows the first results.
+  void Print() {
+    if (flag_collect_tuples) {
+      std::cout << "Number of tuples in the result table: " << result_table_.NumTuples() << "\n";
+      result_table_.Print(8);
+    }
+    if (aggregate_ != nullptr) aggregate_->Print(8);
+    if (sorted_ != nullptr) sorted_->Print(8);
+  }
+
+ private:
+  DataCollection result_table_;
+  ResultCollector collector_;
+  unique_ptr<PhysicalHashAggregate> aggregate_;
+  unique_ptr<SortedSink> sorted_;
+  unique_ptr<PhysicalFileSink> file_sink_;
+};
+
+// Parses the profiling flag at argv[i], if it is one, and moves [i] past its value.
+inline bool ParseProfilingParameter(int argc, char **argv, int &i) {
+  string arg(argv[i]);
+  if (arg == "--perf-counters") {
+    kPerfCounters = true;
+    return true;
+  }
+  if (i + 1 >= argc) return false;
+  if (arg == "--trace") {
+    kTracePath = argv[i + 1];
+  } else if (arg == "--telemetry") {
+    kTelemetryPath = argv[i + 1];
+  } else if (arg == "--telemetry-sample") {
+    // std::stoul takes "-1" as the largest value
+    if (argv[i + 1][0] == '-') throw std::runtime_error("--telemetry-sample must be positive");
+    kTelemetrySample = std::stoul(argv[i + 1]);
+    if (kTelemetrySample == 0) throw std::runtime_error("--telemetry-sample must be positive");
+  } else {
+    return false;
+  }
+  i++;
+  return true;
+}
+
+// Parses the flag at argv[i] that all the pipeline drivers take, if it is one, and moves [i] past its value: the
+// profiling, the tables, the result file, the threads, the strategies, and the tuner.
+inline bool ParseSharedParameter(int argc, char **argv, int &i) {
+  if (ParseProfilingParameter(argc, argv, i)) return true;
+  string arg(argv[i]);
+  if (arg == "--tuner-log") {
+    kTunerLog = true;
+    return true;
+  }
+  if (i + 1 >= argc) return false;
+  if (arg == "--block-size") {
+    kBlockSize = std::stoi(argv[i + 1]);
+  } else if (arg == "--load-table") {
+    kLoadTablePath = argv[i + 1];
+  } else if (arg == "--csv-delimiter") {
+    kCSVDelimiter = argv[i + 1][0];
+  } else if (arg == "--save-table") {
+    kSaveTablePath = argv[i + 1];
+  } else if (arg == "--result-file") {
+    kResultPath = argv[i + 1];
+  } else if (arg == "--result-format") {
+    kResultFormat = ParseResultFormat(argv[i + 1]);
+  } else if (arg == "--threads") {
+    kThreads = std::max(std::stoi(argv[i + 1]), 1);
+  } else if (arg == "--morsel-size") {
+    kMorselSize = std::max(std::stoi(argv[i + 1]), 1);
+  } else if (arg == "--strategy") {
+    kStrategies = Strategy::ParseList(argv[i + 1]);
+  } else if (arg == "--tuner") {
+    string tuner(argv[i + 1]);
+    if (tuner == "ucb") kTuner = TunerType::UCB;
+    else if (tuner == "thompson") kTuner = TunerType::THOMPSON;
+    else if (tuner == "contextual") kTuner = TunerType::CONTEXTUAL;
+    else if (tuner == "model") kTuner = TunerType::COST_MODEL;
+    else throw std::runtime_error("Unknown tuner: " + tuner);
+  } else if (arg == "--tuner-state") {
+    kTunerState = argv[i + 1];
+  } else if (arg == "--tuner-epoch") {
+    // std::stoul takes "-1" as the largest value
+    if (argv[i + 1][0] == '-') throw std::runtime_error("--tuner-epoch must be positive");
+    kTunerEpoch = std::stoul(argv[i + 1]);
+    if (kTunerEpoch == 0) throw std::runtime_error("--tuner-epoch must be positive");
+  } else {
+    return false;
+  }
+  i++;
+  return true;
+}
+
+inline void PrintProfilingHelp() {
+  std::cerr << "  --trace [path]            Write a Chrome trace of the pipeline execution to the file\n";
+  std::cerr << "  --perf-counters           Count cycles, instructions, cache and branch misses per operator\n";
+  std::cerr << "  --telemetry [path]        Write chunk-size telemetry to the JSON file\n";
+  std::cerr << "  --telemetry-sample [N]    Record one of every N chunks (positive)\n";
+}
+
+inline void PrintSharedHelp() {
+  std::cerr << "  --block-size [value]      Default Block Size\n";
+  std::cerr << "  --load-table [path]       Scan the probe table from the table file (or CSV file) instead of generating it\n";
+  std::cerr << "  --csv-delimiter [char]    Field delimiter of the CSV file (default ',')\n";
+  std::cerr << "  --save-table [path]       Write the probe table to the table file\n";
+  std::cerr << "  --result-file [path]      Stream the results to the file instead of dropping them\n";
+  std::cerr << "  --result-format [name]    Format of the result file: binary (a table file) or csv\n";
+  PrintProfilingHelp();
+  std::cerr << "  --threads [value]         Number of worker threads, each with its own pipeline\n";
+  std::cerr << "  --morsel-size [value]     Number of chunks per morsel\n";
+  std::cerr << "  --strategy [list]         Comma-separated compaction strategies, run one after another on the same data\n";
+  std::cerr << "                             none, logical, full, dynamic, logical+full, or logical+dynamic\n";
+  std::cerr << "  --tuner [name]            Tuner of the dynamic compaction threshold\n";
+  std::cerr << "                             ucb, thompson, contextual, or model\n";
+  std::cerr << "  --tuner-epoch [value]     Number of calls per tuning epoch (positive)\n";
+  std::cerr << "  --tuner-state [path]      Warm-start the tuner from the file, and save the learned state to it\n";
+  std::cerr << "  --tuner-log               Print the estimates of the tuner, and write the epochs of each compactor\n";
+  std::cerr << "                             to ./bandit_log_0x<random>/\n";
+}
+
+// Shows the settings of the shared flags.
+inline void PrintSharedSetting() {
+  std::cerr << "Strategy: ";
+  for (size_t i = 0; i < kStrategies.size(); ++i) std::cerr << (i == 0 ? "" : ", ") << kStrategies[i].Name();
+  std::cerr << "\n";
+  std::cerr << "Size of Block: " << kBlockSize << "\n"
+            << "Threads: " << kThreads << "\n"
+            << "Morsel Size: " << kMorselSize << " chunks\n";
+  bool dynamic = std::any_of(kStrategies.begin(), kStrategies.end(),
+                             [](const Strategy &strategy) { return strategy.compact_ == CompactType::DYNAMIC; });
+  if (dynamic) {
+    std::cerr << "Threshold Tuner: " << TunerName(kTuner) << "\n"
+              << "Tuner Epoch: " << kTunerEpoch << "\n";
+  }
+  if (!kResultPath.empty()) std::cerr << "Result File: " << kResultPath << " (" << ResultFormatName(kResultFormat) << ")\n";
+}
+
+// Checks that at most one of the sinks of the flags is given, and shows it.
+inline void PrintSinkSetting() {
+  if (!kAggregates.empty() && !kOrderBy.empty()) throw std::runtime_error("--order-by cannot be combined with --aggregate");
+  if (!kResultPath.empty() && (!kAggregates.empty() || !kOrderBy.empty())) {
+    throw std::runtime_error("--result-file cannot be combined with --aggregate or --order-by");
+  }
+  if (!kOrderBy.empty()) {
+    std::cerr << "Order: by [";
+    for (size_t i = 0; i < kOrderBy.size(); ++i) std::cerr << (i == 0 ? "" : ",") << kOrderBy[i].Name();
+    std::cerr << "]";
+    if (kLimit > 0) std::cerr << " limit " << kLimit;
+    std::cerr << "\n";
+  }
+  if (!kAggregates.empty()) {
+    std::cerr << "Aggregation: group by [";
+    for (size_t i = 0; i < kGroupBy.size(); ++i) std::cerr << (i == 0 ? "" : ",") << kGroupBy[i];
+    std::cerr << "]";
+    for (auto &spec : kAggregates) std::cerr << " " << spec.Name();
+    std::cerr << "\n";
+  }
+}
+
+// Turns on the profilers the flags ask for.
+inline void EnableProfilers() {
+  if (!kTelemetryPath.empty()) ZebraProfiler::Get().Enable(kTelemetryPath, kTelemetrySample);
+  if (kPerfCounters && !PerfCounters::Enable()) std::cerr << "Performance counters are not available.\n";
+  if (!kTracePath.empty()) Tracer::Get().Enable(kTracePath);
+}
+
+// Writes the telemetry and the trace files, if they are on.
+inline void WriteProfiles() {
+  ZebraProfiler::Get().ToJSON();
+  Tracer::Get().ToJSON();
+}
+}
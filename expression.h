@@ -0,0 +1,458 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// expression.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cctype>
+#include <sstream>
+
+#include "base.h"
+#include "profiler.h"
+#include "physical_operator.h"
+
+namespace compaction {
+
+enum class ExpressionType : uint8_t {
+  COLUMN = 0,
+  CONSTANT = 1,
+  ADD = 2,
+  SUBTRACT = 3,
+  MULTIPLY = 4,
+  DIVIDE = 5,
+  EQUAL = 6,
+  NOT_EQUAL = 7,
+  LESS = 8,
+  LESS_EQUAL = 9,
+  GREATER = 10,
+  GREATER_EQUAL = 11,
+  CASE = 12
+};
+
+// The values of an expression for one chunk, dense: the i-th value belongs to the i-th tuple of the chunk.
+struct ExpressionBuffer {
+  AttributeType type_ = AttributeType::INVALID;
+  vector<size_t> ints_ = vector<size_t>(kBlockSize);
+  vector<double> doubles_ = vector<double>(kBlockSize);
+
+  // Converts the values to doubles, if they are integers.
+  inline void AsDouble(size_t count) {
+    if (type_ != AttributeType::INTEGER) return;
+    for (size_t i = 0; i < count; ++i) doubles_[i] = double(ints_[i]);
+    type_ = AttributeType::DOUBLE;
+  }
+};
+
+// The buffers of the nodes of an expression tree, indexed by the node ID.
+struct ExpressionState {
+  vector<ExpressionBuffer> buffers_;
+};
+
+// An expression over the INTEGER and DOUBLE columns of a chunk: column references, constants, arithmetic (+ - * /),
+// comparisons (= != < <= > >=, 1 if true and 0 otherwise), and CASE WHEN ... THEN ... ELSE ... END. Integer
+// arithmetic is unsigned, like the integer attributes, and an integer division by zero gives 0. A node is evaluated
+// for a whole chunk at a time, into the buffer of the node.
+class Expression {
+ public:
+  ExpressionType type_;
+  // COLUMN: the column index
+  size_t col_id_ = 0;
+  // CONSTANT: the value
+  Attribute value_;
+  // the operands; CASE: the condition, then, and else
+  vector<unique_ptr<Expression>> children_;
+
+  // the type of the result and the node ID, set by Bind
+  AttributeType result_type_ = AttributeType::INVALID;
+  size_t id_ = 0;
+
+  explicit Expression(ExpressionType type) : type_(type) {}
+
+  // Resolves the result types against the input schema [types], and numbers the nodes from [n_node]. Returns the
+  // number of nodes so far.
+  inline size_t Bind(const vector<AttributeType> &types, size_t n_node = 0) {
+    for (auto &child : children_) n_node = child->Bind(types, n_node);
+    id_ = n_node++;
+
+    switch (type_) {
+      case ExpressionType::COLUMN: {
+        if (col_id_ >= types.size()) throw std::runtime_error("Column out of range: #" + std::to_string(col_id_));
+        result_type_ = types[col_id_];
+        if (result_type_ != AttributeType::INTEGER && result_type_ != AttributeType::DOUBLE) {
+          throw std::runtime_error("Column must be an integer or a double: #" + std::to_string(col_id_));
+        }
+        break;
+      }
+      case ExpressionType::CONSTANT: {
+        result_type_ = std::holds_alternative<size_t>(value_) ? AttributeType::INTEGER : AttributeType::DOUBLE;
+        break;
+      }
+      case ExpressionType::CASE: {
+        result_type_ = CommonType(children_[1]->result_type_, children_[2]->result_type_);
+        break;
+      }
+      default: {
+        result_type_ = IsComparison() ? AttributeType::INTEGER
+                                      : CommonType(children_[0]->result_type_, children_[1]->result_type_);
+      }
+    }
+    return n_node;
+  }
+
+  // Evaluates the expression for the tuples of [input] into state.buffers_[id_].
+  inline void Evaluate(DataChunk &input, ExpressionState &state) const {
+    for (auto &child : children_) child->Evaluate(input, state);
+    auto &result = state.buffers_[id_];
+    size_t count = input.count_;
+
+    switch (type_) {
+      case ExpressionType::COLUMN: {
+        auto &col = input.data_[col_id_];
+        result.type_ = result_type_;
+        if (result_type_ == AttributeType::INTEGER) Load(col, count, result.ints_);
+        else Load(col, count, result.doubles_);
+        break;
+      }
+      case ExpressionType::CONSTANT: {
+        result.type_ = result_type_;
+        if (result_type_ == AttributeType::INTEGER) std::fill_n(result.ints_.begin(), count, std::get<size_t>(value_));
+        else std::fill_n(result.doubles_.begin(), count, std::get<double>(value_));
+        break;
+      }
+      case ExpressionType::CASE: {
+        auto &cond = state.buffers_[children_[0]->id_];
+        auto &then = state.buffers_[children_[1]->id_];
+        auto &other = state.buffers_[children_[2]->id_];
+        cond.AsDouble(count);
+        result.type_ = result_type_;
+        if (result_type_ == AttributeType::INTEGER) {
+          Select(cond.doubles_, then.ints_, other.ints_, count, result.ints_);
+        } else {
+          then.AsDouble(count);
+          other.AsDouble(count);
+          Select(cond.doubles_, then.doubles_, other.doubles_, count, result.doubles_);
+        }
+        break;
+      }
+      default: {
+        auto &left = state.buffers_[children_[0]->id_];
+        auto &right = state.buffers_[children_[1]->id_];
+        if (CommonType(left.type_, right.type_) == AttributeType::INTEGER) {
+          Binary(left.ints_, right.ints_, count, result);
+        } else {
+          left.AsDouble(count);
+          right.AsDouble(count);
+          Binary(left.doubles_, right.doubles_, count, result);
+        }
+      }
+    }
+  }
+
+  inline string ToString() const {
+    static const char *symbols[] = {"", "", "+", "-", "*", "/", "=", "!=", "<", "<=", ">", ">="};
+    switch (type_) {
+      case ExpressionType::COLUMN: return "#" + std::to_string(col_id_);
+      case ExpressionType::CONSTANT: {
+        std::ostringstream out;
+        if (auto *v = std::get_if<size_t>(&value_)) out << *v;
+        else out << std::get<double>(value_);
+        return out.str();
+      }
+      case ExpressionType::CASE:
+        return "CASE WHEN " + children_[0]->ToString() + " THEN " + children_[1]->ToString() + " ELSE "
+            + children_[2]->ToString() + " END";
+      default:
+        return "(" + children_[0]->ToString() + " " + symbols[uint8_t(type_)] + " " + children_[1]->ToString() + ")";
+    }
+  }
+
+  // Parses an expression, e.g., "CASE WHEN #1 < 100 THEN #1 * 2 ELSE #2 + 0.5 END". #n is the column n.
+  static inline unique_ptr<Expression> Parse(const string &text) {
+    size_t pos = 0;
+    auto expression = ParseCase(text, pos);
+    SkipSpaces(text, pos);
+    if (pos != text.size()) throw std::runtime_error("Unexpected '" + text.substr(pos) + "' in: " + text);
+    return expression;
+  }
+
+  // a ';'-separated list of expressions
+  static inline vector<unique_ptr<Expression>> ParseList(const string &text) {
+    vector<unique_ptr<Expression>> expressions;
+    std::stringstream ss(text);
+    string item;
+    while (std::getline(ss, item, ';')) {
+      if (item.find_first_not_of(' ') != string::npos) expressions.push_back(Parse(item));
+    }
+    if (expressions.empty()) throw std::runtime_error("No expression given");
+    return expressions;
+  }
+
+ private:
+  inline bool IsComparison() const { return type_ >= ExpressionType::EQUAL && type_ <= ExpressionType::GREATER_EQUAL; }
+
+  static inline AttributeType CommonType(AttributeType left, AttributeType right) {
+    return left == AttributeType::INTEGER && right == AttributeType::INTEGER ? AttributeType::INTEGER
+                                                                             : AttributeType::DOUBLE;
+  }
+
+  // Gathers a column into [values]. A dense column (identity selection) skips the selection vector.
+  template<class T>
+  static inline void Load(Vector &col, size_t count, vector<T> &values) {
+    auto &sel = col.selection_vector_;
+    size_t dense = 0;
+    while (dense < count && sel[dense] == dense) dense++;
+    if (dense == count) {
+      for (size_t i = 0; i < count; ++i) values[i] = std::get<T>(col.GetValue(i));
+    } else {
+      for (size_t i = 0; i < count; ++i) values[i] = std::get<T>(col.GetValue(sel[i]));
+    }
+  }
+
+  template<class T>
+  static inline void Select(const vector<double> &cond, const vector<T> &then, const vector<T> &other, size_t count,
+                            vector<T> &result) {
+    for (size_t i = 0; i < count; ++i) result[i] = cond[i] != 0 ? then[i] : other[i];
+  }
+
+  template<class T>
+  inline void Binary(const vector<T> &left, const vector<T> &right, size_t count, ExpressionBuffer &result) const {
+    if (IsComparison()) {
+      result.type_ = AttributeType::INTEGER;
+      Compare(left, right, count, result.ints_);
+      return;
+    }
+    result.type_ = std::is_same_v<T, size_t> ? AttributeType::INTEGER : AttributeType::DOUBLE;
+    auto &out = [&]() -> vector<T> & {
+      if constexpr (std::is_same_v<T, size_t>) return result.ints_;
+      else return result.doubles_;
+    }();
+    switch (type_) {
+      case ExpressionType::ADD:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] + right[i];
+        break;
+      case ExpressionType::SUBTRACT:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] - right[i];
+        break;
+      case ExpressionType::MULTIPLY:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] * right[i];
+        break;
+      case ExpressionType::DIVIDE:
+        if constexpr (std::is_same_v<T, size_t>) {
+          for (size_t i = 0; i < count; ++i) out[i] = right[i] == 0 ? 0 : left[i] / right[i];
+        } else {
+          for (size_t i = 0; i < count; ++i) out[i] = left[i] / right[i];
+        }
+        break;
+      default: break;
+    }
+  }
+
+  template<class T>
+  inline void Compare(const vector<T> &left, const vector<T> &right, size_t count, vector<size_t> &out) const {
+    switch (type_) {
+      case ExpressionType::EQUAL:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] == right[i];
+        break;
+      case ExpressionType::NOT_EQUAL:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] != right[i];
+        break;
+      case ExpressionType::LESS:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] < right[i];
+        break;
+      case ExpressionType::LESS_EQUAL:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] <= right[i];
+        break;
+      case ExpressionType::GREATER:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] > right[i];
+        break;
+      case ExpressionType::GREATER_EQUAL:
+        for (size_t i = 0; i < count; ++i) out[i] = left[i] >= right[i];
+        break;
+      default: break;
+    }
+  }
+
+  // ------------------------------------------- Parser -------------------------------------------
+  // case       := CASE WHEN case THEN case ELSE case END | comparison
+  // comparison := additive [(= | != | < | <= | > | >=) additive]
+  // additive   := term {(+ | -) term}
+  // term       := factor {(* | /) factor}
+  // factor     := #<column> | <number> | ( case )
+
+  static inline void SkipSpaces(const string &text, size_t &pos) {
+    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+  }
+
+  // Consumes [token] if the text continues with it. A keyword must not be followed by a letter.
+  static inline bool Accept(const string &text, size_t &pos, const string &token) {
+    SkipSpaces(text, pos);
+    if (text.compare(pos, token.size(), token) != 0) return false;
+    size_t end = pos + token.size();
+    if (std::isalpha(static_cast<unsigned char>(token[0])) && end < text.size()
+        && std::isalnum(static_cast<unsigned char>(text[end]))) {
+      return false;
+    }
+    pos = end;
+    return true;
+  }
+
+  static inline void Expect(const string &text, size_t &pos, const string &token) {
+    if (!Accept(text, pos, token)) throw std::runtime_error("Expected '" + token + "' at " + std::to_string(pos) + " in: " + text);
+  }
+
+  static inline unique_ptr<Expression> MakeNode(ExpressionType type, unique_ptr<Expression> left,
+                                                unique_ptr<Expression> right) {
+    auto node = std::make_unique<Expression>(type);
+    node->children_.push_back(std::move(left));
+    node->children_.push_back(std::move(right));
+    return node;
+  }
+
+  static inline unique_ptr<Expression> ParseCase(const string &text, size_t &pos) {
+    if (!Accept(text, pos, "CASE")) return ParseComparison(text, pos);
+    auto node = std::make_unique<Expression>(ExpressionType::CASE);
+    Expect(text, pos, "WHEN");
+    node->children_.push_back(ParseCase(text, pos));
+    Expect(text, pos, "THEN");
+    node->children_.push_back(ParseCase(text, pos));
+    Expect(text, pos, "ELSE");
+    node->children_.push_back(ParseCase(text, pos));
+    Expect(text, pos, "END");
+    return node;
+  }
+
+  static inline unique_ptr<Expression> ParseComparison(const string &text, size_t &pos) {
+    auto left = ParseAdditive(text, pos);
+    // the two-character operators first
+    static const std::pair<const char *, ExpressionType> operators[] = {
+        {"!=", ExpressionType::NOT_EQUAL}, {"<=", ExpressionType::LESS_EQUAL}, {">=", ExpressionType::GREATER_EQUAL},
+        {"=", ExpressionType::EQUAL}, {"<", ExpressionType::LESS}, {">", ExpressionType::GREATER}};
+    for (auto &op : operators) {
+      if (Accept(text, pos, op.first)) return MakeNode(op.second, std::move(left), ParseAdditive(text, pos));
+    }
+    return left;
+  }
+
+  static inline unique_ptr<Expression> ParseAdditive(const string &text, size_t &pos) {
+    auto left = ParseTerm(text, pos);
+    while (true) {
+      if (Accept(text, pos, "+")) left = MakeNode(ExpressionType::ADD, std::move(left), ParseTerm(text, pos));
+      else if (Accept(text, pos, "-")) left = MakeNode(ExpressionType::SUBTRACT, std::move(left), ParseTerm(text, pos));
+      else return left;
+    }
+  }
+
+  static inline unique_ptr<Expression> ParseTerm(const string &text, size_t &pos) {
+    auto left = ParseFactor(text, pos);
+    while (true) {
+      if (Accept(text, pos, "*")) left = MakeNode(ExpressionType::MULTIPLY, std::move(left), ParseFactor(text, pos));
+      else if (Accept(text, pos, "/")) left = MakeNode(ExpressionType::DIVIDE, std::move(left), ParseFactor(text, pos));
+      else return left;
+    }
+  }
+
+  static inline unique_ptr<Expression> ParseFactor(const string &text, size_t &pos) {
+    if (Accept(text, pos, "(")) {
+      auto node = ParseCase(text, pos);
+      Expect(text, pos, ")");
+      return node;
+    }
+    if (Accept(text, pos, "CASE")) {
+      pos -= 4;
+      return ParseCase(text, pos);
+    }
+
+    bool column = Accept(text, pos, "#");
+    size_t start = pos;
+    while (pos < text.size() && (std::isdigit(static_cast<unsigned char>(text[pos])) || text[pos] == '.')) pos++;
+    if (start == pos) throw std::runtime_error("Expected an operand at " + std::to_string(pos) + " in: " + text);
+    string number = text.substr(start, pos - start);
+
+    if (column) {
+      auto node = std::make_unique<Expression>(ExpressionType::COLUMN);
+      node->col_id_ = std::stoul(number);
+      return node;
+    }
+    auto node = std::make_unique<Expression>(ExpressionType::CONSTANT);
+    if (number.find('.') == string::npos) node->value_ = size_t(std::stoul(number));
+    else node->value_ = std::stod(number);
+    return node;
+  }
+};
+
+// Appends a column per expression to its input. The input columns are passed on without copying values.
+class PhysicalProjection : public PhysicalOperator {
+ public:
+  PhysicalProjection(const vector<AttributeType> &input_types, vector<unique_ptr<Expression>> expressions)
+      : PhysicalOperator("Projection", input_types), n_input_cols_(input_types.size()),
+        expressions_(std::move(expressions)),
+        evaluate_id_(BeeProfiler::Get().Register("[Projection - Evaluate]")),
+        hist_id_(ZebraProfiler::Get().Register("[Projection]")) {
+    for (auto &expression : expressions_) {
+      n_node_ = expression->Bind(input_types, n_node_);
+      types_.push_back(expression->result_type_);
+    }
+  }
+
+  struct ProjectionState : public OperatorState {
+    ExpressionState expressions_;
+    vector<uint32_t> identity_ = vector<uint32_t>(kBlockSize);
+    RegionProfiler profiler_;
+
+    explicit ProjectionState(size_t n_node) {
+      expressions_.buffers_.resize(n_node);
+      for (size_t i = 0; i < kBlockSize; ++i) identity_[i] = i;
+    }
+  };
+
+  unique_ptr<OperatorState> GetState() const override { return std::make_unique<ProjectionState>(n_node_); }
+
+  OperatorResultType Execute(DataChunk &input, DataChunk &output, OperatorState &state) const override {
+    auto &local = static_cast<ProjectionState &>(state);
+    output.Reset();
+    output.Slice(input, local.identity_, input.count_);
+
+    local.profiler_.Start();
+    for (size_t e = 0; e < expressions_.size(); ++e) {
+      auto &expression = *expressions_[e];
+      expression.Evaluate(input, local.expressions_);
+      Store(local.expressions_.buffers_[expression.id_], input.count_, output.data_[n_input_cols_ + e]);
+    }
+    double time = local.profiler_.Record(evaluate_id_);
+    ZebraProfiler::Get().InsertRecord(hist_id_, input.count_, input.count_, time);
+    return OperatorResultType::NEED_MORE_INPUT;
+  }
+
+  // the expressions, e.g., for the settings
+  inline string ToString() const {
+    string text;
+    for (auto &expression : expressions_) text += (text.empty() ? "" : "; ") + expression->ToString();
+    return text;
+  }
+
+ private:
+  size_t n_input_cols_;
+  vector<unique_ptr<Expression>> expressions_;
+  size_t n_node_ = 0;
+
+  // profiling records
+  const idx_t evaluate_id_;
+  const idx_t hist_id_;
+
+  // Writes the values into a dense column of the output.
+  static inline void Store(const ExpressionBuffer &buffer, size_t count, Vector &col) {
+    if (buffer.type_ == AttributeType::INTEGER) {
+      for (size_t i = 0; i < count; ++i) col.GetValue(i) = buffer.ints_[i];
+    } else {
+      for (size_t i = 0; i < count; ++i) col.GetValue(i) = buffer.doubles_[i];
+    }
+    for (size_t i = 0; i < count; ++i) col.selection_vector_[i] = i;
+    col.count_ = count;
+    CopyCounters::Local().values_ += count;
+  }
+};
+}
@@ -1,18 +1,21 @@
 #include <iostream>
-#include <random>
 #include <cstring>
 
 #include "base.h"
 #include "data_collection.h"
 #include "profiler.h"
 #include "setting.h"
-#include "filter_operator.h"
+#include "driver.h"
+#include "pipeline.h"
+#include "generator.h"
+#include "tracer.h"
 
 using namespace compaction;
 
 void ParseParameters(int argc, char **argv) {
   if (argc != 1) {
     for (int i = 1; i < argc; i++) {
+      if (ParseProfilingParameter(argc, argv, i)) continue;
       std::string arg(argv[i]);
 
       if (arg == "--cols-num") {
@@ -30,11 +33,36 @@ void ParseParameters(int argc, char **argv) {
           kTupleSize = std::stoi(argv[i + 1]);
           i++;
         }
+      } else if (arg == "--seed") {
+        if (i + 1 < argc) {
+          kSeed = std::stoull(argv[i + 1]);
+          i++;
+        }
       } else if (arg == "--filter-num") {
         if (i + 1 < argc) {
           kFilter = std::stoi(argv[i + 1]);
           i++;
         }
+      } else if (arg == "--group-by") {
+        if (i + 1 < argc) {
+          kGroupBy = ParseColumns(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--aggregate") {
+        if (i + 1 < argc) {
+          kAggregates = AggregateSpec::ParseList(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--order-by") {
+        if (i + 1 < argc) {
+          kOrderBy = SortSpec::ParseList(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--limit") {
+        if (i + 1 < argc) {
+          kLimit = std::stoul(argv[i + 1]);
+          i++;
+        }
       }
     }
   }
@@ -46,68 +74,30 @@ void ParseParameters(int argc, char **argv) {
             << "Number of Columns: " << kCols << "\n"
             << "Filter Selectivity: " << kSelectivity << "\n"
             << "Number of Tuples: " << kTupleSize << "\n";
-}
-
-struct PipelineState {
-  vector<unique_ptr<DataChunk>> intermediates;
-  vector<unique_ptr<FilterOperator>> filters_;
-
-  explicit PipelineState(size_t num_operator) : filters_(num_operator), intermediates(num_operator) {}
-};
-
-void ExecutePipeline(DataChunk &input, PipelineState &state, DataCollection &result_table, size_t level) {
-  if (input.count_ == 0) return;
-
-  auto &filters = state.filters_;
-  auto &intermediates = state.intermediates;
-
-  // The last operator: ResultCollector
-  if (level == filters.size()) {
-    if (flag_collect_tuples) result_table.AppendChunk(input);
-    return;
-  }
-
-  auto &result = intermediates[level];
-  filters[level]->Execute(input, level, *result);
-
-  ExecutePipeline(*result, state, result_table, level + 1);
+  PrintSinkSetting();
 }
 
 // example: filter --filter-num 1 --cols-num 100 --selectivity 0.2 --tuple-size 2000000
 int main(int argc, char *argv[]) {
   ParseParameters(argc, argv);
-
-  // random generator
-  std::random_device rd;
-  std::mt19937 gen(2);
-  // integer value are in [0, 100), so that I can control the filter selectivity
-  std::uniform_int_distribution<> dist(0, 100);
+  EnableProfilers();
 
   // ---------------------------------------------- Query Setting ----------------------------------------------
 
-  // create table: (id1, id2, ..., idn, miscellaneous)
-  vector<AttributeType> types;
-  for (size_t i = 0; i < kCols; ++i) types.push_back(AttributeType::INTEGER);
-  types.push_back(AttributeType::STRING);
+  // create table: (id1, id2, ..., idn, miscellaneous). The integers are in [0, 100], so that I can control the filter
+  // selectivity.
+  vector<ColumnSpec> columns(kCols, ColumnSpec::Uniform(0, 100));
+  columns.push_back(ColumnSpec::String("|"));
+  vector<AttributeType> types = ColumnTypes(columns);
   compaction::DataCollection table(types);
-  vector<compaction::Attribute> tuple(kCols + 1);
-  tuple[kCols] = "|";
-  for (size_t i = 0; i < kTupleSize; ++i) {
-    for (size_t j = 0; j < kCols; ++j) tuple[j] = size_t(dist(gen));
-    table.AppendTuple(tuple);
-  }
+  GenerateTable(table, columns, kTupleSize, kSeed);
 
-  // create filter operator: selectivity.
-  PipelineState state(kFilter);
-  auto &filters = state.filters_;
-  auto &intermediates = state.intermediates;
-  for (size_t i = 0; i < kFilter; ++i) {
-    filters[i] = std::make_unique<FilterOperator>(kSelectivity);
-    intermediates[i] = std::make_unique<DataChunk>(types);
-  }
+  // collect, aggregate, or order the results
+  ResultSinks sinks(types, kGroupBy, kAggregates, kOrderBy, kLimit);
+  Pipeline<> pipeline(sinks.Sink());
 
-  // create the result_table collection
-  DataCollection result_table(types);
+  // create filter operators: selectivity. The filter at level i filters on the column i.
+  for (size_t i = 0; i < kFilter; ++i) pipeline.AddOperator(std::make_unique<PhysicalFilter>(kSelectivity, i, types));
 
   // -----------------------------------------------------------------------------------------------------------
   vector<DataChunk> buffers;
@@ -126,22 +116,24 @@ int main(int argc, char *argv[]) {
       start = end;
 
       timer.Start();
-      ExecutePipeline(chunk, state, result_table, 0);
+      pipeline.Execute(chunk);
       latency += timer.Elapsed();
 
       buffers.push_back(chunk);
     } while (end < kTupleSize);
+
+    timer.Start();
+    pipeline.Finish();
+    latency += timer.Elapsed();
   }
 
   std::cerr << "------------------ Statistic ------------------\n";
   std::cerr << "[Total Time]: " << latency << "s\n";
   BeeProfiler::Get().EndProfiling();
+  ZebraProfiler::Get().EndSection(Strategy{false, CompactType::NONE}.Name());
+  WriteProfiles();
 
-  if (flag_collect_tuples) {
-    // show the joined result.
-    std::cout << "Number of tuples in the result table: " << result_table.NumTuples() << "\n";
-    result_table.Print(8);
-  }
+  sinks.Print();
 
   return 0;
 }
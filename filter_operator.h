@@ -1,14 +1,20 @@
 #pragma once
 
 #include "base.h"
+#include "profiler.h"
 
 namespace compaction {
 
 class FilterOperator {
  public:
-  explicit FilterOperator(double selectivity) : selectivity_(selectivity), threshold_(100 * selectivity) {}
-
-  void Execute(DataChunk &input, size_t col_id, DataChunk &result) {
+  explicit FilterOperator(double selectivity)
+      : selectivity_(selectivity), threshold_(100 * selectivity),
+        update_sel_vec_(BeeProfiler::Get().Register("[Filter - Update Sel Vector]")),
+        evaluate_expression_(BeeProfiler::Get().Register("[Filter - Evaluate Expression]")),
+        hist_id_(ZebraProfiler::Get().Register("[Filter]")) {}
+
+  // [profiler] times the filter. It belongs to the caller, so that the threads can share the operator.
+  void Execute(DataChunk &input, size_t col_id, DataChunk &result, RegionProfiler &profiler) const {
     result.Reset();
 
     auto &target_col = input.data_[col_id];
@@ -16,17 +22,18 @@ class FilterOperator {
     size_t result_count = 0;
     vector<uint32_t> result_vector(kBlockSize);
 
-    spike_.Start();
+    profiler.Start();
     for (size_t i = 0; i < input.count_; i++) {
       size_t idx = target_col.selection_vector_[i];
       auto &value = target_col.GetValue(idx);
       if (CheckIfPass(value)) result_vector[result_count++] = i;
     }
-    BeeProfiler::Get().InsertStatRecord(evaluate_expression, spike_.Elapsed());
+    double time = profiler.Record(evaluate_expression_);
 
-    spike_.Start();
+    profiler.Start();
     result.Slice(input, result_vector, result_count);
-    BeeProfiler::Get().InsertStatRecord(update_sel_vec, spike_.Elapsed());
+    double slice_time = profiler.Record(update_sel_vec_);
+    ZebraProfiler::Get().InsertRecord(hist_id_, input.count_, result_count, time + slice_time);
   }
 
   bool CheckIfPass(Attribute &value) const {
@@ -39,8 +46,8 @@ class FilterOperator {
   double selectivity_;
   int threshold_;
 
-  Profiler spike_;
-  string update_sel_vec = "[Filter - Update Sel Vector]";
-  string evaluate_expression = "[Filter - Evaluate Expression]";
+  const idx_t update_sel_vec_;
+  const idx_t evaluate_expression_;
+  const idx_t hist_id_;
 };
 }
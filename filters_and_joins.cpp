@@ -1,30 +1,35 @@
 #include <iostream>
-#include <random>
 #include <cstring>
 
 #include "base.h"
 #include "hash_table.h"
 #include "data_collection.h"
 #include "profiler.h"
-#include "compactor.h"
 #include "setting.h"
-#include "filter_operator.h"
+#include "driver.h"
+#include "pipeline.h"
+#include "expression.h"
+#include "table_file.h"
+#include "tracer.h"
 
 using namespace compaction;
 
-struct PipelineState {
-  vector<unique_ptr<FilterOperator>> filters;
+// The data of the query: the hash tables, the schema of the result of each operator, and the schema after the
+// projection that follows the operator, if any. They are built once, and shared by the pipelines of all strategies.
+struct QueryState {
   vector<unique_ptr<HashTable>> hts;
-  vector<unique_ptr<DataChunk>> intermediates;
-  vector<unique_ptr<Compactor>> compactors;
+  vector<vector<AttributeType>> types;
+  vector<vector<AttributeType>> projected_types;
 
-  explicit PipelineState(size_t n_operator)
-      : filters(n_operator), hts(n_operator), intermediates(n_operator), compactors(n_operator) {}
+  explicit QueryState(size_t n_operator) : hts(n_operator), types(n_operator), projected_types(n_operator) {}
+
+  bool Projects(size_t level) const { return projected_types[level].size() != types[level].size(); }
 };
 
-static void ExecutePipeline(DataChunk &input, PipelineState &state, DataCollection &result_table, size_t level);
+template<bool kLogical, CompactType kCompact>
+void RunPipeline(QueryState &query, Table &table);
 
-void FlushPipelineCache(PipelineState &state, DataCollection &result_table, size_t level);
+string PipelineSignature(const QueryState &query, size_t level, bool logical);
 
 std::vector<size_t> ParseList(const std::string &s);
 
@@ -33,206 +38,165 @@ int ParseParameters(int argc, char *argv[]);
 // example: compaction --join-num 4 --chunk-factor 5 --lhs-size 20000000 --rhs-size 2000000 --load-factor 0.5 --payload-length=[0,0,0,0]
 int main(int argc, char *argv[]) {
   if (ParseParameters(argc, argv)) return 0;
+  EnableProfilers();
 
-  // random generator
-  std::random_device rd;
-  std::mt19937 gen(2);
-  std::uniform_int_distribution<> dist(0, kRHSTupleSize);
-  std::uniform_int_distribution<> dist_filter(0, 100);
   size_t n_operator = kJoins + 1;
 
   // ---------------------------------------------- Query Setting ----------------------------------------------
 
-  // create probe table: (id1, id2, ..., idn, miscellaneous)
-  vector<AttributeType> types;
-  for (size_t i = 0; i < n_operator; ++i) types.push_back(AttributeType::INTEGER);
-  types.push_back(AttributeType::STRING);
-  compaction::DataCollection table(types);
-  vector<compaction::Attribute> tuple(n_operator + 1);
-  tuple[n_operator] = "|";
-  for (size_t i = 0; i < kLHSTupleSize; ++i) {
-    tuple[0] = size_t(dist_filter(gen));
-    for (size_t j = 1; j < n_operator; ++j) tuple[j] = size_t(dist(gen));
-    table.AppendTuple(tuple);
-  }
-
-  // create rhs hash table, and the result_table chunk
-  PipelineState state(n_operator);
-  auto &hts = state.hts;
-  auto &filters = state.filters;
-  auto &intermediates = state.intermediates;
-  auto &compactors = state.compactors;
-
-  filters[0] = std::make_unique<FilterOperator>(kSelectivity);
-  intermediates[0] = std::make_unique<DataChunk>(types);
-  compactors[0] = std::make_unique<Compactor>(types);
+  // create probe table: (id1, id2, ..., idn, miscellaneous). The filter column is in [0, 100].
+  vector<ColumnSpec> columns{ColumnSpec::Uniform(0, 100)};
   for (size_t i = 1; i < n_operator; ++i) {
-    types.push_back(AttributeType::INTEGER);
-    types.push_back(AttributeType::STRING);
-    intermediates[i] = std::make_unique<DataChunk>(types);
-    compactors[i] = std::make_unique<Compactor>(types);
-    hts[i] = std::make_unique<HashTable>(kRHSTupleSize, kChunkFactor, kRHSPayLoadLength[i - 1], types, kLoadFactor);
+    columns.push_back(ColumnSpec::JoinKey(0, kRHSTupleSize, kProbeDistribution, 1, i == 1 ? 0 : kKeyCorrelation));
   }
-
-  // create the result_table collection
-  DataCollection result_table(types);
-#ifdef flag_dynamic_compact
-  // create MAB for each join operator
-  for (size_t i = 0; i < n_operator; ++i) CompactTuner::Get().Initialize(size_t(&state.compactors[i]));
-#endif
-
-  // -----------------------------------------------------------------------------------------------------------
-
-  double latency = 0;
-  Profiler timer;
-  {
-    // Start process each chunk in the lhs table
-    size_t num_chunk_size = kBlockSize;
-    size_t start = 0;
-    size_t end;
-    do {
-      end = std::min(start + num_chunk_size, kLHSTupleSize);
-      // num_chunk_size = (num_chunk_size + 1) % kBlockSize;
-      DataChunk chunk = table.FetchChunk(start, end);
-      start = end;
-
-      timer.Start();
-      ExecutePipeline(chunk, state, result_table, 0);
-      latency += timer.Elapsed();
-    } while (end < kLHSTupleSize);
-
-#if defined(flag_full_compact) || defined(flag_dynamic_compact)
-    timer.Start();
-    {
-      FlushPipelineCache(state, result_table, 0);
+  columns.push_back(ColumnSpec::String("|"));
+  vector<AttributeType> types = ColumnTypes(columns);
+  auto table = CreateTable(columns, kLHSTupleSize, kSeed, kLoadTablePath, kSaveTablePath, kCSVDelimiter);
+
+  // create the rhs hash tables, and the schema of each operator result. The columns of a projection come after the
+  // columns of the operator it follows, and are passed on to the later operators.
+  QueryState query(n_operator);
+  for (size_t i = 0; i < n_operator; ++i) {
+    if (i > 0) {
+      types.push_back(AttributeType::INTEGER);
+      types.push_back(AttributeType::STRING);
+      query.hts[i] = std::make_unique<HashTable>(kRHSTupleSize, kChunkFactor, kRHSPayLoadLength[i - 1], types,
+                                                 kLoadFactor, kBuildDistribution, kSeed + i);
     }
-    latency += timer.Elapsed();
-#endif
+    query.types[i] = types;
+    if (!kProjection.empty() && std::count(kProjectionLevels.begin(), kProjectionLevels.end(), i)) {
+      auto input_types = types;
+      for (auto &expression : Expression::ParseList(kProjection)) {
+        expression->Bind(input_types);
+        types.push_back(expression->result_type_);
+      }
+    }
+    query.projected_types[i] = types;
   }
 
-  std::cerr << "------------------ Statistic ------------------\n";
-  std::cerr << "[Total Time]: " << latency << "s\n";
-  BeeProfiler::Get().EndProfiling();
-  ZebraProfiler::Get().ToCSV();
+  // -----------------------------------------------------------------------------------------------------------
 
-  if (flag_collect_tuples) {
-    // show the joined result.
-    std::cout << "Number of tuples in the result table: " << result_table.NumTuples() << "\n";
-    result_table.Print(8);
+  // Run the strategies one after another on the same data.
+  for (auto &strategy : kStrategies) {
+    std::cerr << "------------------ Strategy: " << strategy.Name() << " ------------------\n";
+    DispatchStrategy(strategy, [&](auto logical, auto compact) {
+      RunPipeline<decltype(logical)::value, decltype(compact)::value>(query, *table);
+    });
+    ZebraProfiler::Get().EndSection(strategy.Name());
   }
 
+  WriteProfiles();
   return 0;
 }
 
-void ExecutePipeline(DataChunk &input, PipelineState &state, DataCollection &result_table, size_t level) {
-  // The last operator: ResultCollector
-  if (level == state.hts.size()) {
-    if (flag_collect_tuples) result_table.AppendChunk(input);
-    return;
-  }
-
-  auto &ht = state.hts[level];
-  auto &join_key = input.data_[level];
-  auto &result = state.intermediates[level];
-  auto &compactor = state.compactors[level];
-  auto &filter = state.filters[level];
-
-#ifdef flag_dynamic_compact
-  // ---------------------------------- learn compaction thresholds -------------------------------------
-  Profiler profiler;
-  profiler.Start();
-  // 1. Get a compaction threshold
-  // 2. Start to record execution time
-  size_t threshold = CompactTuner::Get().SelectArm(level);
-  compactor->SetThreshold(threshold);
-
-  BeeProfiler::Get().InsertStatRecord("[UCB Get Thresholds]", profiler.Elapsed());
-
-  profiler.Start();
-  // -----------------------------------------------------------------------------------------------------
-#endif
-
-  if (ht != nullptr) {
-    // hash join
-    auto ss = ht->Probe(join_key);
-    while (ss.HasNext()) {
-      ss.Next(join_key, input, *result, kEnableLogicalCompact);
-
-#if defined(flag_full_compact) || defined(flag_dynamic_compact)
-      // A compactor sits here.
-      compactor->Compact(result);
-#endif
-
-      if (result->count_ != 0) ExecutePipeline(*result, state, result_table, level + 1);
+template<bool kLogical, CompactType kCompact>
+void RunPipeline(QueryState &query, Table &table) {
+  size_t n_operator = query.types.size();
+
+  // collect, aggregate, order, or write the results
+  auto &result_types = query.projected_types.back();
+  ResultSinks sinks(result_types, kGroupBy, kAggregates, kOrderBy, kLimit);
+  auto &sink = sinks.Sink();
+
+  // filter -> join -> ... -> join -> ResultCollector, with a compactor after each filter and join, and the
+  // projection after the compactors of its levels. Each thread runs its own pipeline, and the pipelines share the
+  // hash tables.
+  if constexpr (kCompact == CompactType::DYNAMIC) CompactTuner::Get().SetEpoch(kTunerEpoch);
+  vector<unique_ptr<Pipeline<kCompact>>> pipelines(kThreads);
+  // the tuner ids of the compactors, assigned by the first pipeline
+  vector<idx_t> tuner_ids;
+  for (size_t t = 0; t < kThreads; ++t) {
+    auto &pipeline = pipelines[t] = std::make_unique<Pipeline<kCompact>>(sink);
+    for (size_t i = 0; i < n_operator; ++i) {
+      if (i == 0) {
+        pipeline->AddOperator(std::make_unique<PhysicalFilter>(kSelectivity, 0, query.types[0]));
+      } else {
+        pipeline->AddOperator(std::make_unique<PhysicalHashJoin<kLogical>>(*query.hts[i], i, query.types[i]));
+      }
+      size_t level = pipeline->NumOperators() - 1;
+      if constexpr (kCompact == CompactType::FULL) {
+        pipeline->InsertCompactor(level, std::make_unique<FullCompaction>(query.types[i]));
+      } else if constexpr (kCompact == CompactType::DYNAMIC) {
+        // a tuning policy for each join level, shared by the compactors of all threads
+        if (t == 0) tuner_ids.push_back(CompactTuner::Get().Initialize(kTuner, PipelineSignature(query, i, kLogical)));
+        pipeline->InsertCompactor(level, std::make_unique<DynamicCompaction>(tuner_ids[i], level, query.types[i]));
+      }
+      if (query.Projects(i)) {
+        pipeline->AddOperator(std::make_unique<PhysicalProjection>(query.types[i], Expression::ParseList(kProjection)));
+      }
     }
-  } else if (filter != nullptr) {
-    // filter
-    filter->Execute(input, level, *result);
+  }
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    if (!kTunerState.empty()) CompactTuner::Get().Load(kTunerState);
+  }
 
-#if defined(flag_full_compact) || defined(flag_dynamic_compact)
-    // A compactor sits here.
-    compactor->Compact(result);
-#endif
+  Profiler timer;
+  timer.Start();
+  auto statistics = ExecuteMorsels(table, pipelines, kMorselSize * kBlockSize);
+  sinks.Close();
+  double wall_time = timer.Elapsed();
 
-    if (result->count_ != 0) ExecutePipeline(*result, state, result_table, level + 1);
+  std::cerr << "------------------ Statistic ------------------\n";
+  PrintWorkerStatistics(statistics, wall_time);
+  sinks.PrintStatistics();
+  BeeProfiler::Get().EndProfiling();
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    if (!kTunerState.empty()) CompactTuner::Get().Save(kTunerState);
+    CompactTuner::Get().Reset(kTunerLog);
   }
 
-#ifdef flag_dynamic_compact
-  // ---------------------------------- learn compaction thresholds -------------------------------------
-  double time = profiler.Elapsed();
-  profiler.Start();
-  CompactTuner::Get().UpdateArm(level, compactor->GetThreshold(), 2 / time / 1e3);
-  BeeProfiler::Get().InsertStatRecord("[UCB Update]", profiler.Elapsed());
-  // -----------------------------------------------------------------------------------------------------
-#endif
+  sinks.Print();
 }
 
-void FlushPipelineCache(PipelineState &state, DataCollection &result_table, size_t level) {
-  auto &hts = state.hts;
-  auto &intermediates = state.intermediates;
-  auto &compactors = state.compactors;
-
-  // The last operator: ResultCollector. It has no compactor.
-  if (level == hts.size()) return;
-
-  auto &result = intermediates[level];
-  auto &compactor = compactors[level];
-
-  // Fetch the remaining tuples in the cache.
-  compactor->Flush(result);
-
-  // Continue the pipeline execution.
-  ExecutePipeline(*result, state, result_table, level + 1);
-
-  // Flush the next level.
-  FlushPipelineCache(state, result_table, level + 1);
+// The signature of the compactor at [level]: the strategy, the distribution of the probe keys, and the operators from
+// the start of the pipeline up to the compactor, with the selectivity of the filter and the shape of the hash tables
+// (rows, chunk factor, fan-out, payload). Runs with the same signature can share what the tuner has learned.
+string PipelineSignature(const QueryState &query, size_t level, bool logical) {
+  std::ostringstream signature;
+  signature << StrategySignature(logical) << "|probe-" << kProbeDistribution.Name() << "-" << kKeyCorrelation;
+  signature << "|filter-0-" << kSelectivity;
+  for (size_t i = 1; i <= level; ++i) {
+    if (query.Projects(i - 1)) signature << "|project";
+    signature << "|join-" << kRHSTupleSize << "-" << kChunkFactor << "-" << kBuildDistribution.Name() << "-"
+              << kRHSPayLoadLength[i - 1];
+  }
+  signature << "|level-" << level;
+  return signature.str();
 }
 
 void PrintHelp() {
   std::cerr << "Usage: [program_name] [options]\n";
   std::cerr << "Options:\n";
-  std::cerr << "  --block-size [value]      Default Block Size\n";
   std::cerr << "  --join-num [value]        Number of joins\n";
   std::cerr << "  --chunk-factor [value]    Chunk factor\n";
   std::cerr << "  --lhs-size [value]        Size of LHS tuples\n";
   std::cerr << "  --rhs-size [value]        Size of RHS tuples\n";
+  std::cerr << "  --seed [value]            Seed of the generated LHS table\n";
   std::cerr << "  --load-factor [value]     Load factor\n";
+  std::cerr << "  --probe-dist [dist]       Distribution of the LHS join keys: uniform, zipf[:s], or hotset[:keys[:share]]\n";
+  std::cerr << "  --key-correlation [value] Probability that a LHS join key repeats the key of the first join column\n";
+  std::cerr << "  --build-dist [dist]       Fan-out of the RHS keys: constant (chunk factor), uniform, zipf[:s], or hotset\n";
   std::cerr << "  --payload-length=[list]   Comma-separated list of payload lengths for RHS\n";
   std::cerr << "                             Example: --payload-length=0,1000,0,0\n";
+  std::cerr << "  --group-by [list]         Comma-separated group columns of the aggregation at the end of the pipeline\n";
+  std::cerr << "  --aggregate [list]        Aggregate the results instead of collecting them\n";
+  std::cerr << "                             count, sum(col), min(col), or max(col), e.g., count,sum(2)\n";
+  std::cerr << "  --order-by [list]         Sort the results instead of collecting them, e.g., 4:desc,1\n";
+  std::cerr << "  --limit [value]           Keep only the first results of the sort (Top-N)\n";
+  std::cerr << "  --projection [list]       ';'-separated expressions to append as columns, e.g., \"#1 * 2; CASE WHEN #2 < 100 THEN 1 ELSE 0 END\"\n";
+  std::cerr << "                             #n is the column n; + - * /, = != < <= > >=, and CASE WHEN ... THEN ... ELSE ... END\n";
+  std::cerr << "  --projection-level [list] Comma-separated operators the projection follows (0: the filter, n: the n-th join)\n";
   std::cerr << "  --selectivity [value]     Filter Selectivity\n";
+  PrintSharedHelp();
 }
 
 int ParseParameters(int argc, char **argv) {
   if (argc != 1) {
     for (int i = 1; i < argc; i++) {
+      if (ParseSharedParameter(argc, argv, i)) continue;
       std::string arg(argv[i]);
 
-      if (arg == "--block-size") {
-        if (i + 1 < argc) {
-          kBlockSize = std::stoi(argv[i + 1]);
-          i++;
-        }
-      } else if (arg == "--join-num") {
+      if (arg == "--join-num") {
         if (i + 1 < argc) {
           kJoins = std::stoi(argv[i + 1]);
           i++;
@@ -247,11 +211,31 @@ int ParseParameters(int argc, char **argv) {
           kLHSTupleSize = std::stoi(argv[i + 1]);
           i++;
         }
+      } else if (arg == "--seed") {
+        if (i + 1 < argc) {
+          kSeed = std::stoull(argv[i + 1]);
+          i++;
+        }
       } else if (arg == "--rhs-size") {
         if (i + 1 < argc) {
           kRHSTupleSize = std::stoi(argv[i + 1]);
           i++;
         }
+      } else if (arg == "--probe-dist") {
+        if (i + 1 < argc) {
+          kProbeDistribution = KeyDistribution::Parse(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--build-dist") {
+        if (i + 1 < argc) {
+          kBuildDistribution = KeyDistribution::Parse(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--key-correlation") {
+        if (i + 1 < argc) {
+          kKeyCorrelation = std::stod(argv[i + 1]);
+          i++;
+        }
       } else if (arg == "--load-factor") {
         if (i + 1 < argc) {
           kLoadFactor = std::stod(argv[i + 1]);
@@ -260,6 +244,36 @@ int ParseParameters(int argc, char **argv) {
       } else if (arg.substr(0, 16) == "--payload-length") {
         // --payload-length=[0,1000,0,0]
         kRHSPayLoadLength = ParseList(arg.substr(17));
+      } else if (arg == "--group-by") {
+        if (i + 1 < argc) {
+          kGroupBy = ParseColumns(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--aggregate") {
+        if (i + 1 < argc) {
+          kAggregates = AggregateSpec::ParseList(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--projection") {
+        if (i + 1 < argc) {
+          kProjection = argv[i + 1];
+          i++;
+        }
+      } else if (arg == "--projection-level") {
+        if (i + 1 < argc) {
+          kProjectionLevels = ParseColumns(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--order-by") {
+        if (i + 1 < argc) {
+          kOrderBy = SortSpec::ParseList(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--limit") {
+        if (i + 1 < argc) {
+          kLimit = std::stoul(argv[i + 1]);
+          i++;
+        }
       } else if (arg == "--selectivity") {
         if (i + 1 < argc) {
           kSelectivity = std::stod(argv[i + 1]);
@@ -275,14 +289,21 @@ int ParseParameters(int argc, char **argv) {
 
   // show the setting
   std::cerr << "------------------ Setting ------------------\n";
-  if (kEnableLogicalCompact) std::cerr << "Strategy: logical_compaction + " << strategy_name << "\n";
-  else std::cerr << "Strategy: " << strategy_name << "\n";
+  PrintSharedSetting();
   std::cerr << "Number of Joins: " << kJoins << "\n"
             << "Number of LHS Tuple: " << kLHSTupleSize << "\n"
             << "Number of RHS Tuple: " << kRHSTupleSize << "\n"
             << "Chunk Factor: " << kChunkFactor << "\n"
             << "Load Factor: " << kLoadFactor << "\n"
             << "Filter Selectivity: " << kSelectivity << "\n";
+  if (!kProjection.empty()) {
+    std::cerr << "Projection: after [";
+    for (size_t i = 0; i < kProjectionLevels.size(); ++i) std::cerr << (i == 0 ? "" : ",") << kProjectionLevels[i];
+    std::cerr << "] " << kProjection << "\n";
+  }
+  std::cerr << "Probe Keys: " << kProbeDistribution.Name() << ", correlation " << kKeyCorrelation << "\n"
+            << "Build Fan-out: " << kBuildDistribution.Name() << "\n";
+  PrintSinkSetting();
   std::cerr << "RHS Payload Lengths: [";
   for (size_t i = 0; i < kJoins; ++i) {
     if (i != kJoins - 1) std::cerr << kRHSPayLoadLength[i] << ",";
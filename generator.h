@@ -0,0 +1,298 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// generator.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <sstream>
+
+#include "base.h"
+#include "data_collection.h"
+
+namespace compaction {
+
+// A counter-based random number generator (Philox4x32-10, Salmon et al., SC'11). The random bits are a function of
+// the counter and the key only, so the value of any cell of a table can be generated on any thread, in any order.
+class Philox {
+ public:
+  using Counter = std::array<uint32_t, 4>;
+
+  static inline Counter Generate(Counter counter, uint64_t seed) {
+    uint32_t k0 = uint32_t(seed), k1 = uint32_t(seed >> 32);
+    for (size_t round = 0; round < 10; ++round) {
+      uint64_t p0 = uint64_t(kM0) * counter[0];
+      uint64_t p1 = uint64_t(kM1) * counter[2];
+      counter = {uint32_t(p1 >> 32) ^ counter[1] ^ k0, uint32_t(p1), uint32_t(p0 >> 32) ^ counter[3] ^ k1, uint32_t(p0)};
+      k0 += kW0;
+      k1 += kW1;
+    }
+    return counter;
+  }
+
+  // 64 random bits for the cell ([row], [col_id]). A cell that needs more draws than one asks for the next [word]s.
+  static inline uint64_t Bits(uint64_t seed, size_t col_id, size_t row, uint32_t word = 0) {
+    auto out = Generate({uint32_t(row), uint32_t(uint64_t(row) >> 32), uint32_t(col_id), word}, seed);
+    return (uint64_t(out[0]) << 32) | out[1];
+  }
+
+  // a double in [0, 1)
+  static inline double Unit(uint64_t seed, size_t col_id, size_t row, uint32_t word = 0) {
+    return double(Bits(seed, col_id, row, word) >> 11) * 0x1p-53;
+  }
+
+  // an integer in [min, max]
+  static inline size_t Uniform(uint64_t seed, size_t col_id, size_t row, size_t min, size_t max, uint32_t word = 0) {
+    uint64_t range = max - min + 1;
+    if (range == 0) return Bits(seed, col_id, row, word);
+    return min + size_t((__uint128_t(Bits(seed, col_id, row, word)) * range) >> 64);
+  }
+
+ private:
+  static constexpr uint32_t kM0 = 0xD2511F53;
+  static constexpr uint32_t kM1 = 0xCD9E8D57;
+  static constexpr uint32_t kW0 = 0x9E3779B9;
+  static constexpr uint32_t kW1 = 0xBB67AE85;
+};
+
+enum class DistributionType : uint8_t {
+  UNIFORM = 0,
+  CONSTANT = 1,
+  ZIPF = 2,
+  HOTSET = 3
+};
+
+// How often each of n keys is drawn, for the keys of a column and the fan-out of a hash table. The keys are the
+// indices [0, n). UNIFORM: all keys equally likely. CONSTANT: the rows are spread evenly over the keys in order, key
+// 0 first. ZIPF: the key i has the weight 1 / (i + 1)^skew_. HOTSET: the first hot_keys_ (a fraction) of the keys get
+// hot_share_ of the draws, and the other keys the rest.
+struct KeyDistribution {
+  DistributionType type_ = DistributionType::UNIFORM;
+  double skew_ = 1;
+  double hot_keys_ = 0.01;
+  double hot_share_ = 0.9;
+
+  KeyDistribution() = default;
+
+  explicit KeyDistribution(DistributionType type) : type_(type) {}
+
+  // "uniform", "constant", "zipf[:skew]", or "hotset[:hot keys[:hot share]]"
+  static inline KeyDistribution Parse(const string &text) {
+    vector<string> parts;
+    std::stringstream ss(text);
+    for (string part; std::getline(ss, part, ':');) parts.push_back(part);
+    KeyDistribution distribution;
+    if (parts.empty()) throw std::runtime_error("Empty key distribution");
+    if (parts[0] == "uniform" && parts.size() == 1) {
+      distribution.type_ = DistributionType::UNIFORM;
+    } else if (parts[0] == "constant" && parts.size() == 1) {
+      distribution.type_ = DistributionType::CONSTANT;
+    } else if (parts[0] == "zipf" && parts.size() <= 2) {
+      distribution.type_ = DistributionType::ZIPF;
+      if (parts.size() > 1) distribution.skew_ = std::stod(parts[1]);
+      if (distribution.skew_ <= 0) throw std::runtime_error("The Zipf skew must be positive: " + text);
+    } else if (parts[0] == "hotset" && parts.size() <= 3) {
+      distribution.type_ = DistributionType::HOTSET;
+      if (parts.size() > 1) distribution.hot_keys_ = std::stod(parts[1]);
+      if (parts.size() > 2) distribution.hot_share_ = std::stod(parts[2]);
+      if (distribution.hot_keys_ <= 0 || distribution.hot_keys_ > 1 || distribution.hot_share_ < 0 ||
+          distribution.hot_share_ > 1) {
+        throw std::runtime_error("The hot keys and their share must be in (0, 1] and [0, 1]: " + text);
+      }
+    } else {
+      throw std::runtime_error("Unknown key distribution: " + text);
+    }
+    return distribution;
+  }
+
+  inline string Name() const {
+    switch (type_) {
+      case DistributionType::UNIFORM: return "uniform";
+      case DistributionType::CONSTANT: return "constant";
+      case DistributionType::ZIPF: return "zipf:" + Format(skew_);
+      case DistributionType::HOTSET: return "hotset:" + Format(hot_keys_) + ":" + Format(hot_share_);
+    }
+    return "";
+  }
+
+  // Prepares the draws of [n_keys] keys for [n_rows] rows.
+  inline void Bind(size_t n_keys, size_t n_rows) {
+    n_keys_ = std::max(n_keys, size_t(1));
+    n_rows_ = std::max(n_rows, size_t(1));
+    n_hot_ = std::clamp(size_t(hot_keys_ * double(n_keys_) + 0.5), size_t(1), n_keys_);
+    if (type_ == DistributionType::ZIPF) {
+      h_integral_x1_ = HIntegral(1.5) - 1;
+      h_integral_n_ = HIntegral(double(n_keys_) + 0.5);
+      s_ = 2 - HIntegralInverse(HIntegral(2.5) - H(2));
+    }
+  }
+
+  // the key of the row [row] of the column [col_id], in [0, n_keys)
+  inline size_t Sample(uint64_t seed, size_t col_id, size_t row) const {
+    switch (type_) {
+      case DistributionType::UNIFORM:
+        return Philox::Uniform(seed, col_id, row, 0, n_keys_ - 1);
+      case DistributionType::CONSTANT:
+        return std::min(size_t(__uint128_t(row) * n_keys_ / n_rows_), n_keys_ - 1);
+      case DistributionType::ZIPF:
+        return SampleZipf(seed, col_id, row);
+      case DistributionType::HOTSET:
+        // the coin and the key come from different words
+        if (n_hot_ == n_keys_ || Philox::Unit(seed, col_id, row) < hot_share_) {
+          return Philox::Uniform(seed, col_id, row, 0, n_hot_ - 1, 1);
+        }
+        return Philox::Uniform(seed, col_id, row, n_hot_, n_keys_ - 1, 1);
+    }
+    return 0;
+  }
+
+ private:
+  size_t n_keys_ = 1;
+  size_t n_rows_ = 1;
+  size_t n_hot_ = 1;
+  // the constants of the Zipf sampler
+  double h_integral_x1_ = 0;
+  double h_integral_n_ = 0;
+  double s_ = 0;
+
+  static inline string Format(double value) {
+    std::stringstream ss;
+    ss << value;
+    return ss.str();
+  }
+
+  // Rejection-inversion sampling of the Zipf distribution (Hörmann and Derflinger, 1996): a constant number of draws
+  // on average, without a table of the n weights. A rejected draw asks Philox for the next word of the cell.
+  inline size_t SampleZipf(uint64_t seed, size_t col_id, size_t row) const {
+    for (uint32_t word = 0;; ++word) {
+      double u = h_integral_n_ + Philox::Unit(seed, col_id, row, word) * (h_integral_x1_ - h_integral_n_);
+      double x = HIntegralInverse(u);
+      double k = std::clamp(std::floor(x + 0.5), 1.0, double(n_keys_));
+      if (k - x <= s_ || u >= HIntegral(k + 0.5) - H(k)) return size_t(k) - 1;
+    }
+  }
+
+  inline double H(double x) const { return std::exp(-skew_ * std::log(x)); }
+
+  inline double HIntegral(double x) const {
+    double log_x = std::log(x);
+    return Helper2((1 - skew_) * log_x) * log_x;
+  }
+
+  inline double HIntegralInverse(double x) const {
+    double t = std::max(x * (1 - skew_), -1.0);
+    return std::exp(Helper1(t) * x);
+  }
+
+  // log(1 + x) / x and (exp(x) - 1) / x, also close to 0
+  static inline double Helper1(double x) {
+    return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+  }
+
+  static inline double Helper2(double x) {
+    return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+  }
+};
+
+enum class GeneratorType : uint8_t {
+  UNIFORM = 0,
+  SEQUENCE = 1,
+  CONSTANT = 2,
+  STRING = 3,
+  KEY = 4
+};
+
+// How the values of a column are generated: UNIFORM integers in [min_, max_], the SEQUENCE 0, 1, 2, ..., the
+// CONSTANT integer value_, or the STRING text_. KEY: the integers min_, min_ + step_, ... up to max_, drawn from
+// distribution_. A KEY column can be correlated with the column correlated_col_: a row takes the draw of that column
+// with the probability correlation_, so the two columns have the same key if that column is an uncorrelated KEY
+// column with the same range, step and distribution.
+struct ColumnSpec {
+  GeneratorType generator_;
+  size_t min_ = 0;
+  size_t max_ = 0;
+  size_t value_ = 0;
+  string text_{};
+  size_t step_ = 1;
+  KeyDistribution distribution_{};
+  size_t correlated_col_ = 0;
+  double correlation_ = 0;
+
+  static inline ColumnSpec Uniform(size_t min, size_t max) { return {GeneratorType::UNIFORM, min, max}; }
+
+  static inline ColumnSpec String(const string &text) { return {GeneratorType::STRING, 0, 0, 0, text}; }
+
+  static inline ColumnSpec Key(size_t min, size_t max, const KeyDistribution &distribution) {
+    ColumnSpec column{GeneratorType::KEY, min, max};
+    column.distribution_ = distribution;
+    return column;
+  }
+
+  // A join key column in [min, max]: keys drawn from [distribution], which repeat the key of the column
+  // [correlated_col] with the probability [correlation]. Uniform independent keys are a UNIFORM column.
+  static inline ColumnSpec JoinKey(size_t min, size_t max, const KeyDistribution &distribution, size_t correlated_col,
+                                   double correlation) {
+    if (distribution.type_ == DistributionType::UNIFORM && correlation == 0) return Uniform(min, max);
+    ColumnSpec column = Key(min, max, distribution);
+    column.correlated_col_ = correlated_col;
+    column.correlation_ = correlation;
+    return column;
+  }
+
+  // Prepares the draws of a KEY column for [n_tuples] tuples.
+  inline void Bind(size_t n_tuples) {
+    if (generator_ == GeneratorType::KEY) distribution_.Bind((max_ - min_) / step_ + 1, n_tuples);
+  }
+
+  inline AttributeType Type() const {
+    return generator_ == GeneratorType::STRING ? AttributeType::STRING : AttributeType::INTEGER;
+  }
+
+  // Writes the values of the tuples [start, start + count) of the column [col_id] to [col].
+  inline void Fill(Vector &col, uint64_t seed, size_t col_id, size_t start, size_t count) const {
+    switch (generator_) {
+      case GeneratorType::UNIFORM:
+        for (size_t i = 0; i < count; ++i) col.GetValue(i) = Philox::Uniform(seed, col_id, start + i, min_, max_);
+        break;
+      case GeneratorType::SEQUENCE:
+        for (size_t i = 0; i < count; ++i) col.GetValue(i) = start + i;
+        break;
+      case GeneratorType::CONSTANT:
+        for (size_t i = 0; i < count; ++i) col.GetValue(i) = value_;
+        break;
+      case GeneratorType::STRING:
+        for (size_t i = 0; i < count; ++i) col.GetValue(i) = text_;
+        break;
+      case GeneratorType::KEY:
+        for (size_t i = 0; i < count; ++i) {
+          size_t row = start + i, source = col_id;
+          // a separate word of the cell, so that the coin does not bias the draw
+          if (correlation_ > 0 && Philox::Unit(seed, col_id, row, ~0u) < correlation_) source = correlated_col_;
+          col.GetValue(i) = min_ + step_ * distribution_.Sample(seed, source, row);
+        }
+        break;
+    }
+  }
+};
+
+// Generates [n_tuples] tuples of [columns] into [table], segment by segment on all hardware threads. The tuples
+// depend on [seed] only, not on the number of threads.
+inline void GenerateTable(DataCollection &table, vector<ColumnSpec> columns, size_t n_tuples, uint64_t seed) {
+  for (auto &column : columns) column.Bind(n_tuples);
+  table.Generate(n_tuples, [&](DataChunk &segment, size_t start) {
+    for (size_t j = 0; j < columns.size(); ++j) columns[j].Fill(segment.data_[j], seed, j, start, segment.count_);
+  });
+}
+
+// the schema of [columns]
+inline vector<AttributeType> ColumnTypes(const vector<ColumnSpec> &columns) {
+  vector<AttributeType> types;
+  for (auto &column : columns) types.push_back(column.Type());
+  return types;
+}
+}
@@ -0,0 +1,417 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// hash_aggregate.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <limits>
+#include <sstream>
+
+#include "base.h"
+#include "profiler.h"
+#include "data_collection.h"
+#include "physical_operator.h"
+
+namespace compaction {
+
+enum class AggregateType : uint8_t {
+  COUNT = 0,
+  SUM = 1,
+  MIN = 2,
+  MAX = 3
+};
+
+struct AggregateSpec {
+  AggregateType type_;
+  // the input column (COUNT has none)
+  size_t col_id_;
+
+  inline string Name() const {
+    static const char *names[] = {"count", "sum", "min", "max"};
+    if (type_ == AggregateType::COUNT) return names[0];
+    return string(names[uint8_t(type_)]) + "(" + std::to_string(col_id_) + ")";
+  }
+
+  // count, sum(<column>), min(<column>), or max(<column>)
+  static inline AggregateSpec Parse(const string &spec) {
+    if (spec == "count") return {AggregateType::COUNT, 0};
+
+    auto open = spec.find('(');
+    if (open == string::npos || spec.back() != ')') throw std::runtime_error("Unknown aggregate: " + spec);
+    string name = spec.substr(0, open);
+    size_t col_id = std::stoul(spec.substr(open + 1, spec.size() - open - 2));
+    if (name == "sum") return {AggregateType::SUM, col_id};
+    if (name == "min") return {AggregateType::MIN, col_id};
+    if (name == "max") return {AggregateType::MAX, col_id};
+    throw std::runtime_error("Unknown aggregate: " + spec);
+  }
+
+  // a comma-separated list of aggregates, e.g., "count,sum(2),max(4)"
+  static inline vector<AggregateSpec> ParseList(const string &specs) {
+    vector<AggregateSpec> aggregates;
+    std::stringstream ss(specs);
+    string spec;
+    while (std::getline(ss, spec, ',')) aggregates.push_back(Parse(spec));
+    if (aggregates.empty()) throw std::runtime_error("No aggregate given");
+    return aggregates;
+  }
+};
+
+// a comma-separated list of column indices, e.g., "0,4"
+inline vector<size_t> ParseColumns(const string &columns) {
+  vector<size_t> result;
+  std::stringstream ss(columns);
+  string item;
+  while (std::getline(ss, item, ',')) result.push_back(std::stoul(item));
+  return result;
+}
+
+// A linear-probing hash table from the group keys to group IDs, with the aggregate states of each group. The keys and
+// the states are stored column by column, indexed by the group ID.
+class GroupedAggregateTable {
+ public:
+  GroupedAggregateTable(const vector<AttributeType> &key_types,
+                        const vector<AggregateSpec> &aggregates,
+                        const vector<AttributeType> &state_types)
+      : key_types_(key_types), aggregates_(aggregates), state_types_(state_types), keys_(key_types.size()),
+        states_(aggregates.size()) {
+    Resize(1024);
+  }
+
+  inline size_t NumGroups() const { return group_hashes_.size(); }
+
+  // Hashes the key columns [key_cols] of each tuple of [input].
+  inline void Hash(DataChunk &input, const vector<size_t> &key_cols, vector<uint64_t> &hashes) const {
+    for (size_t i = 0; i < input.count_; ++i) hashes[i] = 0;
+    for (auto col_id : key_cols) {
+      auto &col = input.data_[col_id];
+      for (size_t i = 0; i < input.count_; ++i) {
+        hashes[i] = CombineHash(hashes[i], hash_(col.GetValue(col.selection_vector_[i])));
+      }
+    }
+    for (size_t i = 0; i < input.count_; ++i) hashes[i] = MixHash(hashes[i]);
+  }
+
+  // Resolves the group of each tuple of [input] into [group_ids], and creates the missing groups. The tuples probe
+  // the table round by round: each round advances the tuples that hit another group to the next slot.
+  inline void FindOrCreateGroups(DataChunk &input, const vector<size_t> &key_cols, const vector<uint64_t> &hashes,
+                                 vector<uint32_t> &group_ids) {
+    if ((NumGroups() + input.count_) * 2 > slot_groups_.size()) Resize((NumGroups() + input.count_) * 2);
+
+    size_t n_remaining = input.count_;
+    for (size_t i = 0; i < n_remaining; ++i) {
+      remaining_[i] = i;
+      slots_[i] = hashes[i] & mask_;
+    }
+    while (n_remaining > 0) {
+      size_t n_next = 0;
+      for (size_t j = 0; j < n_remaining; ++j) {
+        auto i = remaining_[j];
+        auto key = [&](size_t c) -> Attribute & {
+          auto &col = input.data_[key_cols[c]];
+          return col.GetValue(col.selection_vector_[i]);
+        };
+        if (Match(slots_[i], hashes[i], key, group_ids[i])) continue;
+        slots_[i] = (slots_[i] + 1) & mask_;
+        remaining_[n_next++] = i;
+      }
+      n_remaining = n_next;
+    }
+  }
+
+  // Updates the aggregate states of the groups [group_ids] with the tuples of [input].
+  inline void UpdateStates(DataChunk &input, const vector<uint32_t> &group_ids) {
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+      auto &spec = aggregates_[a];
+      auto &state = states_[a];
+      if (spec.type_ == AggregateType::COUNT) {
+        for (size_t i = 0; i < input.count_; ++i) state.ints_[group_ids[i]]++;
+        continue;
+      }
+      auto &col = input.data_[spec.col_id_];
+      if (state_types_[a] == AttributeType::INTEGER) {
+        Update<size_t>(spec.type_, col, input.count_, group_ids, state.ints_);
+      } else {
+        Update<double>(spec.type_, col, input.count_, group_ids, state.doubles_);
+      }
+    }
+  }
+
+  // Adds the groups of [other] to this table.
+  inline void Combine(GroupedAggregateTable &other) {
+    if ((NumGroups() + other.NumGroups()) * 2 > slot_groups_.size()) Resize((NumGroups() + other.NumGroups()) * 2);
+
+    for (uint32_t g = 0; g < other.NumGroups(); ++g) {
+      uint64_t hash = other.group_hashes_[g];
+      auto key = [&](size_t c) -> Attribute & { return other.keys_[c][g]; };
+      uint32_t group_id;
+      for (size_t slot = hash & mask_; !Match(slot, hash, key, group_id); slot = (slot + 1) & mask_) {}
+
+      for (size_t a = 0; a < aggregates_.size(); ++a) {
+        if (state_types_[a] == AttributeType::INTEGER) {
+          Combine(aggregates_[a].type_, states_[a].ints_[group_id], other.states_[a].ints_[g]);
+        } else {
+          Combine(aggregates_[a].type_, states_[a].doubles_[group_id], other.states_[a].doubles_[g]);
+        }
+      }
+    }
+  }
+
+  // Appends a tuple per group: the keys, then the aggregates.
+  inline void Fetch(DataCollection &result) {
+    vector<Attribute> tuple(keys_.size() + states_.size());
+    for (size_t g = 0; g < NumGroups(); ++g) {
+      for (size_t c = 0; c < keys_.size(); ++c) tuple[c] = keys_[c][g];
+      for (size_t a = 0; a < states_.size(); ++a) {
+        if (state_types_[a] == AttributeType::INTEGER) tuple[keys_.size() + a] = states_[a].ints_[g];
+        else tuple[keys_.size() + a] = states_[a].doubles_[g];
+      }
+      result.AppendTuple(tuple);
+    }
+  }
+
+ private:
+  static constexpr uint32_t kEmpty = std::numeric_limits<uint32_t>::max();
+
+  struct StateColumn {
+    vector<size_t> ints_;
+    vector<double> doubles_;
+  };
+
+  vector<AttributeType> key_types_;
+  vector<AggregateSpec> aggregates_;
+  vector<AttributeType> state_types_;
+  std::hash<Attribute> hash_;
+
+  // the slots: the group in each slot (or kEmpty), and its hash
+  vector<uint32_t> slot_groups_;
+  vector<uint64_t> slot_hashes_;
+  size_t mask_ = 0;
+
+  // the groups: the hash, the keys and the aggregate states
+  vector<uint64_t> group_hashes_;
+  vector<vector<Attribute>> keys_;
+  vector<StateColumn> states_;
+
+  // the probe of a chunk: the tuples still probing, and their current slots
+  vector<uint32_t> remaining_ = vector<uint32_t>(kBlockSize);
+  vector<size_t> slots_ = vector<size_t>(kBlockSize);
+
+  static inline uint64_t CombineHash(uint64_t a, uint64_t b) {
+    return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+  }
+
+  // The finalizer of MurmurHash3. std::hash of an integer is about the integer itself, so strided keys (e.g., the
+  // multiples of the chunk factor after a join) would fill neighbouring slots and make long probe runs.
+  static inline uint64_t MixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // Whether the tuple with [hash] and the keys [key](c) belongs in [slot]: the group of the slot if the keys are
+  // equal, or a new group if the slot is empty.
+  template<class KEY>
+  inline bool Match(size_t slot, uint64_t hash, KEY &&key, uint32_t &group_id) {
+    group_id = slot_groups_[slot];
+    if (group_id == kEmpty) {
+      group_id = CreateGroup(hash, key);
+      slot_groups_[slot] = group_id;
+      slot_hashes_[slot] = hash;
+      return true;
+    }
+    if (slot_hashes_[slot] != hash) return false;
+    for (size_t c = 0; c < keys_.size(); ++c) {
+      if (keys_[c][group_id] != key(c)) return false;
+    }
+    return true;
+  }
+
+  template<class KEY>
+  inline uint32_t CreateGroup(uint64_t hash, KEY &&key) {
+    auto group_id = uint32_t(NumGroups());
+    group_hashes_.push_back(hash);
+    for (size_t c = 0; c < keys_.size(); ++c) keys_[c].push_back(key(c));
+    for (size_t a = 0; a < states_.size(); ++a) {
+      if (state_types_[a] == AttributeType::INTEGER) states_[a].ints_.push_back(Initial<size_t>(aggregates_[a].type_));
+      else states_[a].doubles_.push_back(Initial<double>(aggregates_[a].type_));
+    }
+    return group_id;
+  }
+
+  // Grows the slots to the power of two not below [n_slots], and places the groups again.
+  inline void Resize(size_t n_slots) {
+    size_t capacity = std::max(slot_groups_.size(), size_t(1));
+    while (capacity < n_slots) capacity *= 2;
+    slot_groups_.assign(capacity, kEmpty);
+    slot_hashes_.assign(capacity, 0);
+    mask_ = capacity - 1;
+    for (uint32_t g = 0; g < NumGroups(); ++g) {
+      size_t slot = group_hashes_[g] & mask_;
+      while (slot_groups_[slot] != kEmpty) slot = (slot + 1) & mask_;
+      slot_groups_[slot] = g;
+      slot_hashes_[slot] = group_hashes_[g];
+    }
+  }
+
+  template<class T>
+  static inline T Initial(AggregateType type) {
+    switch (type) {
+      case AggregateType::MIN: return std::numeric_limits<T>::max();
+      case AggregateType::MAX: return std::numeric_limits<T>::lowest();
+      default: return 0;
+    }
+  }
+
+  template<class T>
+  static inline void Update(AggregateType type, Vector &col, size_t count, const vector<uint32_t> &group_ids,
+                            vector<T> &states) {
+    auto &sel = col.selection_vector_;
+    switch (type) {
+      case AggregateType::SUM:
+        for (size_t i = 0; i < count; ++i) states[group_ids[i]] += std::get<T>(col.GetValue(sel[i]));
+        break;
+      case AggregateType::MIN:
+        for (size_t i = 0; i < count; ++i) {
+          auto &state = states[group_ids[i]];
+          state = std::min(state, std::get<T>(col.GetValue(sel[i])));
+        }
+        break;
+      case AggregateType::MAX:
+        for (size_t i = 0; i < count; ++i) {
+          auto &state = states[group_ids[i]];
+          state = std::max(state, std::get<T>(col.GetValue(sel[i])));
+        }
+        break;
+      case AggregateType::COUNT: break;
+    }
+  }
+
+  template<class T>
+  static inline void Combine(AggregateType type, T &state, T other) {
+    switch (type) {
+      case AggregateType::MIN: state = std::min(state, other); break;
+      case AggregateType::MAX: state = std::max(state, other); break;
+      default: state += other;
+    }
+  }
+};
+
+// Groups the tuples on the columns [group_cols] (INTEGER or STRING) and computes the aggregates (SUM, MIN and MAX of
+// INTEGER or DOUBLE columns). Each pipeline aggregates into its own table, and the tables are combined when the
+// pipelines are finalized. Without group columns, there is a single group.
+class PhysicalHashAggregate : public PhysicalSink {
+ public:
+  PhysicalHashAggregate(const vector<AttributeType> &input_types,
+                        const vector<size_t> &group_cols,
+                        const vector<AggregateSpec> &aggregates)
+      : group_cols_(group_cols), aggregates_(aggregates),
+        hash_id_(BeeProfiler::Get().Register("[Aggregate - Hash]")),
+        find_id_(BeeProfiler::Get().Register("[Aggregate - Find Groups]")),
+        update_id_(BeeProfiler::Get().Register("[Aggregate - Update]")),
+        combine_id_(BeeProfiler::Get().Register("[Aggregate - Combine]")),
+        hist_id_(ZebraProfiler::Get().Register("[Aggregate]")) {
+    for (auto col_id : group_cols_) {
+      if (col_id >= input_types.size()) throw std::runtime_error("Group column out of range: " + std::to_string(col_id));
+      auto type = input_types[col_id];
+      if (type != AttributeType::INTEGER && type != AttributeType::STRING) {
+        throw std::runtime_error("Group column must be an integer or a string: " + std::to_string(col_id));
+      }
+      key_types_.push_back(type);
+    }
+    for (auto &spec : aggregates_) {
+      if (spec.type_ == AggregateType::COUNT) {
+        state_types_.push_back(AttributeType::INTEGER);
+        continue;
+      }
+      if (spec.col_id_ >= input_types.size()) throw std::runtime_error("Aggregate column out of range: " + spec.Name());
+      auto type = input_types[spec.col_id_];
+      if (type != AttributeType::INTEGER && type != AttributeType::DOUBLE) {
+        throw std::runtime_error("Aggregate column must be an integer or a double: " + spec.Name());
+      }
+      state_types_.push_back(type);
+    }
+    global_ = std::make_unique<GroupedAggregateTable>(key_types_, aggregates_, state_types_);
+  }
+
+  struct AggregateState : public OperatorState {
+    GroupedAggregateTable table_;
+    vector<uint64_t> hashes_;
+    vector<uint32_t> group_ids_;
+    RegionProfiler profiler_;
+
+    explicit AggregateState(const PhysicalHashAggregate &op)
+        : table_(op.key_types_, op.aggregates_, op.state_types_), hashes_(kBlockSize), group_ids_(kBlockSize) {}
+  };
+
+  unique_ptr<OperatorState> GetState() const override { return std::make_unique<AggregateState>(*this); }
+
+  void Sink(DataChunk &input, OperatorState &state) override {
+    auto &local = static_cast<AggregateState &>(state);
+    auto &profiler = local.profiler_;
+
+    profiler.Start();
+    local.table_.Hash(input, group_cols_, local.hashes_);
+    double time = profiler.Record(hash_id_);
+
+    profiler.Start();
+    local.table_.FindOrCreateGroups(input, group_cols_, local.hashes_, local.group_ids_);
+    time += profiler.Record(find_id_);
+
+    profiler.Start();
+    local.table_.UpdateStates(input, local.group_ids_);
+    time += profiler.Record(update_id_);
+    ZebraProfiler::Get().InsertSinkRecord(hist_id_, input.count_, time);
+  }
+
+  void Finalize(OperatorState &state) override {
+    auto &local = static_cast<AggregateState &>(state);
+    lock_guard<mutex> lock(mutex_);
+    local.profiler_.Start();
+    global_->Combine(local.table_);
+    local.profiler_.Record(combine_id_);
+  }
+
+  // the schema of the result: the group columns, then the aggregates
+  inline vector<AttributeType> Types() const {
+    vector<AttributeType> types = key_types_;
+    types.insert(types.end(), state_types_.begin(), state_types_.end());
+    return types;
+  }
+
+  inline size_t NumGroups() const { return global_->NumGroups(); }
+
+  // Appends the groups to [result]. Must be called after all pipelines are finalized.
+  inline void Fetch(DataCollection &result) { global_->Fetch(result); }
+
+  // Shows the number of groups and the first [n_group] groups.
+  inline void Print(size_t n_group) {
+    DataCollection groups(Types());
+    Fetch(groups);
+    std::cout << "Number of groups in the result: " << groups.NumTuples() << "\n";
+    groups.Print(n_group);
+  }
+
+ private:
+  vector<size_t> group_cols_;
+  vector<AggregateSpec> aggregates_;
+  vector<AttributeType> key_types_;
+  vector<AttributeType> state_types_;
+  unique_ptr<GroupedAggregateTable> global_;
+  mutex mutex_;
+
+  // profiling records
+  const idx_t hash_id_;
+  const idx_t find_id_;
+  const idx_t update_id_;
+  const idx_t combine_id_;
+  const idx_t hist_id_;
+};
+}
@@ -5,8 +5,14 @@ HashTable::HashTable(size_t n_rhs_tuples,
                      size_t chunk_factor,
                      size_t payload_length,
                      vector<AttributeType> &schema,
-                     double load_factor)
-    : buffer_(schema) {
+                     double load_factor,
+                     const KeyDistribution &fan_out,
+                     uint64_t seed)
+    : probe_id_(BeeProfiler::Get().Register("[Join - Probe] 0x" + std::to_string(size_t(this)))),
+      next_id_(BeeProfiler::Get().Register("[Join - Next] 0x" + std::to_string(size_t(this)))),
+      probe_hist_id_(ZebraProfiler::Get().Register("[Join - Probe]")),
+      next_hist_id_(ZebraProfiler::Get().Register("[Join - Next]")),
+      buffer_(schema) {
   n_buckets_ = size_t(double(n_rhs_tuples) / load_factor);
   linked_lists_.resize(n_buckets_);
   for (auto &bucket : linked_lists_) bucket = std::make_unique<list<Tuple>>();
@@ -18,31 +24,83 @@ HashTable::HashTable(size_t n_rhs_tuples,
     payload_name += string(payload_length, 'x');
     payload_name += "_";
   }
-  vector<Tuple> rhs_table(n_rhs_tuples);
-  size_t cnt = 0;
+  // The tuple cnt has the key i * (n_rhs_tuples / num_unique) and the payload <payload_name>cnt|. With a CONSTANT
+  // fan-out, i is cnt / chunk_factor, so each key has chunk_factor tuples; otherwise i is drawn from [fan_out].
   const size_t num_unique = n_rhs_tuples / chunk_factor + (n_rhs_tuples % chunk_factor != 0);
-  for (size_t i = 0; i < num_unique; ++i) {
-    auto unique_value = i * (n_rhs_tuples / num_unique);
-    for (size_t j = 0; j < chunk_factor && cnt < n_rhs_tuples; ++j) {
-      auto payload = payload_name + std::to_string(cnt) + "|";
-      rhs_table[cnt].attrs_.emplace_back(unique_value);
-      rhs_table[cnt].attrs_.emplace_back(payload);
-      ++cnt;
+  KeyDistribution key_distribution = fan_out;
+  key_distribution.Bind(num_unique, n_rhs_tuples);
+  auto key_of = [&](size_t cnt) -> size_t {
+    size_t i = fan_out.type_ == DistributionType::CONSTANT ? cnt / chunk_factor : key_distribution.Sample(seed, 0, cnt);
+    return i * (n_rhs_tuples / num_unique);
+  };
+
+  // build hash table in parallel passes. The first draws and hashes the keys, and counts the tuples of each range of
+  // the buckets per block of tuples; the second partitions the tuples by range, in the order of cnt; the third
+  // inserts them, a task per range. So each task only walks its own tuples, and the buckets are the same as those of
+  // a serial build.
+  const size_t n_ranges = std::max(std::thread::hardware_concurrency(), 1u);
+  const size_t range_size = (n_buckets_ + n_ranges - 1) / n_ranges;
+  const size_t n_blocks = (n_rhs_tuples + kBlockSize - 1) / kBlockSize;
+  auto block_end = [&](size_t block) { return std::min((block + 1) * kBlockSize, n_rhs_tuples); };
+  vector<size_t> keys(n_rhs_tuples), bucket_of(n_rhs_tuples);
+  // the tuples of each block in each range, and then where they go in [order]
+  vector<size_t> block_offsets(n_blocks * n_ranges, 0);
+  ParallelFor(n_blocks, [&](size_t block) {
+    for (size_t cnt = block * kBlockSize; cnt < block_end(block); ++cnt) {
+      keys[cnt] = key_of(cnt);
+      bucket_of[cnt] = hash_(Attribute(keys[cnt])) % n_buckets_;
+      block_offsets[block * n_ranges + bucket_of[cnt] / range_size]++;
+    }
+  });
+
+  vector<size_t> range_start(n_ranges + 1, 0);
+  for (size_t range = 0, offset = 0; range < n_ranges; ++range) {
+    range_start[range] = offset;
+    for (size_t block = 0; block < n_blocks; ++block) {
+      size_t count = block_offsets[block * n_ranges + range];
+      block_offsets[block * n_ranges + range] = offset;
+      offset += count;
     }
   }
-
-  // build hash table
-  for (size_t i = 0; i < n_rhs_tuples; ++i) {
-    auto &tuple = rhs_table[i];
-    Attribute value = tuple.attrs_[0];
-    auto bucket_idx = hash_(value) % n_buckets_;
-    auto &bucket = linked_lists_[bucket_idx];
-    bucket->push_back(tuple);
-  }
+  range_start[n_ranges] = n_rhs_tuples;
+  vector<size_t> order(n_rhs_tuples);
+  ParallelFor(n_blocks, [&](size_t block) {
+    for (size_t cnt = block * kBlockSize; cnt < block_end(block); ++cnt) {
+      order[block_offsets[block * n_ranges + bucket_of[cnt] / range_size]++] = cnt;
+    }
+  });
+
+  vector<size_t> range_bytes(n_ranges, 0), range_chain(n_ranges, 0);
+  ParallelFor(n_ranges, [&](size_t range) {
+    const size_t begin = range * range_size, end = std::min(begin + range_size, n_buckets_);
+    for (size_t idx = range_start[range]; idx < range_start[range + 1]; ++idx) {
+      size_t cnt = order[idx];
+      auto bucket_idx = bucket_of[cnt];
+      auto &bucket = linked_lists_[bucket_idx];
+      bucket->emplace_back();
+      auto &attrs = bucket->back().attrs_;
+      attrs.emplace_back(keys[cnt]);
+      attrs.emplace_back(payload_name + std::to_string(cnt) + "|");
+
+      // a list node (two pointers and the tuple), its values, and the strings that do not fit in the values
+      range_bytes[range] += 2 * sizeof(void *) + sizeof(Tuple) + attrs.capacity() * sizeof(Attribute);
+      for (auto &attr : attrs) {
+        auto *str = std::get_if<string>(&attr);
+        if (str != nullptr && str->capacity() > string().capacity()) range_bytes[range] += str->capacity() + 1;
+      }
+    }
+    for (size_t b = begin; b < end; ++b) range_chain[range] = std::max(range_chain[range], linked_lists_[b]->size());
+  }, n_ranges);
+  size_t tuple_bytes = 0;
+  for (auto bytes : range_bytes) tuple_bytes += bytes;
+  size_t bucket_bytes = n_buckets_ * (sizeof(unique_ptr<list<Tuple>>) + sizeof(list<Tuple>));
+  size_t max_chain = *std::max_element(range_chain.begin(), range_chain.end());
+  BeeProfiler::Get().InsertHTRecord("[Hash Table] 0x" + std::to_string(size_t(this)), tuple_bytes, bucket_bytes,
+                                    n_rhs_tuples, max_chain);
 }
 
-ScanStructure HashTable::Probe(Vector &join_key) {
-  Profiler profiler;
+ScanStructure HashTable::Probe(Vector &join_key, DataChunk &buffer) {
+  RegionProfiler profiler;
   profiler.Start();
 
   vector<list<Tuple> *> ptrs(kBlockSize);
@@ -57,11 +115,10 @@ ScanStructure HashTable::Probe(Vector &join_key) {
   for (size_t i = 0; i < join_key.count_; ++i) {
     if (!ptrs[i]->empty()) ptrs_sel_vector[n_non_empty++] = i;
   }
-  auto ret = ScanStructure(n_non_empty, ptrs_sel_vector, ptrs, join_key.selection_vector_, this, &buffer_);
+  auto ret = ScanStructure(n_non_empty, ptrs_sel_vector, ptrs, join_key.selection_vector_, this, &buffer);
 
-  double time = profiler.Elapsed();
-  BeeProfiler::Get().InsertStatRecord("[Join - Probe] 0x" + std::to_string(size_t(this)), time);
-  ZebraProfiler::Get().InsertRecord("[Join - Probe] 0x" + std::to_string(size_t(this)), join_key.count_, time);
+  double time = profiler.Record(probe_id_);
+  ZebraProfiler::Get().InsertRecord(probe_hist_id_, join_key.count_, n_non_empty, time);
   return ret;
 }
 
@@ -93,7 +150,7 @@ void ScanStructure::NextInternal(compaction::Vector &join_key,
     return;
   }
 
-  Profiler profiler;
+  RegionProfiler profiler;
   profiler.Start();
 
   vector<uint32_t> result_vector(kBlockSize);
@@ -118,9 +175,8 @@ void ScanStructure::NextInternal(compaction::Vector &join_key,
   }
   AdvancePointers();
 
-  double time = profiler.Elapsed();
-  BeeProfiler::Get().InsertStatRecord("[Join - Next] 0x" + std::to_string(size_t(ht_)), time);
-  ZebraProfiler::Get().InsertRecord("[Join - Next] 0x" + std::to_string(size_t(ht_)), input.count_, time);
+  double time = profiler.Record(ht_->next_id_);
+  ZebraProfiler::Get().InsertRecord(ht_->next_hist_id_, input.count_, result_count, time);
 }
 
 size_t ScanStructure::ScanInnerJoin(Vector &join_key, vector<uint32_t> &result_vector) {
@@ -152,13 +208,19 @@ void ScanStructure::AdvancePointers() {
 }
 
 void ScanStructure::GatherResult(vector<Vector *> cols, vector<uint32_t> &sel_vector, size_t count) {
+  size_t string_bytes = 0;
   for (size_t c = 0; c < cols.size(); ++c) {
     auto &col = *cols[c];
     for (size_t i = 0; i < count; ++i) {
       auto idx = sel_vector[i];
-      col.GetValue(i + col.count_) = iterators_[idx]->attrs_[c];
+      auto &value = col.GetValue(i + col.count_) = iterators_[idx]->attrs_[c];
+      if (auto *str = std::get_if<string>(&value)) string_bytes += str->size();
     }
     col.count_ += count;
   }
+
+  auto &counters = CopyCounters::Local();
+  counters.values_ += cols.size() * count;
+  counters.string_bytes_ += string_bytes;
 }
 }
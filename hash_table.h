@@ -16,6 +16,7 @@
 
 #include "base.h"
 #include "profiler.h"
+#include "generator.h"
 
 namespace compaction {
 
@@ -75,14 +76,29 @@ class HashTable {
             size_t chunk_factor,
             size_t payload_length,
             vector<AttributeType> &schema,
-            double load_factor = 0.5);
+            double load_factor = 0.5,
+            const KeyDistribution &fan_out = KeyDistribution(DistributionType::CONSTANT),
+            uint64_t seed = 0);
 
-  ScanStructure Probe(Vector &join_key);
+  ScanStructure Probe(Vector &join_key) { return Probe(join_key, buffer_); }
+
+  // The scan structure buffers the results that do not fit into a chunk in [buffer]. The hash table is read-only
+  // after the build, so threads can probe it at the same time, each with its own buffer.
+  ScanStructure Probe(Vector &join_key, DataChunk &buffer);
 
  private:
+  friend class ScanStructure;
+
+  // profiling records
+  const idx_t probe_id_;
+  const idx_t next_id_;
+  const idx_t probe_hist_id_;
+  const idx_t next_hist_id_;
+
   size_t n_buckets_;
   vector<unique_ptr<list<Tuple>>> linked_lists_;
   std::hash<Attribute> hash_;
+  // the buffer of the probes that do not bring their own
   DataChunk buffer_;
 };
 }
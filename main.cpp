@@ -1,26 +1,21 @@
 #include <iostream>
-#include <random>
 
 #include "base.h"
 #include "hash_table.h"
 #include "data_collection.h"
 #include "profiler.h"
-#include "compactor.h"
+#include "pipeline.h"
+#include "table_file.h"
 #include "setting.h"
+#include "driver.h"
+#include "tracer.h"
 
 using namespace compaction;
 
-struct PipelineState {
-  vector<unique_ptr<HashTable>> hts;
-  vector<unique_ptr<DataChunk>> intermediates;
-  vector<unique_ptr<NaiveCompactor>> compactors;
+template<bool kLogical, CompactType kCompact>
+void RunPipeline(vector<unique_ptr<HashTable>> &hts, vector<vector<AttributeType>> &types, Table &table);
 
-  PipelineState() : hts(kJoins), intermediates(kJoins), compactors(kJoins) {}
-};
-
-static void ExecutePipeline(DataChunk &input, PipelineState &state, DataCollection &result_table, size_t level);
-
-void FlushPipelineCache(PipelineState &state, DataCollection &result_table, size_t level);
+string PipelineSignature(size_t level, bool logical);
 
 std::vector<size_t> ParseList(const std::string &s) {
   std::stringstream ss(s.substr(1, s.size() - 2)); // Ignore brackets
@@ -37,158 +32,133 @@ int ParseParameters(int argc, char *argv[]);
 // example: compaction --join-num 4 --chunk-factor 5 --lhs-size 20000000 --rhs-size 2000000 --load-factor 0.5 --payload-length=[0,0,0,0]
 int main(int argc, char *argv[]) {
   if (ParseParameters(argc, argv)) return 0;
-
-  // random generator
-  std::random_device rd;
-  std::mt19937 gen(2);
-  std::uniform_int_distribution<> dist(0, kRHSTupleSize);
+  EnableProfilers();
 
   // ---------------------------------------------- Query Setting ----------------------------------------------
 
   // create probe table: (id1, id2, ..., idn, miscellaneous)
-  vector<AttributeType> types;
-  for (size_t i = 0; i < kJoins; ++i) types.push_back(AttributeType::INTEGER);
-  types.push_back(AttributeType::STRING);
-  compaction::DataCollection table(types);
-  vector<compaction::Attribute> tuple(kJoins + 1);
-  tuple[kJoins] = "|";
-  for (size_t i = 0; i < kLHSTupleSize; ++i) {
-    for (size_t j = 0; j < kJoins; ++j) tuple[j] = size_t(dist(gen));
-    table.AppendTuple(tuple);
+  vector<ColumnSpec> columns;
+  for (size_t i = 0; i < kJoins; ++i) {
+    columns.push_back(ColumnSpec::JoinKey(0, kRHSTupleSize, kProbeDistribution, 0, i == 0 ? 0 : kKeyCorrelation));
   }
+  columns.push_back(ColumnSpec::String("|"));
+  vector<AttributeType> types = ColumnTypes(columns);
+  auto table = CreateTable(columns, kLHSTupleSize, kSeed, kLoadTablePath, kSaveTablePath, kCSVDelimiter);
 
-  // create rhs hash table, and the result_table chunk
-  PipelineState state;
-  auto &hts = state.hts;
-  auto &intermediates = state.intermediates;
-  auto &compactors = state.compactors;
+  // create rhs hash tables, and the schema of each join result
+  vector<unique_ptr<HashTable>> hts(kJoins);
+  vector<vector<AttributeType>> join_types(kJoins);
   for (size_t i = 0; i < kJoins; ++i) {
     types.push_back(AttributeType::INTEGER);
     types.push_back(AttributeType::STRING);
-    intermediates[i] = std::make_unique<DataChunk>(types);
-    compactors[i] = std::make_unique<NaiveCompactor>(types);
-    hts[i] = std::make_unique<HashTable>(kRHSTupleSize, kChunkFactor, kRHSPayLoadLength[i], types, kLoadFactor);
-  }
-
-  // create the result_table collection
-  DataCollection result_table(types);
-
-  double latency = 0;
-  Profiler timer;
-  {
-    // Start process each chunk in the lhs table
-    size_t num_chunk_size = kBlockSize;
-    size_t start = 0;
-    size_t end;
-    do {
-      end = std::min(start + num_chunk_size, kLHSTupleSize);
-      // num_chunk_size = (num_chunk_size + 1) % kBlockSize;
-      DataChunk chunk = table.FetchChunk(start, end);
-      start = end;
-
-      timer.Start();
-      ExecutePipeline(chunk, state, result_table, 0);
-      latency += timer.Elapsed();
-    } while (end < kLHSTupleSize);
-
-#ifdef flag_full_compact
-    timer.Start();
-    {
-      // Flush the tuples in cache.
-      FlushPipelineCache(state, result_table, 0);
-    }
-    latency += timer.Elapsed();
-#endif
+    join_types[i] = types;
+    hts[i] = std::make_unique<HashTable>(kRHSTupleSize, kChunkFactor, kRHSPayLoadLength[i], types, kLoadFactor,
+                                         kBuildDistribution, kSeed + i + 1);
   }
 
-  std::cerr << "------------------ Statistic ------------------\n";
-  std::cerr << "[Total Time]: " << latency << "s\n";
-  BeeProfiler::Get().EndProfiling();
-  ZebraProfiler::Get().ToCSV();
-
-  if (flag_collect_tuples) {
-    // show the joined result.
-    std::cout << "Number of tuples in the result table: " << result_table.NumTuples() << "\n";
-    result_table.Print(8);
+  // Run the strategies one after another on the same data.
+  for (auto &strategy : kStrategies) {
+    std::cerr << "------------------ Strategy: " << strategy.Name() << " ------------------\n";
+    DispatchStrategy(strategy, [&](auto logical, auto compact) {
+      RunPipeline<decltype(logical)::value, decltype(compact)::value>(hts, join_types, *table);
+    });
+    ZebraProfiler::Get().EndSection(strategy.Name());
   }
 
+  WriteProfiles();
   return 0;
 }
 
-void ExecutePipeline(DataChunk &input, PipelineState &state, DataCollection &result_table, size_t level) {
-  auto &hts = state.hts;
-  auto &intermediates = state.intermediates;
-  auto &compactors = state.compactors;
-
-  // The last operator: ResultCollector
-  if (level == hts.size()) {
-    if (flag_collect_tuples) result_table.AppendChunk(input);
-    return;
+template<bool kLogical, CompactType kCompact>
+void RunPipeline(vector<unique_ptr<HashTable>> &hts, vector<vector<AttributeType>> &types, Table &table) {
+  // collect, aggregate, order, or write the results
+  ResultSinks sinks(types.back(), kGroupBy, kAggregates, kOrderBy, kLimit);
+  auto &sink = sinks.Sink();
+
+  // join -> ... -> join -> ResultCollector, with a compactor after each join. Each thread runs its own pipeline, and
+  // the pipelines share the hash tables.
+  if constexpr (kCompact == CompactType::DYNAMIC) CompactTuner::Get().SetEpoch(kTunerEpoch);
+  vector<unique_ptr<Pipeline<kCompact>>> pipelines(kThreads);
+  // the tuner ids of the compactors, assigned by the first pipeline
+  vector<idx_t> tuner_ids;
+  for (size_t t = 0; t < kThreads; ++t) {
+    auto &pipeline = pipelines[t] = std::make_unique<Pipeline<kCompact>>(sink);
+    for (size_t i = 0; i < kJoins; ++i) {
+      pipeline->AddOperator(std::make_unique<PhysicalHashJoin<kLogical>>(*hts[i], i, types[i]));
+      if constexpr (kCompact == CompactType::FULL) {
+        pipeline->InsertCompactor(i, std::make_unique<FullCompaction>(types[i]));
+      } else if constexpr (kCompact == CompactType::DYNAMIC) {
+        // a tuning policy for each join, shared by the compactors of all threads
+        if (t == 0) tuner_ids.push_back(CompactTuner::Get().Initialize(kTuner, PipelineSignature(i, kLogical)));
+        pipeline->InsertCompactor(i, std::make_unique<DynamicCompaction>(tuner_ids[i], i, types[i]));
+      }
+    }
   }
-
-  auto &join_key = input.data_[level];
-  auto &result = intermediates[level];
-  auto &compactor = compactors[level];
-
-  auto ss = hts[level]->Probe(join_key);
-  while (ss.HasNext()) {
-    ss.Next(join_key, input, *result, kEnableLogicalCompact);
-
-#ifdef flag_full_compact
-    // A compactor sits here.
-    compactor->Compact(result);
-    if (result->count_ == 0) continue;
-#endif
-
-    ExecutePipeline(*result, state, result_table, level + 1);
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    if (!kTunerState.empty()) CompactTuner::Get().Load(kTunerState);
   }
-}
-
-void FlushPipelineCache(PipelineState &state, DataCollection &result_table, size_t level) {
-  auto &hts = state.hts;
-  auto &intermediates = state.intermediates;
-  auto &compactors = state.compactors;
 
-  // The last operator: ResultCollector. It has no compactor.
-  if (level == hts.size()) return;
-
-  auto &result = intermediates[level];
-  auto &compactor = compactors[level];
+  Profiler timer;
+  timer.Start();
+  auto statistics = ExecuteMorsels(table, pipelines, kMorselSize * kBlockSize);
+  sinks.Close();
+  double wall_time = timer.Elapsed();
 
-  // Fetch the remaining tuples in the cache.
-  compactor->Flush(result);
+  std::cerr << "------------------ Statistic ------------------\n";
+  PrintWorkerStatistics(statistics, wall_time);
+  sinks.PrintStatistics();
+  BeeProfiler::Get().EndProfiling();
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    if (!kTunerState.empty()) CompactTuner::Get().Save(kTunerState);
+    CompactTuner::Get().Reset(kTunerLog);
+  }
 
-  // Continue the pipeline execution.
-  ExecutePipeline(*result, state, result_table, level + 1);
+  sinks.Print();
+}
 
-  // Flush the next level.
-  FlushPipelineCache(state, result_table, level + 1);
+// The signature of the compactor after the join at [level]: the strategy, the distribution of the probe keys, and
+// the shape of the hash tables of the joins up to it (rows, chunk factor, fan-out, payload). Runs with the same
+// signature can share what the tuner has learned.
+string PipelineSignature(size_t level, bool logical) {
+  std::ostringstream signature;
+  signature << StrategySignature(logical) << "|probe-" << kProbeDistribution.Name() << "-" << kKeyCorrelation << "|";
+  for (size_t i = 0; i <= level; ++i) {
+    signature << "join-" << kRHSTupleSize << "-" << kChunkFactor << "-" << kBuildDistribution.Name() << "-"
+              << kRHSPayLoadLength[i] << "|";
+  }
+  signature << "level-" << level;
+  return signature.str();
 }
 
 void PrintHelp() {
   std::cerr << "Usage: [program_name] [options]\n";
   std::cerr << "Options:\n";
-  std::cerr << "  --block-size [value]      Default Block Size\n";
   std::cerr << "  --join-num [value]        Number of joins\n";
   std::cerr << "  --chunk-factor [value]    Chunk factor\n";
   std::cerr << "  --lhs-size [value]        Size of LHS tuples\n";
   std::cerr << "  --rhs-size [value]        Size of RHS tuples\n";
+  std::cerr << "  --seed [value]            Seed of the generated LHS table\n";
   std::cerr << "  --load-factor [value]     Load factor\n";
+  std::cerr << "  --probe-dist [dist]       Distribution of the LHS join keys: uniform, zipf[:s], or hotset[:keys[:share]]\n";
+  std::cerr << "  --key-correlation [value] Probability that a LHS join key repeats the key of the first join column\n";
+  std::cerr << "  --build-dist [dist]       Fan-out of the RHS keys: constant (chunk factor), uniform, zipf[:s], or hotset\n";
   std::cerr << "  --payload-length=[list]   Comma-separated list of payload lengths for RHS\n";
   std::cerr << "                             Example: --payload-length=0,1000,0,0\n";
+  std::cerr << "  --group-by [list]         Comma-separated group columns of the aggregation at the end of the pipeline\n";
+  std::cerr << "  --aggregate [list]        Aggregate the results instead of collecting them\n";
+  std::cerr << "                             count, sum(col), min(col), or max(col), e.g., count,sum(2)\n";
+  std::cerr << "  --order-by [list]         Sort the results instead of collecting them, e.g., 4:desc,1\n";
+  std::cerr << "  --limit [value]           Keep only the first results of the sort (Top-N)\n";
+  PrintSharedHelp();
 }
 
 int ParseParameters(int argc, char **argv) {
   if (argc != 1) {
     for (int i = 1; i < argc; i++) {
+      if (ParseSharedParameter(argc, argv, i)) continue;
       std::string arg(argv[i]);
 
-      if (arg == "--block-size") {
-        if (i + 1 < argc) {
-          kBlockSize = std::stoi(argv[i + 1]);
-          i++;
-        }
-      } else if (arg == "--join-num") {
+      if (arg == "--join-num") {
         if (i + 1 < argc) {
           kJoins = std::stoi(argv[i + 1]);
           i++;
@@ -203,11 +173,31 @@ int ParseParameters(int argc, char **argv) {
           kLHSTupleSize = std::stoi(argv[i + 1]);
           i++;
         }
+      } else if (arg == "--seed") {
+        if (i + 1 < argc) {
+          kSeed = std::stoull(argv[i + 1]);
+          i++;
+        }
       } else if (arg == "--rhs-size") {
         if (i + 1 < argc) {
           kRHSTupleSize = std::stoi(argv[i + 1]);
           i++;
         }
+      } else if (arg == "--probe-dist") {
+        if (i + 1 < argc) {
+          kProbeDistribution = KeyDistribution::Parse(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--build-dist") {
+        if (i + 1 < argc) {
+          kBuildDistribution = KeyDistribution::Parse(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--key-correlation") {
+        if (i + 1 < argc) {
+          kKeyCorrelation = std::stod(argv[i + 1]);
+          i++;
+        }
       } else if (arg == "--load-factor") {
         if (i + 1 < argc) {
           kLoadFactor = std::stod(argv[i + 1]);
@@ -216,6 +206,26 @@ int ParseParameters(int argc, char **argv) {
       } else if (arg.substr(0, 16) == "--payload-length") {
         // --payload-length=[0,1000,0,0]
         kRHSPayLoadLength = ParseList(arg.substr(17));
+      } else if (arg == "--group-by") {
+        if (i + 1 < argc) {
+          kGroupBy = ParseColumns(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--aggregate") {
+        if (i + 1 < argc) {
+          kAggregates = AggregateSpec::ParseList(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--order-by") {
+        if (i + 1 < argc) {
+          kOrderBy = SortSpec::ParseList(argv[i + 1]);
+          i++;
+        }
+      } else if (arg == "--limit") {
+        if (i + 1 < argc) {
+          kLimit = std::stoul(argv[i + 1]);
+          i++;
+        }
       }
     }
     if (kJoins != kRHSPayLoadLength.size())
@@ -227,15 +237,15 @@ int ParseParameters(int argc, char **argv) {
 
   // show the setting
   std::cerr << "------------------ Setting ------------------\n";
-  if (kEnableLogicalCompact) std::cerr << "Strategy: logical_compaction\n";
-  else std::cerr << "Compaction Strategy: no_compaction\n";
-  std::cerr
-      << "Size of Block: " << kBlockSize << "\n"
-      << "Number of Joins: " << kJoins << "\n"
-      << "Number of LHS Tuple: " << kLHSTupleSize << "\n"
-      << "Number of RHS Tuple: " << kRHSTupleSize << "\n"
-      << "Chunk Factor: " << kChunkFactor << "\n"
-      << "Load Factor: " << kLoadFactor << "\n";
+  PrintSharedSetting();
+  std::cerr << "Number of Joins: " << kJoins << "\n"
+            << "Number of LHS Tuple: " << kLHSTupleSize << "\n"
+            << "Number of RHS Tuple: " << kRHSTupleSize << "\n"
+            << "Chunk Factor: " << kChunkFactor << "\n"
+            << "Load Factor: " << kLoadFactor << "\n";
+  std::cerr << "Probe Keys: " << kProbeDistribution.Name() << ", correlation " << kKeyCorrelation << "\n"
+            << "Build Fan-out: " << kBuildDistribution.Name() << "\n";
+  PrintSinkSetting();
   std::cerr << "RHS Payload Lengths: [";
   for (size_t i = 0; i < kJoins; ++i) {
     if (i != kJoins - 1) std::cerr << kRHSPayLoadLength[i] << ",";
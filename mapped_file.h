@@ -0,0 +1,68 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// mapped_file.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base.h"
+
+namespace compaction {
+// A file mapped read-only into memory, for the table files and the CSV files. The pages are read on the first access,
+// so Advise tells the kernel how the file is going to be read.
+class MappedFile {
+ public:
+  explicit MappedFile(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open the file: " + path);
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("Cannot stat the file: " + path);
+    }
+    size_ = st.st_size;
+    if (size_ > 0) {
+      void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Cannot map the file: " + path);
+      }
+      data_ = static_cast<char *>(data);
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    if (data_ != nullptr) munmap(data_, size_);
+  }
+
+  inline const char *Data() const { return data_; }
+
+  inline size_t Size() const { return size_; }
+
+  // madvise [advice] for the bytes [offset, offset + bytes), e.g., MADV_SEQUENTIAL or MADV_WILLNEED.
+  inline void Advise(size_t offset, size_t bytes, int advice) const {
+    if (data_ == nullptr) return;
+    // madvise takes a page-aligned address
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t start = offset / page * page;
+    madvise(data_ + start, std::min(offset + bytes, size_) - start, advice);
+  }
+
+ private:
+  char *data_ = nullptr;
+  size_t size_ = 0;
+};
+}
@@ -1,5 +1,5 @@
 //===----------------------------------------------------------------------===//
-//                         DuckDB
+//                         Compaction
 //
 // negative_feedback.hpp
 //
@@ -13,29 +13,65 @@
 #include <random>
 #include <mutex>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
 
 #include "base.h"
+#include "profiler.h"
+#include "tuner_policy.hpp"
+#include "cost_model.hpp"
 
 namespace compaction {
 
 // I use UCB1 (https://cse442-17f.github.io/LinUCB/) to select the best
-class MultiArmedBandit {
+class MultiArmedBandit : public TunerPolicy {
  public:
   MultiArmedBandit(size_t n_arms, const std::vector<double> &means)
       : kArms_(n_arms),
+        select_times_(0),
+        n_select_(n_arms, 0),
         est_rewards_(means),
         est_square_rewards_(n_arms, 0),
-        n_select_(n_arms, 0),
-        select_times_(0),
         stage_update_times_(0),
         stage_n_update_(n_arms, 0),
         n_start_sampling_(0) {
   }
 
   // Selects an arm based on the UCB1 algorithm
-  inline size_t SelectArm() {
-    std::lock_guard<std::mutex> lock(mutex_);
+  size_t SelectArm(const TunerContext & /*context*/) override { return SelectArm(); }
+
+  void UpdateArm(const TunerContext & /*context*/, size_t arm, double reward) override { UpdateArm(arm, reward); }
+
+  void Replay(const TunerContext & /*context*/, size_t arm, double reward) override {
+    if (n_start_sampling_ < kArms_ * kStartSampling) n_start_sampling_++;
+    select_times_++;
+    n_select_[arm]++;
+    UpdateArm(arm, reward);
+  }
+
+  std::unique_ptr<TunerPolicy> Clone() const override { return std::make_unique<MultiArmedBandit>(*this); }
 
+  void Save(std::ostream &out) const override {
+    out << select_times_ << ' ' << stage_update_times_ << ' ';
+    SaveVector(out, n_select_);
+    SaveVector(out, est_rewards_);
+    SaveVector(out, est_square_rewards_);
+    SaveVector(out, stage_n_update_);
+  }
+
+  // The saved estimates replace all but [kWarmStartSampling] rounds of the initial sampling.
+  bool Load(std::istream &in) override {
+    if (!(in >> select_times_ >> stage_update_times_)) return false;
+    if (!LoadVector(in, n_select_) || !LoadVector(in, est_rewards_) || !LoadVector(in, est_square_rewards_)
+        || !LoadVector(in, stage_n_update_)) {
+      return false;
+    }
+    n_start_sampling_ = kArms_ * (kStartSampling - kWarmStartSampling);
+    return true;
+  }
+
+  inline size_t SelectArm() {
     if (n_start_sampling_ < kArms_ * kStartSampling) {
       // initialize experimental means by pulling each arm once
       size_t arm = n_start_sampling_ % kArms_;
@@ -64,8 +100,6 @@ class MultiArmedBandit {
 
   // Updates the arm with the given weight
   inline void UpdateArm(size_t arm, double reward) {
-    std::lock_guard<std::mutex> lock(mutex_);
-
     if (select_times_ % kHeart == 0 && n_start_sampling_ >= kArms_ * kStartSampling) {
       history_.emplace_back(est_rewards_, n_select_);
 
@@ -91,14 +125,14 @@ class MultiArmedBandit {
     stage_n_update_[arm]++;
   }
 
-  inline void Print(const std::vector<size_t> &values) {
+  void Print(const std::vector<size_t> &values) override {
     for (size_t i = 0; i < est_rewards_.size(); i++) {
       std::cerr << " [PARAMETERS] Estimated reward for arm " << values[i] << " is " << std::to_string(est_rewards_[i])
                 << " - Sampling times is " << n_select_[i] << "\n";
     }
   }
 
-  inline void Log2Csv(std::string addr) {
+  void Log2Csv(std::string addr) override {
     std::ofstream file(addr);
 
     // Check if file is open
@@ -133,6 +167,7 @@ class MultiArmedBandit {
   size_t kArms_;
   double kEpsilon = 0.1;
   size_t kStartSampling = 12;
+  size_t kWarmStartSampling = 1;
 
  private:
   // stats
@@ -141,7 +176,6 @@ class MultiArmedBandit {
 
  private:
   // UCB-tuned
-  std::mutex mutex_;
   std::vector<double> est_rewards_;
   std::vector<double> est_square_rewards_;
   size_t stage_update_times_;
@@ -164,6 +198,157 @@ class MultiArmedBandit {
   std::vector<Record> history_;
 };
 
+// Thompson sampling with a Gaussian posterior on the reward of each arm.
+class ThompsonSampling : public TunerPolicy {
+ public:
+  explicit ThompsonSampling(size_t n_arms)
+      : kArms_(n_arms), n_update_(n_arms, 0), est_rewards_(n_arms, 0), est_m2_(n_arms, 0), gen_(n_arms) {}
+
+  size_t SelectArm(const TunerContext & /*context*/) override {
+    // sample a mean reward for each arm, and pick the arm with the best sample
+    double max_value = -std::numeric_limits<double>::max();
+    size_t max_arm = 0;
+    for (size_t i = 0; i < kArms_; i++) {
+      // each arm is pulled once before sampling
+      if (n_update_[i] == 0) return i;
+
+      double var = n_update_[i] > 1 ? est_m2_[i] / (n_update_[i] - 1) : 0;
+      double std = sqrt(std::max(var, kMinVariance * est_rewards_[i] * est_rewards_[i]) / n_update_[i]);
+      double value = std::normal_distribution<double>(est_rewards_[i], std)(gen_);
+      if (value > max_value) {
+        max_value = value;
+        max_arm = i;
+      }
+    }
+    return max_arm;
+  }
+
+  void UpdateArm(const TunerContext & /*context*/, size_t arm, double reward) override {
+    // Welford's update until [kWindow] rewards are seen. Then the count stays at [kWindow] and the old rewards decay
+    // by (kWindow - 1) / kWindow per update, so that the posterior can follow the workload.
+    bool full = n_update_[arm] == kWindow;
+    if (!full) n_update_[arm]++;
+    double n = n_update_[arm];
+    double delta = reward - est_rewards_[arm];
+    est_rewards_[arm] += delta / n;
+    if (full) est_m2_[arm] *= (n - 1) / n;
+    est_m2_[arm] += delta * (reward - est_rewards_[arm]);
+  }
+
+  std::unique_ptr<TunerPolicy> Clone() const override { return std::make_unique<ThompsonSampling>(*this); }
+
+  void Save(std::ostream &out) const override {
+    SaveVector(out, n_update_);
+    SaveVector(out, est_rewards_);
+    SaveVector(out, est_m2_);
+  }
+
+  // The saved posterior counts as at most [kWarmStartUpdates] updates, so that it is still open to new rewards.
+  bool Load(std::istream &in) override {
+    if (!LoadVector(in, n_update_) || !LoadVector(in, est_rewards_) || !LoadVector(in, est_m2_)) return false;
+    for (size_t i = 0; i < kArms_; ++i) {
+      size_t n_update = std::min(n_update_[i], kWarmStartUpdates);
+      if (n_update_[i] > 0) est_m2_[i] = est_m2_[i] * n_update / n_update_[i];
+      n_update_[i] = n_update;
+    }
+    return true;
+  }
+
+  void Print(const std::vector<size_t> &values) override {
+    for (size_t i = 0; i < kArms_; i++) {
+      std::cerr << " [PARAMETERS] Estimated reward for arm " << values[i] << " is " << std::to_string(est_rewards_[i])
+                << " - Updating times is " << n_update_[i] << "\n";
+    }
+  }
+
+ private:
+  size_t kArms_;
+  size_t kWindow = 64;
+  size_t kWarmStartUpdates = 8;
+  double kMinVariance = 1e-4;
+
+  std::vector<size_t> n_update_;
+  std::vector<double> est_rewards_;
+  std::vector<double> est_m2_;
+
+  std::mt19937 gen_;
+};
+
+// A contextual bandit: one UCB bandit for each (input fullness, fan-out) bucket.
+class ContextualBandit : public TunerPolicy {
+ public:
+  explicit ContextualBandit(size_t n_arms) : kArms_(n_arms) {
+    for (size_t i = 0; i < kFullnessBins * kFanOutBins; ++i) {
+      bandits_.push_back(std::make_unique<MultiArmedBandit>(n_arms, std::vector<double>(n_arms, 0)));
+    }
+  }
+
+  size_t SelectArm(const TunerContext &context) override { return bandits_[Bin(context)]->SelectArm(); }
+
+  void UpdateArm(const TunerContext &context, size_t arm, double reward) override {
+    bandits_[Bin(context)]->UpdateArm(arm, reward);
+  }
+
+  void Replay(const TunerContext &context, size_t arm, double reward) override {
+    bandits_[Bin(context)]->Replay(context, arm, reward);
+  }
+
+  std::unique_ptr<TunerPolicy> Clone() const override {
+    auto clone = std::make_unique<ContextualBandit>(kArms_);
+    for (size_t i = 0; i < bandits_.size(); ++i) clone->bandits_[i] = std::make_unique<MultiArmedBandit>(*bandits_[i]);
+    return clone;
+  }
+
+  void Save(std::ostream &out) const override {
+    for (auto &bandit : bandits_) bandit->Save(out);
+  }
+
+  bool Load(std::istream &in) override {
+    for (auto &bandit : bandits_) {
+      if (!bandit->Load(in)) return false;
+    }
+    return true;
+  }
+
+  void Print(const std::vector<size_t> &values) override {
+    for (size_t i = 0; i < bandits_.size(); ++i) {
+      std::cerr << " [PARAMETERS] Context - fullness bin " << i / kFanOutBins << ", fan-out bin " << i % kFanOutBins
+                << "\n";
+      bandits_[i]->Print(values);
+    }
+  }
+
+ private:
+  // fullness: [0, 0.25), [0.25, 0.5), [0.5, 0.75), [0.75, 1]; fan-out: [0, 0.5), [0.5, 1), [1, 2), [2, +inf)
+  static inline size_t Bin(const TunerContext &context) {
+    size_t fullness = std::min(size_t(context.fullness_ * kFullnessBins), kFullnessBins - 1);
+    size_t fan_out = context.fan_out_ < 0.5 ? 0 : context.fan_out_ < 1 ? 1 : context.fan_out_ < 2 ? 2 : 3;
+    return fullness * kFanOutBins + fan_out;
+  }
+
+  static constexpr size_t kFullnessBins = 4;
+  static constexpr size_t kFanOutBins = 4;
+
+  size_t kArms_;
+  std::vector<std::unique_ptr<MultiArmedBandit>> bandits_;
+};
+
+inline std::unique_ptr<TunerPolicy> CreatePolicy(TunerType type, const std::vector<size_t> &arms) {
+  switch (type) {
+    case TunerType::UCB: return std::make_unique<MultiArmedBandit>(arms.size(), std::vector<double>(arms.size(), 0));
+    case TunerType::THOMPSON: return std::make_unique<ThompsonSampling>(arms.size());
+    case TunerType::CONTEXTUAL: return std::make_unique<ContextualBandit>(arms.size());
+    case TunerType::COST_MODEL: return std::make_unique<CostModelPolicy>(arms);
+  }
+  throw std::runtime_error("Unknown tuner type");
+}
+
+// The tuner keeps one policy for each compactor. A threshold is kept for an epoch of [kEpoch] calls, the rewards of
+// the calls are averaged, and the policy learns from the epoch as a whole.
+//
+// Each thread tunes with its own copy of the policies, without any synchronization. The thread logs what it learns,
+// and every [kSyncEpochs] epochs it replays the log into the global policy and takes a fresh copy of it, so the only
+// lock is taken once per [kSyncEpochs] epochs per thread.
 class CompactTuner {
  public:
   static CompactTuner &Get() {
@@ -171,93 +356,362 @@ class CompactTuner {
     return instance;
   }
 
-  inline void Initialize(size_t address, const std::vector<size_t> &arms = {0, 32, 64, 128, 256, 384, 512, 768, 1024}) {
-    assert(package_index_.count(address) == 0);
+  // Adds a policy for a compactor, and returns its id, which the compactors of all threads at that place in the
+  // pipeline pass to the tuner. The signature identifies the compactor across runs (operator types, level, payload
+  // lengths, ...).
+  inline idx_t Initialize(TunerType type = TunerType::UCB,
+                          const std::string &signature = "",
+                          const std::vector<size_t> &arms = {0, 32, 64, 128, 256, 384, 512, 768, 1024}) {
+    lock_guard<mutex> lock(mutex_);
+    bandit_packages_.emplace_back(type, arms, signature);
+    return bandit_packages_.size() - 1;
+  }
 
-    package_index_[address] = bandit_packages_.size();
-    bandit_packages_.emplace_back(arms, std::vector<double>(arms.size(), 0));
+  // Warm-starts the policies whose signature, policy and arms match a state saved in [path]. The file has a line
+  // for each (signature, policy): "<signature>|<policy>\t<arms> <state of the policy>".
+  // Must be called before any thread starts tuning. Returns the number of policies it warm-started.
+  inline size_t Load(const std::string &path) {
+    lock_guard<mutex> lock(mutex_);
+
+    auto states = ReadStates(path);
+    size_t n_loaded = 0;
+    for (auto &package : bandit_packages_) {
+      auto it = states.find(StateKey(package));
+      if (package.signature_.empty() || it == states.end()) continue;
+
+      std::istringstream in(it->second);
+      std::vector<size_t> arms(package.value.size());
+      if (LoadVector(in, arms) && arms == package.value && package.policy->Load(in)) {
+        n_loaded++;
+      } else {
+        // a state with other arms or a broken state: start from scratch
+        package.policy = CreatePolicy(package.type_, package.value);
+      }
+    }
+    std::cerr << "[Tuner State] Warm start " << n_loaded << " of " << bandit_packages_.size() << " compactors from "
+              << path << "\n";
+    return n_loaded;
   }
 
-  // Selects an arm based on the UCB1 algorithm
-  inline size_t SelectArm(idx_t id) {
-    auto &bandit = bandit_packages_[id].bandit;
-    auto &value = bandit_packages_[id].value;
+  // Saves the policies into [path], replacing the states with the same signatures and keeping the others.
+  // Must be called when no thread is tuning.
+  inline void Save(const std::string &path) {
+    lock_guard<mutex> lock(mutex_);
+    MergeLocals();
+
+    auto states = ReadStates(path);
+    for (auto &package : bandit_packages_) {
+      if (package.signature_.empty()) continue;
+
+      std::ostringstream out;
+      out.precision(17);
+      SaveVector(out, package.value);
+      package.policy->Save(out);
+      states[StateKey(package)] = out.str();
+    }
 
-    size_t ret = value[bandit->SelectArm()];
-    return ret;
+    std::ofstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Unable to open file " + path);
+    file << kStateHeader << "\n";
+    for (auto &pair : states) file << pair.first << '\t' << pair.second << '\n';
   }
 
-  // Updates the arm with the given weight
+  inline void SetEpoch(size_t epoch) { kEpoch = std::max(epoch, size_t(1)); }
+
+  // Returns the threshold of the current epoch, and starts a new epoch if needed
+  inline size_t SelectArm(idx_t id) {
+    auto &package = Local(id);
+    if (package.n_call_ == 0) package.arm_ = package.policy_->SelectArm(package.context_);
+    return package.value_[package.arm_];
+  }
+
+  // Records the reward of one call, the policy is updated at the end of the epoch
   inline void UpdateArm(idx_t id, size_t arm, double reward) {
-    auto &bandit = bandit_packages_[id].bandit;
-    auto &value_index = bandit_packages_[id].value_index;
+    auto &package = Local(id);
+
+    if (arm != package.value_[package.arm_]) return;
+    package.reward_ += reward;
+    if (++package.n_call_ < kEpoch) return;
 
-    if (value_index.count(arm) == 0) return;
-    bandit->UpdateArm(value_index[arm], reward);
+    double epoch_reward = package.reward_ / package.n_call_;
+    package.policy_->UpdateArm(package.context_, package.arm_, epoch_reward);
+    package.log_.push_back({TunerEvent::EPOCH, package.arm_, epoch_reward, package.context_});
+
+    // the context of the next epoch is what we observed in this epoch
+    if (package.n_input_ > 0) {
+      package.context_.fullness_ = double(package.input_tuples_) / package.n_input_ / kBlockSize;
+    }
+    if (package.input_tuples_ > 0) {
+      package.context_.fan_out_ = double(package.output_tuples_) / package.input_tuples_;
+    }
+    package.n_call_ = 0;
+    package.reward_ = 0;
+    package.n_input_ = package.input_tuples_ = package.output_tuples_ = 0;
+
+    if (++package.n_epoch_ % kSyncEpochs == 0) Sync(id, package);
+  }
+
+  // A chunk of [n_tuples] enters the operator in front of the compactor.
+  inline void ObserveInput(idx_t id, size_t n_tuples) {
+    auto &package = Local(id);
+    package.n_input_++;
+    package.input_tuples_ += n_tuples;
+  }
+
+  // The operator in front of the compactor produces a chunk of [n_tuples].
+  inline void ObserveOutput(idx_t id, size_t n_tuples) {
+    auto &package = Local(id);
+    package.output_tuples_ += n_tuples;
+    if (package.observe_costs_ && n_tuples != 0) {
+      package.policy_->ObserveChunk(n_tuples);
+      package.log_.push_back({TunerEvent::CHUNK, n_tuples, 0, package.context_});
+    }
+  }
+
+  // Whether the policy of the compactor needs the compaction and downstream costs.
+  inline bool ObserveCosts(idx_t id) { return Local(id).observe_costs_; }
+
+  inline void ObserveCompact(idx_t id, size_t n_tuples, double time) {
+    auto &package = Local(id);
+    package.policy_->ObserveCompact(n_tuples, time);
+    package.log_.push_back({TunerEvent::COMPACT, n_tuples, time, package.context_});
+  }
+
+  inline void ObserveDownstream(idx_t id, size_t n_tuples, double time) {
+    auto &package = Local(id);
+    package.policy_->ObserveDownstream(n_tuples, time);
+    package.log_.push_back({TunerEvent::DOWNSTREAM, n_tuples, time, package.context_});
   }
 
+  // Must be called when no thread is tuning. With [enable_log], prints the estimates of each compactor, and writes
+  // into ./bandit_log_0x<random>/ its epochs (Id-<n>.csv: epoch, threshold, reward) and the log of its policy
+  // (Id-<n>.log, see Log2Csv).
   inline void Reset(bool enable_log = false) {
+    lock_guard<mutex> lock(mutex_);
+    MergeLocals();
+
     if (!bandit_packages_.empty() && enable_log) {
       // output the parameters
       std::cerr << "-------\n";
 
       std::string folder_name = "./bandit_log_0x" + std::to_string(RandomInteger());
       std::filesystem::create_directories(folder_name);
-      for (auto &pair : package_index_) {
-        auto &addr = pair.first;
-        auto &id = pair.second;
+      for (size_t id = 0; id < bandit_packages_.size(); ++id) {
+        auto &package = bandit_packages_[id];
+
+        std::string bandit_name = "Id-" + std::to_string(id);
+        std::cerr << " [PARAMETERS] Compactor - " << bandit_name << "\t" << package.signature_ << "\n";
+        std::ofstream epochs(folder_name + "/" + bandit_name + ".csv");
+        if (!epochs.is_open()) throw std::runtime_error("Unable to open file " + folder_name + "/" + bandit_name + ".csv");
+        epochs << "epoch, threshold, reward\n";
+        for (size_t epoch = 0; epoch < package.history_.size(); ++epoch) {
+          epochs << epoch << ", " << package.history_[epoch].first << ", " << package.history_[epoch].second << "\n";
+        }
+        package.policy->Log2Csv(folder_name + "/" + bandit_name + ".log");
+        package.policy->Print(package.value);
+      }
+      std::cerr << " [PARAMETERS] Logs in " << folder_name << "\n";
+    }
+    if (!bandit_packages_.empty()) PrintReport();
 
-        auto &bandit = bandit_packages_[id].bandit;
-        auto &value = bandit_packages_[id].value;
+    bandit_packages_.clear();
+    locals_.clear();
+    generation_++;
+  }
 
-        std::string bandit_name = "0x" + std::to_string(addr) + "\tId-" + std::to_string(id);
-        std::cerr << " [PARAMETERS] Compaction Address - " << bandit_name << "\n";
-        bandit->Log2Csv("./" + folder_name + "/" + bandit_name + ".log");
-        bandit->Print(value);
+  // Policy comparison report: for each compactor, how many epochs the policy needs to settle on a threshold.
+  // A policy has converged at epoch e if, from e on, every window of [kWindow] epochs picks the final threshold (the
+  // most frequent one in the last window) at least [kShare] of the time.
+  inline void PrintReport() const {
+    std::cerr << "-------\n";
+    for (size_t id = 0; id < bandit_packages_.size(); ++id) {
+      auto &package = bandit_packages_[id];
+      auto &history = package.history_;
+      size_t n_epoch = history.size();
+      if (n_epoch == 0) continue;
+
+      size_t window = std::min(kWindow, n_epoch);
+      std::unordered_map<size_t, size_t> freq;
+      for (size_t i = n_epoch - window; i < n_epoch; ++i) freq[history[i].first]++;
+      size_t final_threshold = history.back().first;
+      for (auto &pair : freq) {
+        if (pair.second > freq[final_threshold]) final_threshold = pair.first;
       }
 
-      package_index_.clear();
-      bandit_packages_.clear();
-    }
-  }
+      size_t converged = 0, hits = 0;
+      for (size_t i = 0; i < n_epoch; ++i) {
+        hits += history[i].first == final_threshold;
+        if (i >= window) hits -= history[i - window].first == final_threshold;
+        if (i + 1 >= window && hits < kShare * window) converged = i + 1;
+      }
 
-  inline int64_t GetId(size_t address) {
-    if (package_index_.count(address) == 0) {
-      // not found
-      return -1;
-    }
+      double mean_reward = 0;
+      for (auto &record : history) mean_reward += record.second;
+      mean_reward /= n_epoch;
 
-    return package_index_[address];
+      std::cerr << "[Tuner Report] Policy: " << TunerName(package.type_) << "\tId-" << id << "\tEpochs: " << n_epoch
+                << "\tConverged at epoch: " << (converged + window > n_epoch ? "-" : std::to_string(converged))
+                << "\tThreshold: " << final_threshold << "\tMean reward: " << mean_reward << '\n';
+    }
   }
 
   inline size_t GetBanditSize() {
     return bandit_packages_.size();
   }
 
+  // The epochs of the compactor [id] that the threads have merged into its global policy so far.
+  inline size_t MergedEpochs(idx_t id) {
+    lock_guard<mutex> lock(mutex_);
+    return bandit_packages_[id].history_.size();
+  }
+
  private:
   inline size_t RandomInteger() {
     return integers(gen_);
   }
 
+  struct TunerEvent {
+    enum Type : uint8_t { EPOCH, CHUNK, COMPACT, DOWNSTREAM };
+
+    Type type_;
+    // the arm of an epoch, or the chunk size of an observation
+    size_t key_;
+    // the reward of an epoch, or the time of an observation
+    double value_;
+    TunerContext context_;
+  };
+
+  // The global state of a compactor
   struct BanditPackage {
-    std::unique_ptr<MultiArmedBandit> bandit;
+    TunerType type_;
+    std::unique_ptr<TunerPolicy> policy;
     std::vector<size_t> value;
-    std::unordered_map<size_t, idx_t> value_index;
+    std::string signature_;
 
-    BanditPackage(const std::vector<size_t> &arms, const std::vector<double> &means) {
-      bandit = std::make_unique<MultiArmedBandit>(arms.size(), means);
+    // (threshold, reward) of each epoch
+    std::vector<std::pair<size_t, double>> history_;
+
+    BanditPackage(TunerType type, const std::vector<size_t> &arms, std::string signature)
+        : type_(type), signature_(std::move(signature)) {
+      policy = CreatePolicy(type, arms);
       value = arms;
-      for (size_t i = 0; i < arms.size(); i++) {
-        value_index[arms[i]] = i;
-      }
     }
   };
 
-  std::unordered_map<size_t, idx_t> package_index_;
+  // The state of a compactor in one thread
+  struct LocalPackage {
+    std::unique_ptr<TunerPolicy> policy_;
+    // the thresholds of the arms, a copy: the global packages move when a compactor is added
+    std::vector<size_t> value_;
+    bool observe_costs_ = false;
+
+    // epoch
+    size_t arm_ = 0;
+    size_t n_call_ = 0;
+    size_t n_epoch_ = 0;
+    double reward_ = 0;
+    TunerContext context_;
+    size_t n_input_ = 0;
+    size_t input_tuples_ = 0;
+    size_t output_tuples_ = 0;
+
+    // what the thread learned since the last sync
+    std::vector<TunerEvent> log_;
+  };
+
+  struct LocalTuner {
+    size_t generation_ = 0;
+    std::vector<LocalPackage> packages_;
+  };
+
+  inline LocalPackage &Local(idx_t id) {
+    thread_local std::shared_ptr<LocalTuner> local;
+    if (local == nullptr || local->generation_ != generation_) {
+      // the first call of this thread in this run
+      local = std::make_shared<LocalTuner>();
+      lock_guard<mutex> lock(mutex_);
+      local->generation_ = generation_;
+      locals_.push_back(local);
+    }
+
+    if (id >= local->packages_.size()) local->packages_.resize(id + 1);
+    auto &package = local->packages_[id];
+    if (package.policy_ == nullptr) {
+      lock_guard<mutex> lock(mutex_);
+      package.policy_ = bandit_packages_[id].policy->Clone();
+      package.value_ = bandit_packages_[id].value;
+      package.observe_costs_ = package.policy_->ObserveCosts();
+    }
+    return package;
+  }
+
+  // Replays the log of a thread into the global policy. The caller holds the lock.
+  inline void Merge(idx_t id, LocalPackage &package) {
+    auto &global = bandit_packages_[id];
+    for (auto &event : package.log_) {
+      switch (event.type_) {
+        case TunerEvent::EPOCH: {
+          global.policy->Replay(event.context_, event.key_, event.value_);
+          global.history_.emplace_back(global.value[event.key_], event.value_);
+          break;
+        }
+        case TunerEvent::CHUNK: global.policy->ObserveChunk(event.key_); break;
+        case TunerEvent::COMPACT: global.policy->ObserveCompact(event.key_, event.value_); break;
+        case TunerEvent::DOWNSTREAM: global.policy->ObserveDownstream(event.key_, event.value_); break;
+      }
+    }
+    package.log_.clear();
+  }
+
+  // Merges what the threads have learned since their last sync. The caller holds the lock.
+  inline void MergeLocals() {
+    for (auto &local : locals_) {
+      if (local->generation_ != generation_) continue;
+      for (size_t id = 0; id < local->packages_.size(); ++id) {
+        if (local->packages_[id].policy_ != nullptr) Merge(id, local->packages_[id]);
+      }
+    }
+  }
+
+  static inline std::string StateKey(const BanditPackage &package) {
+    return package.signature_ + "|" + TunerName(package.type_);
+  }
+
+  // signature|policy -> saved state
+  inline std::map<std::string, std::string> ReadStates(const std::string &path) {
+    std::map<std::string, std::string> states;
+    std::ifstream file(path);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line) || line != kStateHeader) return states;
+
+    while (std::getline(file, line)) {
+      auto pos = line.find('\t');
+      if (pos != std::string::npos) states[line.substr(0, pos)] = line.substr(pos + 1);
+    }
+    return states;
+  }
+
+  inline void Sync(idx_t id, LocalPackage &package) {
+    lock_guard<mutex> lock(mutex_);
+    Merge(id, package);
+    package.policy_ = bandit_packages_[id].policy->Clone();
+  }
+
+  const std::string kStateHeader = "# compaction tuner state v1";
+  size_t kEpoch = 16;
+  size_t kSyncEpochs = 4;
+  size_t kWindow = 32;
+  double kShare = 0.75;
+
+  mutable mutex mutex_;
   std::vector<BanditPackage> bandit_packages_;
 
+  // the tuners of the threads, and the run they belong to
+  std::vector<std::shared_ptr<LocalTuner>> locals_;
+  atomic<size_t> generation_{1};
+
   // random
   std::mt19937 gen_;
   std::uniform_int_distribution<int> integers;
 };
-}  // namespace duckdb
\ No newline at end of file
+}  // namespace compaction
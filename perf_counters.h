@@ -0,0 +1,187 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// perf_counters.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace compaction {
+
+// Counts hardware events (cycles, instructions, L1D / LLC misses, branch misses) of the calling thread with
+// perf_event_open. If the hardware events are not available (e.g., in a VM, or with a strict perf_event_paranoid), it
+// falls back to software events, and if those are not available either, it stays disabled.
+//
+// Each thread opens its own counter group on first use, and reads the whole group with one read(). When the kernel
+// multiplexes the group with other events, the counts are scaled by the time the group was enabled over the time it
+// was running, as perf stat does. An event that some thread could not open is reported as unavailable.
+class PerfCounters {
+ public:
+  static constexpr size_t kMaxEvents = 5;
+  using Values = std::array<uint64_t, kMaxEvents>;
+
+  // Picks the event set. Returns false if no event can be counted. Must be called before any thread reads.
+  static bool Enable() {
+    auto &config = Config();
+    config.events_ = HardwareEvents();
+    ClearMissing();
+    if (!PerfCounters(config.events_).Valid()) {
+      config.events_ = SoftwareEvents();
+      ClearMissing();
+      if (!PerfCounters(config.events_).Valid()) config.events_.clear();
+    }
+    config.enabled_ = !config.events_.empty();
+    return config.enabled_;
+  }
+
+  static inline bool Enabled() { return Config().enabled_; }
+
+  static inline size_t NumEvents() { return Config().events_.size(); }
+
+  static inline const std::string &EventName(size_t i) { return Config().events_[i].name_; }
+
+  // Whether every thread could open the event [i]. The counts of an unavailable event are meaningless.
+  static inline bool Available(size_t i) { return !Config().missing_[i].load(std::memory_order_relaxed); }
+
+  // Reads the counters of the calling thread, scaled to the time the group was enabled. Counters that could not be
+  // opened read as 0, and are not Available.
+  static inline void Read(Values &values) {
+    thread_local PerfCounters counters(Config().events_);
+    counters.ReadGroup(values);
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds_) {
+      if (fd >= 0) close(fd);
+    }
+#endif
+  }
+
+ private:
+  struct Event {
+    std::string name_;
+    uint32_t type_;
+    uint64_t config_;
+  };
+
+  struct Configuration {
+    bool enabled_ = false;
+    std::vector<Event> events_;
+    // the events that a thread could not open
+    std::array<std::atomic<bool>, kMaxEvents> missing_{};
+  };
+
+  static Configuration &Config() {
+    static Configuration config;
+    return config;
+  }
+
+  static inline void ClearMissing() {
+    for (auto &missing : Config().missing_) missing.store(false, std::memory_order_relaxed);
+  }
+
+#ifdef __linux__
+  static std::vector<Event> HardwareEvents() {
+    uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    return {{"Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {"Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {"L1D Misses", PERF_TYPE_HW_CACHE, l1d_read_miss},
+            {"LLC Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {"Branch Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+  }
+
+  static std::vector<Event> SoftwareEvents() {
+    return {{"Task Clock (ns)", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+            {"Page Faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+            {"Context Switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+            {"CPU Migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}};
+  }
+
+  // Opens the events as one group, led by the first event that can be opened.
+  explicit PerfCounters(const std::vector<Event> &events) : fds_(events.size(), -1), slots_(events.size(), -1) {
+    int leader = -1;
+    size_t n_open = 0;
+    for (size_t i = 0; i < events.size(); ++i) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = events[i].type_;
+      attr.config = events[i].config_;
+      attr.disabled = leader == -1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+      if (fd < 0) {
+        Config().missing_[i].store(true, std::memory_order_relaxed);
+        continue;
+      }
+      if (leader == -1) leader = fd;
+      fds_[i] = fd;
+      slots_[i] = int(n_open++);
+    }
+    if (leader != -1) {
+      ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    leader_ = leader;
+    n_open_ = n_open;
+  }
+
+  inline void ReadGroup(Values &values) const {
+    values.fill(0);
+    if (leader_ < 0) return;
+
+    // PERF_FORMAT_GROUP with the total times: {nr, time_enabled, time_running, values[nr]}
+    uint64_t buffer[kMaxEvents + 3];
+    if (read(leader_, buffer, sizeof(uint64_t) * (n_open_ + 3)) <= 0) return;
+    uint64_t enabled = buffer[1], running = buffer[2];
+    // the group has not been scheduled yet
+    if (running == 0) return;
+
+    double scale = double(enabled) / double(running);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i] < 0) continue;
+      uint64_t count = buffer[slots_[i] + 3];
+      values[i] = running == enabled ? count : uint64_t(double(count) * scale);
+    }
+  }
+#else
+  static std::vector<Event> HardwareEvents() { return {}; }
+
+  static std::vector<Event> SoftwareEvents() { return {}; }
+
+  explicit PerfCounters(const std::vector<Event> &events) {}
+
+  inline void ReadGroup(Values &values) const { values.fill(0); }
+#endif
+
+  inline bool Valid() const { return leader_ >= 0; }
+
+  std::vector<int> fds_;
+  // the position of each event in the group read
+  std::vector<int> slots_;
+  int leader_ = -1;
+  size_t n_open_ = 0;
+};
+}
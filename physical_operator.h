@@ -0,0 +1,170 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// physical_operator.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "base.h"
+#include "hash_table.h"
+#include "data_collection.h"
+#include "filter_operator.h"
+
+namespace compaction {
+
+enum class OperatorResultType : uint8_t {
+  // the operator is done with the input chunk
+  NEED_MORE_INPUT = 0,
+  // the operator has more output for the same input chunk, and must be called again
+  HAVE_MORE_OUTPUT = 1
+};
+
+// The state of an operator in one pipeline, e.g., the probe in progress of a join or the profiler of a filter.
+// Execute is const: whatever an operator writes per chunk lives here, so that several pipelines can share the
+// operator.
+class OperatorState {
+ public:
+  virtual ~OperatorState() = default;
+};
+
+// An operator in a push-based pipeline. The pipeline pushes each input chunk into Execute until the operator needs
+// more input, then Flush once the input is exhausted, and Finalize at the end.
+class PhysicalOperator {
+ public:
+  // [name] is a string literal: the tracer keeps it after the operator is gone.
+  PhysicalOperator(const char *name, const vector<AttributeType> &types) : name_(name), types_(types) {}
+
+  virtual ~PhysicalOperator() = default;
+
+  virtual unique_ptr<OperatorState> GetState() const { return std::make_unique<OperatorState>(); }
+
+  // Processes [input] into [output]. The output may be empty.
+  virtual OperatorResultType Execute(DataChunk &input, DataChunk &output, OperatorState &state) const = 0;
+
+  // Emits the tuples the operator still holds after the last input.
+  virtual OperatorResultType Flush(DataChunk &output, OperatorState & /*state*/) const {
+    output.Reset();
+    return OperatorResultType::NEED_MORE_INPUT;
+  }
+
+  virtual void Finalize(OperatorState & /*state*/) const {}
+
+  // the schema of the output
+  const vector<AttributeType> &Types() const { return types_; }
+
+  const char *const name_;
+
+ protected:
+  vector<AttributeType> types_;
+};
+
+// The end of a pipeline.
+class PhysicalSink {
+ public:
+  virtual ~PhysicalSink() = default;
+
+  virtual unique_ptr<OperatorState> GetState() const { return std::make_unique<OperatorState>(); }
+
+  virtual void Sink(DataChunk &input, OperatorState &state) = 0;
+
+  virtual void Finalize(OperatorState & /*state*/) {}
+};
+
+// Filters on the column [col_id].
+class PhysicalFilter : public PhysicalOperator {
+ public:
+  PhysicalFilter(double selectivity, size_t col_id, const vector<AttributeType> &types)
+      : PhysicalOperator("Filter", types), col_id_(col_id), filter_(std::make_unique<FilterOperator>(selectivity)) {}
+
+  struct FilterState : public OperatorState {
+    RegionProfiler profiler_;
+  };
+
+  unique_ptr<OperatorState> GetState() const override { return std::make_unique<FilterState>(); }
+
+  OperatorResultType Execute(DataChunk &input, DataChunk &output, OperatorState &state) const override {
+    filter_->Execute(input, col_id_, output, static_cast<FilterState &>(state).profiler_);
+    return OperatorResultType::NEED_MORE_INPUT;
+  }
+
+ private:
+  size_t col_id_;
+  unique_ptr<FilterOperator> filter_;
+};
+
+// Probes [ht] with the column [col_id]. An input chunk gives one output chunk per call to ScanStructure::Next, and
+// kLogical decides whether Next compacts its results.
+template<bool kLogical>
+class PhysicalHashJoin : public PhysicalOperator {
+ public:
+  PhysicalHashJoin(HashTable &ht, size_t col_id, const vector<AttributeType> &types)
+      : PhysicalOperator("Join", types), ht_(ht), col_id_(col_id) {}
+
+  struct JoinState : public OperatorState {
+    // the probe of the current input chunk, and the results it buffers. Each pipeline has its own buffer, so that
+    // pipelines on several threads can probe the same hash table.
+    unique_ptr<ScanStructure> ss_;
+    DataChunk buffer_;
+
+    explicit JoinState(const vector<AttributeType> &types) : buffer_(types) {}
+  };
+
+  unique_ptr<OperatorState> GetState() const override { return std::make_unique<JoinState>(types_); }
+
+  OperatorResultType Execute(DataChunk &input, DataChunk &output, OperatorState &state) const override {
+    auto &join_state = static_cast<JoinState &>(state);
+    auto &ss = join_state.ss_;
+    auto &join_key = input.data_[col_id_];
+    if (ss == nullptr) ss = std::make_unique<ScanStructure>(ht_.Probe(join_key, join_state.buffer_));
+
+    if (ss->HasNext()) {
+      ss->Next(join_key, input, output, kLogical);
+    } else {
+      output.Reset();
+    }
+    if (ss->HasNext()) return OperatorResultType::HAVE_MORE_OUTPUT;
+    ss.reset();
+    return OperatorResultType::NEED_MORE_INPUT;
+  }
+
+ private:
+  HashTable &ht_;
+  size_t col_id_;
+};
+
+// Appends the results to [result_table], or drops them if it is null. Each pipeline collects into its own
+// collection, which is merged into [result_table] when the pipeline is finalized.
+class ResultCollector : public PhysicalSink {
+ public:
+  explicit ResultCollector(DataCollection *result_table) : result_table_(result_table) {}
+
+  struct CollectorState : public OperatorState {
+    unique_ptr<DataCollection> local_table_;
+  };
+
+  unique_ptr<OperatorState> GetState() const override {
+    auto state = std::make_unique<CollectorState>();
+    if (result_table_ != nullptr) state->local_table_ = std::make_unique<DataCollection>(result_table_->Types());
+    return state;
+  }
+
+  void Sink(DataChunk &input, OperatorState &state) override {
+    auto &local_table = static_cast<CollectorState &>(state).local_table_;
+    if (local_table != nullptr) local_table->AppendChunk(input);
+  }
+
+  void Finalize(OperatorState &state) override {
+    auto &local_table = static_cast<CollectorState &>(state).local_table_;
+    if (local_table == nullptr) return;
+    lock_guard<mutex> lock(mutex_);
+    result_table_->Merge(*local_table);
+  }
+
+ private:
+  DataCollection *result_table_;
+  mutex mutex_;
+};
+}
@@ -0,0 +1,364 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// pipeline.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <thread>
+#include <type_traits>
+
+#include "base.h"
+#include "profiler.h"
+#include "compactor.h"
+#include "data_collection.h"
+#include "physical_operator.h"
+#include "strategy.h"
+#include "tracer.h"
+
+namespace compaction {
+
+// The compactors between two operators of a pipeline, one class per CompactType, called by Pipeline<kCompact>
+// without a virtual call. Each has
+//
+// Compact(chunk)                 compacts the output of the operator before it; [chunk] may be swapped with a cache
+// Flush(chunk)                   hands out the cached tuples after the last input
+// ObserveDownstream()            whether the pipeline times the rest of the pipeline for the chunk compacted last
+// Threshold()                    the chunks below it are compacted
+//
+// and DynamicCompaction is also told when the operator before it starts and is done with an input chunk, so that it
+// can tune itself on the time of the rest of the pipeline.
+
+// Compacts every chunk to the full block size.
+class FullCompaction {
+ public:
+  explicit FullCompaction(vector<AttributeType> types) : compactor_(types) {}
+
+  inline void Compact(unique_ptr<DataChunk> &chunk) { compactor_.Compact(chunk); }
+
+  inline void Flush(unique_ptr<DataChunk> &chunk) { compactor_.Flush(chunk); }
+
+  inline bool ObserveDownstream() const { return false; }
+
+  inline size_t Threshold() const { return kBlockSize; }
+
+ private:
+  NaiveCompactor compactor_;
+};
+
+// Compacts the chunks smaller than a threshold, which the CompactTuner package [id] selects for each input chunk of
+// the operator before it, the operator at [level]. Some policies learn the compaction cost and the downstream cost as
+// well.
+class DynamicCompaction {
+ public:
+  DynamicCompaction(idx_t id, size_t level, const vector<AttributeType> &types)
+      : id_(id), level_(level), compactor_(types) {}
+
+  // The operator before it starts an input chunk of [n_tuples]: selects the threshold for its output.
+  inline void BeginInput(size_t n_tuples) {
+    Profiler profiler;
+    profiler.Start();
+    size_t threshold = CompactTuner::Get().SelectArm(id_);
+    CompactTuner::Get().ObserveInput(id_, n_tuples);
+    compactor_.SetThreshold(threshold);
+    Tracer::Get().Instant("Tuner - Select", level_, threshold);
+
+    static const idx_t select_id = BeeProfiler::Get().Register("[UCB Get Thresholds]");
+    BeeProfiler::Get().InsertStatRecord(select_id, profiler.Elapsed());
+  }
+
+  inline void Compact(unique_ptr<DataChunk> &chunk) {
+    auto &tuner = CompactTuner::Get();
+    size_t n_tuples = chunk->count_;
+    tuner.ObserveOutput(id_, n_tuples);
+    observe_costs_ = tuner.ObserveCosts(id_);
+
+    Profiler profiler;
+    profiler.Start();
+    bool absorbed = compactor_.Compact(chunk);
+    if (observe_costs_ && absorbed && n_tuples != 0) tuner.ObserveCompact(id_, n_tuples, profiler.Elapsed());
+  }
+
+  inline void Flush(unique_ptr<DataChunk> &chunk) { compactor_.Flush(chunk); }
+
+  // The operator before it is done with its input chunk, after [time] seconds with the rest of the pipeline.
+  inline void EndInput(double time) {
+    Profiler profiler;
+    profiler.Start();
+    CompactTuner::Get().UpdateArm(id_, compactor_.GetThreshold(), 2 / time / 1e3);
+    static const idx_t update_id = BeeProfiler::Get().Register("[UCB Update]");
+    BeeProfiler::Get().InsertStatRecord(update_id, profiler.Elapsed());
+  }
+
+  inline bool ObserveDownstream() const { return observe_costs_; }
+
+  inline void Downstream(size_t n_tuples, double time) { CompactTuner::Get().ObserveDownstream(id_, n_tuples, time); }
+
+  inline size_t Threshold() const { return compactor_.GetThreshold(); }
+
+ private:
+  const idx_t id_;
+  // the level of the operator before it, the row of its events in the trace
+  const size_t level_;
+  DynamicCompactor compactor_;
+  bool observe_costs_ = false;
+};
+
+// The compactor of the pipelines of a strategy. The pipelines of CompactType::NONE have no compactor.
+template<CompactType kCompact>
+using CompactionOf = std::conditional_t<kCompact == CompactType::DYNAMIC, DynamicCompaction, FullCompaction>;
+
+// A push-based pipeline: operators, optional compactors after them, and a sink. The pipeline owns the local state
+// and the output chunk of each operator, and pushes each chunk down with an explicit stack of frames, one per
+// operator that still processes an input chunk. The operators are referenced by their index, the level.
+//
+// The pipeline is compiled for the compactor of [kCompact]: its compactors are called directly, and the pipelines of
+// CompactType::NONE have no compactor code at all.
+template<CompactType kCompact = CompactType::NONE>
+class Pipeline {
+ public:
+  using Compactor = CompactionOf<kCompact>;
+
+  explicit Pipeline(PhysicalSink &sink) : sink_(sink), sink_state_(sink.GetState()) {}
+
+  // Appends [op] before the sink.
+  void AddOperator(unique_ptr<PhysicalOperator> op) {
+    states_.push_back(op->GetState());
+    outputs_.push_back(std::make_unique<DataChunk>(op->Types()));
+    compactors_.emplace_back();
+    operators_.push_back(std::move(op));
+    stack_.reserve(operators_.size() + 1);
+  }
+
+  // Places [compactor] between the operator at [level] and the next operator (or the sink).
+  void InsertCompactor(size_t level, unique_ptr<Compactor> compactor) {
+    static_assert(kCompact != CompactType::NONE, "The pipelines without compaction have no compactor");
+    assert(level < operators_.size());
+    compactors_[level] = std::move(compactor);
+  }
+
+  size_t NumOperators() const { return operators_.size(); }
+
+  const PhysicalOperator &GetOperator(size_t level) const { return *operators_[level]; }
+
+  // Pushes a source chunk through the pipeline.
+  void Execute(DataChunk &input) {
+    if (input.count_ == 0) return;
+    PushFrame(0, input, false);
+    Run();
+  }
+
+  // Flushes the operators and the compactors level by level, after the last source chunk, and finalizes the states.
+  void Finish() {
+    for (size_t level = 0; level < operators_.size(); ++level) {
+      auto &op = *operators_[level];
+      auto &output = outputs_[level];
+      bool more;
+      do {
+        ZebraProfiler::SetLevel(level);
+        more = op.Flush(*output, *states_[level]) == OperatorResultType::HAVE_MORE_OUTPUT;
+        if (output->count_ != 0) Forward(level);
+        Run();
+      } while (more);
+
+      if constexpr (kCompact == CompactType::NONE) continue;
+      auto &compactor = compactors_[level];
+      if (compactor == nullptr) continue;
+      Tracer::Get().Begin("Compact - Flush", level, 0);
+      compactor->Flush(output);
+      Tracer::Get().End("Compact - Flush", level, output->count_);
+      if (output->count_ == 0) continue;
+      PushFrame(level + 1, *output, false);
+      Run();
+    }
+
+    for (size_t level = 0; level < operators_.size(); ++level) operators_[level]->Finalize(*states_[level]);
+    sink_.Finalize(*sink_state_);
+  }
+
+ private:
+  // An operator at [level_] (the sink if it is past the operators) with its input chunk.
+  struct Frame {
+    size_t level_;
+    DataChunk *input_;
+    size_t n_input_;
+    // the operator is done with the input
+    bool exhausted_;
+    // the compactor before the operator asked for the time of this frame
+    bool observe_downstream_;
+    Profiler timer_;
+  };
+
+  PhysicalSink &sink_;
+  unique_ptr<OperatorState> sink_state_;
+  vector<unique_ptr<PhysicalOperator>> operators_;
+  vector<unique_ptr<OperatorState>> states_;
+  vector<unique_ptr<DataChunk>> outputs_;
+  // the compactor after each operator, or null
+  vector<unique_ptr<Compactor>> compactors_;
+  vector<Frame> stack_;
+
+  // Runs the frames on the stack until it is empty. The input of a frame is the output of the frame below it, which
+  // does not run again before the frame is popped.
+  inline void Run() {
+    while (!stack_.empty()) {
+      Frame &frame = stack_.back();
+      size_t level = frame.level_;
+      ZebraProfiler::SetLevel(level);
+      if (level == operators_.size()) {
+        sink_.Sink(*frame.input_, *sink_state_);
+        PopFrame();
+        continue;
+      }
+      if (frame.exhausted_) {
+        PopFrame();
+        continue;
+      }
+
+      auto &output = *outputs_[level];
+      Tracer::Get().Begin(operators_[level]->name_, level, frame.input_->count_);
+      auto result = operators_[level]->Execute(*frame.input_, output, *states_[level]);
+      Tracer::Get().End(operators_[level]->name_, level, output.count_);
+      frame.exhausted_ = result == OperatorResultType::NEED_MORE_INPUT;
+      Forward(level);
+    }
+  }
+
+  // Passes the output of the operator at [level] through its compactor, and pushes it to the next operator.
+  inline void Forward(size_t level) {
+    auto &output = outputs_[level];
+    bool observe_downstream = false;
+    if constexpr (kCompact != CompactType::NONE) {
+      auto &compactor = compactors_[level];
+      if (compactor != nullptr) {
+        ZebraProfiler::SetLevel(level);
+        Tracer::Get().Begin("Compact", level, output->count_, compactor->Threshold());
+        compactor->Compact(output);
+        Tracer::Get().End("Compact", level, output->count_);
+        observe_downstream = compactor->ObserveDownstream();
+      }
+    }
+    if (output->count_ != 0) PushFrame(level + 1, *output, observe_downstream);
+  }
+
+  inline void PushFrame(size_t level, DataChunk &input, bool observe_downstream) {
+    if constexpr (kCompact == CompactType::DYNAMIC) {
+      if (level < compactors_.size() && compactors_[level] != nullptr) compactors_[level]->BeginInput(input.count_);
+    }
+    stack_.push_back({level, &input, input.count_, false, observe_downstream, Profiler()});
+    // only the dynamic compactors learn from the time of the frames
+    if constexpr (kCompact == CompactType::DYNAMIC) stack_.back().timer_.Start();
+  }
+
+  inline void PopFrame() {
+    if constexpr (kCompact == CompactType::DYNAMIC) {
+      Frame &frame = stack_.back();
+      double time = frame.timer_.Elapsed();
+      size_t level = frame.level_;
+      if (level < compactors_.size() && compactors_[level] != nullptr) compactors_[level]->EndInput(time);
+      if (frame.observe_downstream_) compactors_[level - 1]->Downstream(frame.n_input_, time);
+    }
+    stack_.pop_back();
+  }
+};
+
+// Hands out the tuples [0, n_tuples) in morsels of [morsel_size] tuples through an atomic cursor.
+class MorselSource {
+ public:
+  MorselSource(size_t n_tuples, size_t morsel_size) : n_tuples_(n_tuples), morsel_size_(morsel_size), cursor_(0) {}
+
+  // Claims the next morsel [start, end). Returns false if no tuple is left.
+  inline bool Next(size_t &start, size_t &end) {
+    start = cursor_.fetch_add(morsel_size_, std::memory_order_relaxed);
+    if (start >= n_tuples_) return false;
+    end = std::min(start + morsel_size_, n_tuples_);
+    return true;
+  }
+
+ private:
+  const size_t n_tuples_;
+  const size_t morsel_size_;
+  atomic<size_t> cursor_;
+};
+
+// What a worker of ExecuteMorsels did.
+struct WorkerStatistic {
+  // the time spent in the pipeline, without fetching the chunks from the table
+  double time_ = 0;
+  // the time spent fetching the chunks from the table
+  double scan_time_ = 0;
+  size_t n_morsel_ = 0;
+  size_t n_tuples_ = 0;
+};
+
+// Runs each pipeline on its own thread (the calling thread, if there is one pipeline). The workers claim morsels of
+// [morsel_size] tuples of [table], push them through their pipeline chunk by chunk, and finish the pipeline once the
+// table is exhausted. The pipelines share nothing but what their operators share, e.g., the hash tables.
+template<CompactType kCompact>
+inline vector<WorkerStatistic> ExecuteMorsels(Table &table, vector<unique_ptr<Pipeline<kCompact>>> &pipelines,
+                                             size_t morsel_size) {
+  MorselSource source(table.NumTuples(), std::max(morsel_size, size_t(1)));
+  vector<WorkerStatistic> statistics(pipelines.size());
+
+  auto work = [&](size_t worker) {
+    auto &pipeline = *pipelines[worker];
+    auto &statistic = statistics[worker];
+    Profiler timer;
+    // the chunks of the morsels reference the segments of a DataCollection, or are decoded from a table file
+    DataChunk chunk(table.Types());
+    size_t morsel_start, morsel_end;
+    while (source.Next(morsel_start, morsel_end)) {
+      statistic.n_morsel_++;
+      statistic.n_tuples_ += morsel_end - morsel_start;
+      for (size_t start = morsel_start; start < morsel_end; start += kBlockSize) {
+        timer.Start();
+        table.ScanChunk(start, std::min(start + kBlockSize, morsel_end), chunk);
+        statistic.scan_time_ += timer.Elapsed();
+        timer.Start();
+        pipeline.Execute(chunk);
+        statistic.time_ += timer.Elapsed();
+      }
+    }
+
+    // Flush the tuples in the compactors.
+    timer.Start();
+    pipeline.Finish();
+    statistic.time_ += timer.Elapsed();
+  };
+
+  if (pipelines.size() == 1) {
+    work(0);
+    return statistics;
+  }
+  vector<std::thread> threads;
+  for (size_t i = 0; i < pipelines.size(); ++i) threads.emplace_back(work, i);
+  for (auto &thread : threads) thread.join();
+  return statistics;
+}
+
+// Prints the time of the slowest worker as the total time, and the share of each worker if there are several.
+inline void PrintWorkerStatistics(const vector<WorkerStatistic> &statistics, double wall_time) {
+  double latency = 0, scan_time = 0;
+  for (auto &statistic : statistics) {
+    latency = std::max(latency, statistic.time_);
+    scan_time = std::max(scan_time, statistic.scan_time_);
+  }
+  std::cerr << "[Total Time]: " << latency << "s\n";
+  std::cerr << "[Scan Time]: " << scan_time << "s\n";
+  if (statistics.size() == 1) return;
+
+  size_t n_tuples = 0;
+  for (auto &statistic : statistics) n_tuples += statistic.n_tuples_;
+  std::cerr << "[Wall Time]: " << wall_time << "s\tThreads: " << statistics.size()
+            << "\tThroughput: " << double(n_tuples) / wall_time / 1e6 << " M tuples/s\n";
+  for (size_t i = 0; i < statistics.size(); ++i) {
+    auto &statistic = statistics[i];
+    std::cerr << "[Worker " << i << "] Time: " << statistic.time_ << " s\tScan: " << statistic.scan_time_
+              << " s\tMorsels: " << statistic.n_morsel_
+              << "\tTuples: " << statistic.n_tuples_ << "\n";
+  }
+}
+}
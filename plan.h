@@ -0,0 +1,317 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// plan.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "base.h"
+#include "hash_aggregate.h"
+#include "sort.h"
+#include "generator.h"
+#include "strategy.h"
+
+namespace compaction {
+
+// A plan file describes a benchmark query: the probe table and how its columns are generated, the hash tables, the
+// operators of the probe pipeline in order with the compactors between them, and the sink. One statement per line;
+// a line that starts with '#' is a comment. For example:
+//
+//   table rows=2000000 seed=2
+//   column uniform min=0 max=100
+//   column uniform min=0 max=200000
+//   column string value=|
+//   hashtable rhs1 rows=200000 chunk-factor=8 payload=1000 load-factor=0.5
+//   filter column=0 selectivity=0.2
+//   compact
+//   join rhs1 column=1
+//   compact
+//   project #1 * 2; CASE WHEN #0 < 10 THEN 1 ELSE 0 END
+//   aggregate count,sum(5) group-by=0
+//
+// A join appends the key and the payload (INTEGER, STRING) of the hash table, and a projection its expressions, to
+// the columns of their input. "compact" places a compactor after the operator before it; the strategy decides which
+// one. The sink is "aggregate <list> [group-by=<list>]", "order-by <list> [limit=<n>]", or none (collect the results).
+
+// "table rows=<n> [seed=<n>]", and a column statement per column, see ColumnSpec:
+// "column uniform min=<n> max=<n>": integers drawn uniformly from [min, max]
+// "column sequence": 0, 1, 2, ...
+// "column constant value=<n>": the integer n
+// "column string value=<text>": the text
+// "column key min=<n> max=<n> [step=<n>] [dist=<distribution>] [correlate=<column> correlation=<x>]": the integers
+//   min, min + step, ... up to max, drawn from the distribution (uniform, zipf[:s], hotset[:keys[:share]]), that
+//   repeat the key of an earlier column with the probability x. That column is an uncorrelated key column with the
+//   same min, max, step and distribution.
+struct TableSpec {
+  size_t rows_ = 0;
+  size_t seed_ = 2;
+  vector<ColumnSpec> columns_;
+};
+
+// "hashtable <name> rows=<n> [chunk-factor=<n>] [payload=<n>] [load-factor=<x>] [fan-out=<distribution>]
+// [seed=<n>]", see HashTable. The fan-out is constant (chunk-factor tuples per key) by default.
+struct HashTableSpec {
+  string name_;
+  size_t rows_ = 0;
+  size_t chunk_factor_ = 1;
+  size_t payload_ = 0;
+  double load_factor_ = 0.5;
+  KeyDistribution fan_out_{DistributionType::CONSTANT};
+  size_t seed_ = 0;
+};
+
+enum class PlanOperatorType : uint8_t {
+  FILTER = 0,
+  JOIN = 1,
+  PROJECT = 2
+};
+
+// "filter column=<n> selectivity=<x>": keeps the values v of the column with v / 100 < x, see FilterOperator
+// "filter column=<n> less-than=<n>": keeps the values below n, i.e., the selectivity n / 100
+// "join <hashtable> column=<n>": probes the hash table with the column
+// "project <expressions>": the rest of the line, see Expression
+struct PlanOperatorSpec {
+  PlanOperatorType type_;
+  size_t col_id_ = 0;
+  double selectivity_ = 0;
+  // JOIN: the index of the hash table
+  size_t ht_id_ = 0;
+  string expressions_{};
+  // a compactor follows the operator
+  bool compact_ = false;
+};
+
+struct PlanSpec {
+  TableSpec table_;
+  vector<HashTableSpec> hash_tables_;
+  vector<PlanOperatorSpec> operators_;
+  vector<size_t> group_by_;
+  vector<AggregateSpec> aggregates_;
+  vector<SortSpec> order_by_;
+  size_t limit_ = 0;
+
+  // The signature of the compactor after the operator at [level] (CompactTuner): the strategy, and the operators from
+  // the start of the pipeline up to the compactor, with the selectivity of the filters, the distribution of the probe
+  // keys and the shape of the hash tables (rows, chunk factor, fan-out, payload). Runs with the same signature can
+  // share what the tuner has learned.
+  inline string Signature(size_t level, bool logical) const {
+    std::ostringstream signature;
+    signature << StrategySignature(logical);
+    for (size_t i = 0; i <= level; ++i) {
+      auto &op = operators_[i];
+      switch (op.type_) {
+        case PlanOperatorType::FILTER: signature << "|filter-" << op.col_id_ << "-" << op.selectivity_; break;
+        case PlanOperatorType::JOIN: {
+          auto &ht = hash_tables_[op.ht_id_];
+          signature << "|join-" << ColumnSignature(op.col_id_) << "-" << ht.rows_ << "-" << ht.chunk_factor_ << "-"
+                    << ht.fan_out_.Name() << "-" << ht.payload_;
+          break;
+        }
+        case PlanOperatorType::PROJECT: signature << "|project"; break;
+      }
+    }
+    signature << "|level-" << level;
+    return signature.str();
+  }
+
+  static inline PlanSpec Load(const string &path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Cannot open the plan: " + path);
+    std::stringstream text;
+    text << in.rdbuf();
+    return Parse(text.str());
+  }
+
+  static inline PlanSpec Parse(const string &text) {
+    PlanSpec plan;
+    std::stringstream lines(text);
+    string line;
+    size_t line_no = 0;
+    while (std::getline(lines, line)) {
+      line_no++;
+      auto start = line.find_first_not_of(" \t\r");
+      if (start == string::npos || line[start] == '#') continue;
+      try {
+        plan.ParseStatement(line.substr(start));
+      } catch (std::exception &e) {
+        throw std::runtime_error("Plan line " + std::to_string(line_no) + ": " + e.what());
+      }
+    }
+    if (plan.table_.rows_ == 0 || plan.table_.columns_.empty()) throw std::runtime_error("The plan has no table");
+    if (plan.operators_.empty()) throw std::runtime_error("The plan has no operator");
+    return plan;
+  }
+
+ private:
+  // the words of a statement after its keyword: positional arguments, and key=value options
+  struct Arguments {
+    vector<string> positional_;
+    std::map<string, string> options_;
+
+    explicit Arguments(std::stringstream &words) {
+      string word;
+      while (words >> word) {
+        auto eq = word.find('=');
+        if (eq == string::npos) positional_.push_back(word);
+        else options_[word.substr(0, eq)] = word.substr(eq + 1);
+      }
+    }
+
+    inline string Get(const string &key, const string &default_value = "") {
+      auto it = options_.find(key);
+      if (it == options_.end()) {
+        if (default_value.empty()) throw std::runtime_error("Missing option: " + key);
+        return default_value;
+      }
+      string value = it->second;
+      options_.erase(it);
+      return value;
+    }
+
+    inline size_t GetSize(const string &key, const string &default_value = "") {
+      return std::stoul(Get(key, default_value));
+    }
+
+    inline double GetDouble(const string &key, const string &default_value = "") {
+      return std::stod(Get(key, default_value));
+    }
+
+    // All options must have been read.
+    inline void Done() const {
+      if (!options_.empty()) throw std::runtime_error("Unknown option: " + options_.begin()->first);
+    }
+  };
+
+  inline void ParseStatement(const string &line) {
+    std::stringstream words(line);
+    string keyword;
+    words >> keyword;
+
+    // the expressions of a projection are the rest of the line
+    if (keyword == "project") {
+      PlanOperatorSpec op{PlanOperatorType::PROJECT};
+      std::getline(words, op.expressions_);
+      operators_.push_back(op);
+      return;
+    }
+
+    Arguments args(words);
+    if (keyword == "table") {
+      table_.rows_ = args.GetSize("rows");
+      table_.seed_ = args.GetSize("seed", "2");
+    } else if (keyword == "column") {
+      if (args.positional_.size() != 1) throw std::runtime_error("Expected a generator");
+      ColumnSpec column;
+      auto &generator = args.positional_[0];
+      if (generator == "uniform") {
+        column.generator_ = GeneratorType::UNIFORM;
+        column.min_ = args.GetSize("min", "0");
+        column.max_ = args.GetSize("max");
+      } else if (generator == "sequence") {
+        column.generator_ = GeneratorType::SEQUENCE;
+      } else if (generator == "constant") {
+        column.generator_ = GeneratorType::CONSTANT;
+        column.value_ = args.GetSize("value");
+      } else if (generator == "string") {
+        column.generator_ = GeneratorType::STRING;
+        column.text_ = args.Get("value");
+      } else if (generator == "key") {
+        column.generator_ = GeneratorType::KEY;
+        column.min_ = args.GetSize("min", "0");
+        column.max_ = args.GetSize("max");
+        column.step_ = args.GetSize("step", "1");
+        column.distribution_ = KeyDistribution::Parse(args.Get("dist", "uniform"));
+        if (column.step_ == 0 || column.max_ < column.min_) throw std::runtime_error("Expected step > 0 and max >= min");
+        if (args.options_.count("correlate")) {
+          column.correlated_col_ = args.GetSize("correlate");
+          column.correlation_ = args.GetDouble("correlation");
+          if (column.correlated_col_ >= table_.columns_.size()) {
+            throw std::runtime_error("A column can only be correlated with an earlier column");
+          }
+          // a row repeats the draw of the other column, which is its key only if the keys are drawn the same way
+          auto &other = table_.columns_[column.correlated_col_];
+          if (other.generator_ != GeneratorType::KEY || other.correlation_ > 0 || other.min_ != column.min_ ||
+              other.max_ != column.max_ || other.step_ != column.step_ ||
+              other.distribution_.Name() != column.distribution_.Name()) {
+            throw std::runtime_error("A key column can only be correlated with an uncorrelated key column with the "
+                                     "same min, max, step and dist");
+          }
+        }
+      } else {
+        throw std::runtime_error("Unknown generator: " + generator);
+      }
+      table_.columns_.push_back(column);
+    } else if (keyword == "hashtable") {
+      if (args.positional_.size() != 1) throw std::runtime_error("Expected the name of the hash table");
+      HashTableSpec ht;
+      ht.name_ = args.positional_[0];
+      ht.rows_ = args.GetSize("rows");
+      ht.chunk_factor_ = args.GetSize("chunk-factor", "1");
+      ht.payload_ = args.GetSize("payload", "0");
+      ht.load_factor_ = args.GetDouble("load-factor", "0.5");
+      ht.fan_out_ = KeyDistribution::Parse(args.Get("fan-out", "constant"));
+      ht.seed_ = args.GetSize("seed", std::to_string(hash_tables_.size() + 1));
+      hash_tables_.push_back(ht);
+    } else if (keyword == "filter") {
+      PlanOperatorSpec op{PlanOperatorType::FILTER};
+      op.col_id_ = args.GetSize("column");
+      if (args.options_.count("less-than")) op.selectivity_ = args.GetDouble("less-than") / 100;
+      else op.selectivity_ = args.GetDouble("selectivity");
+      operators_.push_back(op);
+    } else if (keyword == "join") {
+      if (args.positional_.size() != 1) throw std::runtime_error("Expected the name of the hash table");
+      PlanOperatorSpec op{PlanOperatorType::JOIN};
+      op.ht_id_ = FindHashTable(args.positional_[0]);
+      op.col_id_ = args.GetSize("column");
+      operators_.push_back(op);
+    } else if (keyword == "compact") {
+      if (operators_.empty()) throw std::runtime_error("A compactor must follow an operator");
+      operators_.back().compact_ = true;
+    } else if (keyword == "aggregate") {
+      if (args.positional_.size() != 1) throw std::runtime_error("Expected the aggregates");
+      aggregates_ = AggregateSpec::ParseList(args.positional_[0]);
+      if (args.options_.count("group-by")) group_by_ = ParseColumns(args.Get("group-by"));
+    } else if (keyword == "order-by") {
+      if (args.positional_.size() != 1) throw std::runtime_error("Expected the sort columns");
+      order_by_ = SortSpec::ParseList(args.positional_[0]);
+      limit_ = args.GetSize("limit", "0");
+    } else {
+      throw std::runtime_error("Unknown statement: " + keyword);
+    }
+    args.Done();
+    if (!aggregates_.empty() && !order_by_.empty()) throw std::runtime_error("order-by cannot be combined with aggregate");
+  }
+
+  // How the column [col_id] is generated, or "derived" if an operator computes it.
+  inline string ColumnSignature(size_t col_id) const {
+    if (col_id >= table_.columns_.size()) return "derived";
+    auto &column = table_.columns_[col_id];
+    std::ostringstream signature;
+    switch (column.generator_) {
+      case GeneratorType::UNIFORM: signature << "uniform:" << column.min_ << ":" << column.max_; break;
+      case GeneratorType::SEQUENCE: signature << "sequence"; break;
+      case GeneratorType::CONSTANT: signature << "constant:" << column.value_; break;
+      case GeneratorType::STRING: signature << "string"; break;
+      case GeneratorType::KEY:
+        signature << "key:" << column.min_ << ":" << column.max_ << ":" << column.step_ << ":"
+                  << column.distribution_.Name() << ":" << column.correlation_;
+        break;
+    }
+    return signature.str();
+  }
+
+  inline size_t FindHashTable(const string &name) const {
+    for (size_t i = 0; i < hash_tables_.size(); ++i) {
+      if (hash_tables_[i].name_ == name) return i;
+    }
+    throw std::runtime_error("Unknown hash table: " + name);
+  }
+};
+}
@@ -0,0 +1,230 @@
+#include <iostream>
+
+#include "base.h"
+#include "hash_table.h"
+#include "data_collection.h"
+#include "profiler.h"
+#include "setting.h"
+#include "driver.h"
+#include "pipeline.h"
+#include "expression.h"
+#include "plan.h"
+#include "table_file.h"
+#include "tpch.h"
+#include "tracer.h"
+
+using namespace compaction;
+
+// The plan, built: the probe table, the hash tables, and the schema of the result of each operator. They are built
+// once, and shared by the pipelines of all strategies.
+struct PlanState {
+  PlanSpec spec;
+  unique_ptr<Table> table;
+  vector<unique_ptr<HashTable>> hts;
+  vector<vector<AttributeType>> types;
+
+  // the schema of the input of the operator at [level]
+  const vector<AttributeType> &InputTypes(size_t level) const { return level == 0 ? table->Types() : types[level - 1]; }
+};
+
+void BuildPlan(PlanState &plan);
+
+template<bool kLogical, CompactType kCompact>
+void RunPipeline(PlanState &plan);
+
+int ParseParameters(int argc, char *argv[]);
+
+// example: plan --plan plans/filter_and_join.plan --strategy logical,logical+dynamic --threads 4
+//          plan --tpch q3 --scale-factor 0.5 --strategy none,logical+dynamic
+int main(int argc, char *argv[]) {
+  if (ParseParameters(argc, argv)) return 0;
+  EnableProfilers();
+
+  PlanState plan;
+  plan.spec = kTPCHQuery.empty() ? PlanSpec::Load(kPlanPath) : PlanSpec::Parse(TPCHPlan(kTPCHQuery, kScaleFactor));
+  if (!kResultPath.empty() && (!plan.spec.aggregates_.empty() || !plan.spec.order_by_.empty())) {
+    throw std::runtime_error("--result-file cannot be combined with a plan that aggregates or orders its results");
+  }
+  BuildPlan(plan);
+
+  // Run the strategies one after another on the same data.
+  for (auto &strategy : kStrategies) {
+    std::cerr << "------------------ Strategy: " << strategy.Name() << " ------------------\n";
+    DispatchStrategy(strategy, [&](auto logical, auto compact) {
+      RunPipeline<decltype(logical)::value, decltype(compact)::value>(plan);
+    });
+    ZebraProfiler::Get().EndSection(strategy.Name());
+  }
+
+  WriteProfiles();
+  return 0;
+}
+
+// Generates (or maps) the probe table, builds the hash tables, and resolves the schema of each operator.
+void BuildPlan(PlanState &plan) {
+  auto &spec = plan.spec;
+
+  // ---------------------------------------------- Probe Table ----------------------------------------------
+  auto &columns = spec.table_.columns_;
+  vector<AttributeType> types = ColumnTypes(columns);
+  plan.table = CreateTable(columns, spec.table_.rows_, spec.table_.seed_, kLoadTablePath, kSaveTablePath, kCSVDelimiter);
+
+  // ------------------------------------------ Operators and Hash Tables ------------------------------------------
+  plan.hts.resize(spec.hash_tables_.size());
+  for (size_t level = 0; level < spec.operators_.size(); ++level) {
+    auto &op = spec.operators_[level];
+    switch (op.type_) {
+      case PlanOperatorType::FILTER:
+      case PlanOperatorType::JOIN: {
+        if (op.col_id_ >= types.size() || types[op.col_id_] != AttributeType::INTEGER) {
+          throw std::runtime_error("Operator " + std::to_string(level) + " needs an integer column: "
+                                       + std::to_string(op.col_id_));
+        }
+        if (op.type_ == PlanOperatorType::FILTER) break;
+
+        types.push_back(AttributeType::INTEGER);
+        types.push_back(AttributeType::STRING);
+        // a hash table is built once, even if several joins probe it
+        auto &ht = plan.hts[op.ht_id_];
+        if (ht == nullptr) {
+          auto &ht_spec = spec.hash_tables_[op.ht_id_];
+          ht = std::make_unique<HashTable>(ht_spec.rows_, ht_spec.chunk_factor_, ht_spec.payload_, types,
+                                           ht_spec.load_factor_, ht_spec.fan_out_, ht_spec.seed_);
+        }
+        break;
+      }
+      case PlanOperatorType::PROJECT: {
+        auto input_types = types;
+        for (auto &expression : Expression::ParseList(op.expressions_)) {
+          expression->Bind(input_types);
+          types.push_back(expression->result_type_);
+        }
+        break;
+      }
+    }
+    plan.types.push_back(types);
+  }
+}
+
+template<bool kLogical, CompactType kCompact>
+void RunPipeline(PlanState &plan) {
+  auto &spec = plan.spec;
+
+  // collect, aggregate, order, or write the results
+  ResultSinks sinks(plan.types.back(), spec.group_by_, spec.aggregates_, spec.order_by_, spec.limit_);
+  auto &sink = sinks.Sink();
+
+  // the operators of the plan in order, with a compactor where the plan places one. Each thread runs its own
+  // pipeline, and the pipelines share the hash tables.
+  if constexpr (kCompact == CompactType::DYNAMIC) CompactTuner::Get().SetEpoch(kTunerEpoch);
+  vector<unique_ptr<Pipeline<kCompact>>> pipelines(kThreads);
+  // the tuner ids of the compactors, assigned by the first pipeline
+  vector<idx_t> tuner_ids;
+  for (size_t t = 0; t < kThreads; ++t) {
+    auto &pipeline = pipelines[t] = std::make_unique<Pipeline<kCompact>>(sink);
+    size_t n_compactor = 0;
+    for (size_t level = 0; level < spec.operators_.size(); ++level) {
+      auto &op = spec.operators_[level];
+      auto &types = plan.types[level];
+      switch (op.type_) {
+        case PlanOperatorType::FILTER:
+          pipeline->AddOperator(std::make_unique<PhysicalFilter>(op.selectivity_, op.col_id_, types));
+          break;
+        case PlanOperatorType::JOIN:
+          pipeline->AddOperator(std::make_unique<PhysicalHashJoin<kLogical>>(*plan.hts[op.ht_id_], op.col_id_, types));
+          break;
+        case PlanOperatorType::PROJECT:
+          pipeline->AddOperator(std::make_unique<PhysicalProjection>(plan.InputTypes(level),
+                                                                     Expression::ParseList(op.expressions_)));
+          break;
+      }
+      if (!op.compact_) continue;
+
+      if constexpr (kCompact == CompactType::FULL) {
+        pipeline->InsertCompactor(level, std::make_unique<FullCompaction>(types));
+      } else if constexpr (kCompact == CompactType::DYNAMIC) {
+        // a tuning policy for each compactor, shared by the compactors of all threads
+        if (t == 0) tuner_ids.push_back(CompactTuner::Get().Initialize(kTuner, spec.Signature(level, kLogical)));
+        pipeline->InsertCompactor(level, std::make_unique<DynamicCompaction>(tuner_ids[n_compactor], level, types));
+      }
+      n_compactor++;
+    }
+  }
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    if (!kTunerState.empty()) CompactTuner::Get().Load(kTunerState);
+  }
+
+  Profiler timer;
+  timer.Start();
+  auto statistics = ExecuteMorsels(*plan.table, pipelines, kMorselSize * kBlockSize);
+  sinks.Close();
+  double wall_time = timer.Elapsed();
+
+  std::cerr << "------------------ Statistic ------------------\n";
+  PrintWorkerStatistics(statistics, wall_time);
+  sinks.PrintStatistics();
+  BeeProfiler::Get().EndProfiling();
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    if (!kTunerState.empty()) CompactTuner::Get().Save(kTunerState);
+    CompactTuner::Get().Reset(kTunerLog);
+  }
+
+  sinks.Print();
+}
+
+void PrintHelp() {
+  std::cerr << "Usage: [program_name] --plan [path] [options]\n";
+  std::cerr << "       [program_name] --tpch [query] [--scale-factor [sf]] [options]\n";
+  std::cerr << "Options:\n";
+  std::cerr << "  --plan [path]             The plan file: the table, the hash tables, the operators, and the sink\n";
+  std::cerr << "  --tpch [query]            The built-in TPC-H-style plan instead of a plan file:";
+  for (auto &query : TPCHQueries()) std::cerr << " " << query;
+  std::cerr << "\n";
+  std::cerr << "  --scale-factor [sf]       Scale factor of the TPC-H-style plan (default 1: 6M lineitems)\n";
+  std::cerr << "  --print-plan              Print the plan file of the TPC-H-style plan, and exit\n";
+  PrintSharedHelp();
+}
+
+int ParseParameters(int argc, char **argv) {
+  bool print_plan = false;
+  for (int i = 1; i < argc; i++) {
+    if (ParseSharedParameter(argc, argv, i)) continue;
+    std::string arg(argv[i]);
+
+    if (arg == "--plan") {
+      if (i + 1 < argc) {
+        kPlanPath = argv[i + 1];
+        i++;
+      }
+    } else if (arg == "--tpch") {
+      if (i + 1 < argc) {
+        kTPCHQuery = argv[i + 1];
+        i++;
+      }
+    } else if (arg == "--scale-factor") {
+      if (i + 1 < argc) {
+        kScaleFactor = std::stod(argv[i + 1]);
+        i++;
+      }
+    } else if (arg == "--print-plan") {
+      print_plan = true;
+    }
+  }
+  if (kPlanPath.empty() && kTPCHQuery.empty()) {
+    PrintHelp();
+    return 1;
+  }
+  if (print_plan) {
+    if (kTPCHQuery.empty()) throw std::runtime_error("--print-plan needs --tpch");
+    std::cout << TPCHPlan(kTPCHQuery, kScaleFactor);
+    return 1;
+  }
+
+  // show the setting
+  std::cerr << "------------------ Setting ------------------\n";
+  if (kTPCHQuery.empty()) std::cerr << "Plan: " << kPlanPath << "\n";
+  else std::cerr << "Plan: TPC-H-style " << kTPCHQuery << ", scale factor " << kScaleFactor << "\n";
+  PrintSharedSetting();
+
+  return 0;
+}
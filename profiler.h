@@ -8,14 +8,19 @@
 
 #pragma once
 
-#include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <random>
 #include <mutex>
 #include <atomic>
 #include <chrono>
 #include <algorithm>
+#include <map>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "base.h"
+#include "perf_counters.h"
 
 namespace compaction {
 using std::mutex;
@@ -23,6 +28,7 @@ using std::lock_guard;
 using std::atomic;
 using std::chrono::time_point;
 using std::chrono::system_clock;
+using std::chrono::steady_clock;
 
 //! The profiler can be used to measure elapsed time
 template<typename T>
@@ -56,8 +62,43 @@ class BaseProfiler {
   bool finished = false;
 };
 
-using Profiler = BaseProfiler<system_clock>;
+// A clock on the time-stamp counter. Reading it is much cheaper than system_clock, which matters for regions that
+// take a few microseconds. The frequency is calibrated against steady_clock once per process.
+struct CycleClock {
+  using rep = double;
+  using period = std::nano;
+  using duration = std::chrono::duration<rep, period>;
+  using time_point = std::chrono::time_point<CycleClock>;
+  static constexpr bool is_steady = true;
+
+  static inline time_point now() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double ns_per_cycle = Calibrate();
+    return time_point(duration(double(__rdtsc()) * ns_per_cycle));
+#else
+    return time_point(std::chrono::duration_cast<duration>(steady_clock::now().time_since_epoch()));
+#endif
+  }
+
+ private:
+#if defined(__x86_64__) || defined(__i386__)
+  static double Calibrate() {
+    auto start = steady_clock::now();
+    auto start_cycle = __rdtsc();
+    while (steady_clock::now() - start < std::chrono::milliseconds(10)) {}
+    auto end_cycle = __rdtsc();
+    auto end = steady_clock::now();
+
+    double ns = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start).count();
+    return ns / double(end_cycle - start_cycle);
+  }
+#endif
+};
 
+using Profiler = BaseProfiler<CycleClock>;
+
+// The statistics profiler. A record is registered once to get an integer handle, and the hot path only adds to the
+// counters of the calling thread. The counters of all threads are merged when the results are printed.
 class BeeProfiler {
  public:
   const static bool kEnableProfiling = 1;
@@ -68,27 +109,76 @@ class BeeProfiler {
     return instance;
   }
 
-  void InsertStatRecord(string name, double value) {
-    InsertStatRecord(name, size_t(value * 1e9));
+  // Returns the handle of the record [name]. Registering a name twice returns the same handle.
+  inline idx_t Register(const string &name) {
+    lock_guard<mutex> lock(mtx);
+    auto it = handles_.find(name);
+    if (it != handles_.end()) return it->second;
+
+    names_.push_back(name);
+    return handles_[name] = names_.size() - 1;
+  }
+
+  inline void InsertStatRecord(idx_t id, double value) {
+    InsertStatRecord(id, size_t(value * 1e9));
   }
 
-  inline void InsertStatRecord(string name, size_t value) {
+  inline void InsertStatRecord(idx_t id, size_t value) {
     if (kEnableProfiling) {
-      lock_guard<mutex> lock(mtx);
-      values_[name] += value;
-      calling_times_[name] += 1;
+      auto &local = Local();
+      if (id >= local.values_.size()) {
+        local.values_.resize(id + 1, 0);
+        local.calling_times_.resize(id + 1, 0);
+      }
+      local.values_[id] += value;
+      local.calling_times_[id] += 1;
     }
   }
 
-  void InsertHTRecord(string name, size_t tuple_sz, size_t point_table_sz, size_t num_terms) {
+  // Adds the hardware events counted between [start] and [end] to the record [id].
+  inline void InsertEventRecord(idx_t id, const PerfCounters::Values &start, const PerfCounters::Values &end) {
+    if (kEnableProfiling) {
+      auto &local = Local();
+      if (id >= local.events_.size()) local.events_.resize(id + 1, PerfCounters::Values{});
+      // the scaled counts of a multiplexed group can step back a little
+      for (size_t i = 0; i < PerfCounters::kMaxEvents; ++i) {
+        local.events_[id][i] += end[i] > start[i] ? end[i] - start[i] : 0;
+      }
+    }
+  }
+
+  // Adds the bytes copied and allocated between [start] and [end] to the record [id].
+  inline void InsertCopyRecord(idx_t id, const CopyCounters &start, const CopyCounters &end) {
+    if (kEnableProfiling) {
+      auto &local = Local();
+      if (id >= local.copies_.size()) local.copies_.resize(id + 1);
+      auto &copies = local.copies_[id];
+      copies.values_ += end.values_ - start.values_;
+      copies.string_bytes_ += end.string_bytes_ - start.string_bytes_;
+      copies.sel_bytes_ += end.sel_bytes_ - start.sel_bytes_;
+      copies.alloc_bytes_ += end.alloc_bytes_ - start.alloc_bytes_;
+    }
+  }
+
+  // Slow path for records that are not on a hot path.
+  void InsertStatRecord(const string &name, double value) {
+    InsertStatRecord(Register(name), size_t(value * 1e9));
+  }
+
+  void InsertStatRecord(const string &name, size_t value) {
+    InsertStatRecord(Register(name), value);
+  }
+
+  void InsertHTRecord(string name, size_t tuple_sz, size_t point_table_sz, size_t num_terms, size_t max_chain = 0) {
     if (kEnableProfiling) {
       std::lock_guard<std::mutex> lock(mtx);
       if (ht_records_.count(name) == 0) {
-        ht_records_[name] = HTInfo(tuple_sz, point_table_sz, num_terms);
+        ht_records_[name] = HTInfo(tuple_sz, point_table_sz, num_terms, max_chain);
       }
     }
   }
 
+  // Must be called when no thread is profiling.
   void EndProfiling() {
     if (kEnableProfiling) {
       PrintResults();
@@ -99,9 +189,34 @@ class BeeProfiler {
   void PrintResults() const {
     lock_guard<mutex> lock(mtx);
 
+    // merge the counters of all threads
+    unordered_map<string, size_t> values;
+    unordered_map<string, size_t> calling_times;
+    unordered_map<string, PerfCounters::Values> events;
+    unordered_map<string, CopyCounters> copies;
+    for (auto &local : locals_) {
+      for (size_t id = 0; id < local->values_.size(); ++id) {
+        if (local->calling_times_[id] == 0) continue;
+        values[names_[id]] += local->values_[id];
+        calling_times[names_[id]] += local->calling_times_[id];
+      }
+      for (size_t id = 0; id < local->events_.size(); ++id) {
+        auto &sum = events[names_[id]];
+        for (size_t i = 0; i < PerfCounters::kMaxEvents; ++i) sum[i] += local->events_[id][i];
+      }
+      for (size_t id = 0; id < local->copies_.size(); ++id) {
+        auto &sum = copies[names_[id]];
+        auto &record = local->copies_[id];
+        sum.values_ += record.values_;
+        sum.string_bytes_ += record.string_bytes_;
+        sum.sel_bytes_ += record.sel_bytes_;
+        sum.alloc_bytes_ += record.alloc_bytes_;
+      }
+    }
+
     // -------------------------------- Print Timing Results --------------------------------
     std::vector<std::string> keys;
-    for (const auto &pair : values_) keys.push_back(pair.first);
+    for (const auto &pair : values) keys.push_back(pair.first);
 
     if (!keys.empty()) {
       std::sort(keys.begin(), keys.end());
@@ -112,26 +227,67 @@ class BeeProfiler {
 
         if (key.find("#Tuple") != std::string::npos) continue;
 
-        double time = values_.at(key) / double(1e9);
-        size_t calling_times = calling_times_.at(key);
-        double avg = time / calling_times;
+        double time = values.at(key) / double(1e9);
+        size_t n_calls = calling_times.at(key);
+        double avg = time / n_calls;
 
-        std::cerr << "Total: " << time << " s\tCalls: " << calling_times << "\tAvg: " << avg << " s\t" << key
+        std::cerr << "Total: " << time << " s\tCalls: " << n_calls << "\tAvg: " << avg << " s\t" << key
                   << '\n';
       }
 
       std::cerr << "-------\n";
       for (const auto &key : keys) {
         if (key.find("#Tuple") != std::string::npos) {
-          size_t total_tuples = values_.at(key);
-          size_t calling_times = calling_times_.at(key);
-          double avg = total_tuples / double(calling_times);
+          size_t total_tuples = values.at(key);
+          size_t n_calls = calling_times.at(key);
+          double avg = total_tuples / double(n_calls);
 
-          std::cerr << "Total: " << total_tuples << "\tCalls: " << calling_times << "\tAvg: " << avg << "\t"
+          std::cerr << "Total: " << total_tuples << "\tCalls: " << n_calls << "\tAvg: " << avg << "\t"
                     << key << '\n';
         }
       }
+
+      // -------------------------------- Print Event Results --------------------------------
+      if (PerfCounters::Enabled() && !events.empty()) {
+        std::cerr << "-------\n";
+        for (const auto &key : keys) {
+          if (events.count(key) == 0) continue;
+          auto &sum = events.at(key);
+          size_t n_calls = calling_times.at(key);
+
+          for (size_t i = 0; i < PerfCounters::NumEvents(); ++i) {
+            std::cerr << PerfCounters::EventName(i) << "/Call: ";
+            if (PerfCounters::Available(i)) {
+              std::cerr << sum[i] / double(n_calls) << "\t";
+            } else {
+              std::cerr << "unavailable\t";
+            }
+          }
+          std::cerr << key << '\n';
+        }
+      }
+
+      // -------------------------------- Print Copy Results --------------------------------
+      bool first = true;
+      for (const auto &key : keys) {
+        if (copies.count(key) == 0) continue;
+        auto &sum = copies.at(key);
+        size_t bytes = sum.values_ * sizeof(Attribute) + sum.string_bytes_ + sum.sel_bytes_;
+        if (bytes == 0 && sum.alloc_bytes_ == 0) continue;
+        if (first) std::cerr << "-------\n";
+        first = false;
+
+        std::cerr << "Values: " << sum.values_
+                  << "\tValue Bytes: " << double(sum.values_ * sizeof(Attribute)) / (1 << 20) << " MB\tString Bytes: "
+                  << double(sum.string_bytes_) / (1 << 20) << " MB\tSel Bytes: " << double(sum.sel_bytes_) / (1 << 20)
+                  << " MB\tAllocated: " << double(sum.alloc_bytes_) / (1 << 20)
+                  << " MB\tBytes/Call: " << bytes / double(calling_times.at(key)) << "\t" << key << '\n';
+      }
     }
+    std::cerr << "-------\n";
+    std::cerr << "Vector Storage - Live: " << double(MemoryCounters::Live()) / (1 << 20)
+              << " MB\tPeak (upper bound, sum of the thread peaks): " << double(MemoryCounters::Peak()) / (1 << 20)
+              << " MB\n";
 
     // -------------------------------- Print HT Results --------------------------------
     std::vector<string> ht_keys;
@@ -146,17 +302,24 @@ class BeeProfiler {
 
         std::cerr << "Tuples Size: " << (double) ht_info.tuple_size / (1 << 20) << " MB\t"
                   << "Point Size: " << (double) ht_info.point_table_size / (1 << 20) << " MB\t"
-                  << "#Term: " << ht_info.num_terms << "\t" << key << '\n';
+                  << "#Term: " << ht_info.num_terms << "\t"
+                  << "Max Chain: " << ht_info.max_chain << "\t" << key << '\n';
       }
     }
   }
 
+  // Resets the counters and the peak memory. The handles and the hash table records stay valid, since the hash
+  // tables can outlive a run.
   void Clear() {
     std::lock_guard<std::mutex> lock(mtx);
 
-    values_.clear();
-    calling_times_.clear();
-    ht_records_.clear();
+    for (auto &local : locals_) {
+      std::fill(local->values_.begin(), local->values_.end(), 0);
+      std::fill(local->calling_times_.begin(), local->calling_times_.end(), 0);
+      local->events_.clear();
+      local->copies_.clear();
+    }
+    MemoryCounters::ResetPeak();
   }
 
  private:
@@ -164,118 +327,292 @@ class BeeProfiler {
     size_t tuple_size;
     size_t point_table_size;
     size_t num_terms;
+    // the tuples of the longest bucket list
+    size_t max_chain;
 
-    HTInfo(size_t ts = 0, size_t pts = 0, size_t nt = 0) : tuple_size(ts), point_table_size(pts), num_terms(nt) {
+    HTInfo(size_t ts = 0, size_t pts = 0, size_t nt = 0, size_t mc = 0)
+        : tuple_size(ts), point_table_size(pts), num_terms(nt), max_chain(mc) {
     }
   };
 
-  unordered_map<string, size_t> values_;
-  unordered_map<string, size_t> calling_times_;
+  // the counters of one thread, indexed by handle
+  struct LocalRecords {
+    vector<size_t> values_;
+    vector<size_t> calling_times_;
+    vector<PerfCounters::Values> events_;
+    vector<CopyCounters> copies_;
+  };
+
+  inline LocalRecords &Local() {
+    thread_local LocalRecords *local = nullptr;
+    if (local == nullptr) {
+      // The records outlive the thread, so that they can be merged after the thread has finished.
+      auto records = std::make_unique<LocalRecords>();
+      local = records.get();
+      lock_guard<mutex> lock(mtx);
+      locals_.push_back(std::move(records));
+    }
+    return *local;
+  }
+
+  vector<string> names_;
+  unordered_map<string, idx_t> handles_;
+  vector<unique_ptr<LocalRecords>> locals_;
   unordered_map<string, HTInfo> ht_records_;
   mutable std::mutex mtx;
 };
 
-class ZebraProfiler {
+// Times a region like Profiler. It also counts the bytes copied and allocated in the region and, if the hardware
+// counters are enabled, the events in the region. Record() attributes all of them to a BeeProfiler record.
+class RegionProfiler {
  public:
-  const static bool kEnableProfiling = 0;
+  inline void Start() {
+    if (PerfCounters::Enabled()) PerfCounters::Read(start_);
+    copies_ = CopyCounters::Local();
+    profiler_.Start();
+  }
+
+  inline double Elapsed() const { return profiler_.Elapsed(); }
+
+  // Records the region (since the last Start) into the record [id], and returns the elapsed time in seconds.
+  inline double Record(idx_t id) {
+    double time = profiler_.Elapsed();
+    BeeProfiler::Get().InsertStatRecord(id, time);
+    // A region can be recorded in parts: the next Record only counts the bytes from here.
+    auto &copies = CopyCounters::Local();
+    BeeProfiler::Get().InsertCopyRecord(id, copies_, copies);
+    copies_ = copies;
+    if (PerfCounters::Enabled()) {
+      PerfCounters::Values end;
+      PerfCounters::Read(end);
+      BeeProfiler::Get().InsertEventRecord(id, start_, end);
+    }
+    return time;
+  }
+
+ private:
+  Profiler profiler_;
+  PerfCounters::Values start_{};
+  CopyCounters copies_;
+};
 
+// The chunk-size telemetry. For each operator and compactor, it keeps histograms of the chunk sizes entering and
+// leaving it, and the time spent for each input chunk size. It is switched on at runtime, each thread records into
+// its own histograms without locks, and 1-in-N sampling can thin the records further.
+//
+// A record is keyed by the pipeline level the thread is running (set by the pipeline) and the kind of the operator,
+// e.g. "level-2/[Dynamic Compact]", so the keys do not depend on addresses, threads, or the order of construction.
+// The histograms of all threads are merged under their key, in one section per strategy, and written as one JSON
+// document at the end of the run.
+class ZebraProfiler {
  public:
   static ZebraProfiler &Get() {
     static ZebraProfiler instance;
     return instance;
   }
 
-  inline void InsertRecord(string name, size_t key, double value) {
-    InsertRecord(std::move(name), key, size_t(value * 1e9));
+  // Must be called before any thread starts recording. [sample_rate] = N records one of every N chunks.
+  inline void Enable(const string &path, size_t sample_rate = 1) {
+    path_ = path;
+    sample_rate_ = std::max(sample_rate, size_t(1));
+    enabled_ = true;
   }
 
-  inline void InsertRecord(string name, size_t key, size_t value) {
-    if (kEnableProfiling) {
-      assert(key <= kBlockSize);
+  inline bool Enabled() const { return enabled_; }
 
-      if (hists_.count(name) == 0) {
-        lock_guard<std::mutex> lock(mutex_);
-        hists_[name] = Histogram();
-      }
+  // Returns the handle of the operator [kind]. All operators of a kind share it.
+  inline idx_t Register(const string &kind) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = std::find(kinds_.begin(), kinds_.end(), kind);
+    if (it != kinds_.end()) return it - kinds_.begin();
+    kinds_.push_back(kind);
+    return kinds_.size() - 1;
+  }
 
-      // insert record into the histogram of [name]
-      auto &hist = hists_[name];
-      hist.values_[key] += value;
-      hist.cnt_[key] += 1;
-    }
+  // The calling thread records at the pipeline [level] until the next call.
+  static inline void SetLevel(size_t level) { CurrentLevel() = level; }
+
+  inline void InsertRecord(idx_t kind, size_t n_input, size_t n_output, double time) {
+    if (!enabled_) return;
+    Histogram *hist = Sample(kind);
+    if (hist == nullptr) return;
+
+    assert(n_input <= kBlockSize && n_output <= kBlockSize);
+
+    hist->input_[n_input] += 1;
+    hist->output_[n_output] += 1;
+    hist->time_[n_input] += size_t(time * 1e9);
   }
 
-  inline void PrintResults() const {
-    if (kEnableProfiling) {
-      for (auto &pair : hists_) {
-        const auto &name = pair.first;
-        const auto &hist = pair.second;
+  // A record of a sink, which consumes its input without emitting chunks, so it has no output histogram.
+  inline void InsertSinkRecord(idx_t kind, size_t n_input, double time) {
+    if (!enabled_) return;
+    Histogram *hist = Sample(kind);
+    if (hist == nullptr) return;
 
-        std::cerr << "-------\n";
-        std::cerr << name << '\n';
-        for (size_t i = 1; i <= kBlockSize; ++i) {
-          if (hist.cnt_[i] > 0) {
-            std::cerr << i << ": " << hist.values_[i] / double(1e3) / hist.cnt_[i] << " us\t"
-                      << hist.cnt_[i] << '\n';
-          }
+    assert(n_input <= kBlockSize);
+
+    hist->sink_ = true;
+    hist->input_[n_input] += 1;
+    hist->time_[n_input] += size_t(time * 1e9);
+  }
+
+  // Merges the histograms of all threads into a section for [strategy], and starts the next one. Must be called
+  // when no thread is recording.
+  inline void EndSection(const string &strategy) {
+    if (!enabled_) return;
+    lock_guard<mutex> lock(mutex_);
+    Section section{strategy, {}};
+    for (auto &local : locals_) {
+      for (size_t level = 0; level < local->hists_.size(); ++level) {
+        auto &hists = local->hists_[level];
+        for (size_t kind = 0; kind < hists.size(); ++kind) {
+          if (hists[kind] != nullptr) section.hists_[{level, kind}].Merge(*hists[kind]);
         }
       }
+      local->hists_.clear();
     }
+    sections_.push_back(std::move(section));
   }
 
-  // output to csv file, each hist has a file.
-  inline void ToCSV() {
-    if (kEnableProfiling) {
-      std::string folder_name = "./zebra_log_0x" + std::to_string(RandomInteger());
-      std::filesystem::create_directories(folder_name);
-      for (auto &pair : hists_) {
-        const auto &name = pair.first;
-        const auto &hist = pair.second;
-
-        // filter these filters
-        if (name.find("FILTER") != string::npos) {
-          continue;
+  // Writes the sections as one JSON document. The records after the last section go to a section without a
+  // strategy. Must be called when no thread is recording.
+  inline void ToJSON() {
+    if (!enabled_) return;
+    bool pending = false;
+    for (auto &local : locals_) pending |= !local->hists_.empty();
+    if (pending) EndSection("");
+    lock_guard<mutex> lock(mutex_);
+
+    std::ofstream out(path_);
+    if (!out.is_open()) throw std::runtime_error("Unable to open file " + path_);
+    out << "{\n  \"block_size\": " << kBlockSize << ",\n  \"sample_rate\": " << sample_rate_
+        << ",\n  \"threads\": " << locals_.size() << ",\n  \"strategies\": [";
+    for (size_t s = 0; s < sections_.size(); ++s) {
+      out << (s == 0 ? "\n" : ",\n") << "  {\"strategy\": \"" << sections_[s].strategy_ << "\", \"operators\": [";
+      bool first = true;
+      for (auto &[key, hist] : sections_[s].hists_) {
+        auto [level, kind] = key;
+        size_t calls = 0, input_tuples = 0, output_tuples = 0, time = 0;
+        for (size_t i = 0; i <= kBlockSize; ++i) {
+          calls += hist.input_[i];
+          input_tuples += hist.input_[i] * i;
+          output_tuples += hist.output_[i] * i;
+          time += hist.time_[i];
         }
 
-        string file_name = folder_name + "/" + name + ".csv";
-        std::ofstream out(file_name);
-        out << "key, value, cnt\n";
-        for (size_t i = 1; i <= kBlockSize; ++i) {
-          if (hist.cnt_[i] == 0) continue;
-          out << i << "," << hist.values_[i] / double(1e3) / hist.cnt_[i] << "," << hist.cnt_[i] << "\n";
+        out << (first ? "\n" : ",\n") << "    {\"id\": \"level-" << level << "/" << kinds_[kind]
+            << "\", \"level\": " << level << ", \"kind\": \"" << kinds_[kind] << "\", \"calls\": " << calls
+            << ", \"input_tuples\": " << input_tuples;
+        if (!hist.sink_) out << ", \"output_tuples\": " << output_tuples;
+        out << ", \"time_ns\": " << time;
+        // sparse histograms: [chunk size, number of chunks]
+        out << ",\n     \"input\": ";
+        WriteHistogram(out, hist.input_);
+        if (!hist.sink_) {
+          out << ",\n     \"output\": ";
+          WriteHistogram(out, hist.output_);
         }
-        out.close();
+        // [input chunk size, total time in ns]
+        out << ",\n     \"time_ns_by_input\": ";
+        WriteHistogram(out, hist.time_);
+        out << "}";
+        first = false;
       }
+      out << "\n  ]}";
     }
+    out << "\n  ]\n}\n";
   }
 
+  // Resets the histograms and the sections. The handles stay valid.
   inline void Clear() {
-    hists_.clear();
+    lock_guard<mutex> lock(mutex_);
+    for (auto &local : locals_) local->hists_.clear();
+    sections_.clear();
   }
 
  private:
-  ZebraProfiler() : gen_(rd()) {
+  struct Histogram {
+    // chunks seen, including the ones skipped by sampling
+    size_t n_chunk_ = 0;
+    // recorded by a sink: [output_] is unused
+    bool sink_ = false;
+    vector<size_t> input_;
+    vector<size_t> output_;
+    vector<size_t> time_;  // in ns, by input size
+
+    Histogram() : input_(kBlockSize + 1), output_(kBlockSize + 1), time_(kBlockSize + 1) {}
+
+    inline void Merge(const Histogram &other) {
+      sink_ |= other.sink_;
+      for (size_t i = 0; i <= kBlockSize; ++i) {
+        input_[i] += other.input_[i];
+        output_[i] += other.output_[i];
+        time_[i] += other.time_[i];
+      }
+    }
+  };
+
+  // the histograms of one thread, indexed by level and kind
+  struct LocalHistograms {
+    vector<vector<unique_ptr<Histogram>>> hists_;
+  };
+
+  // the merged histograms of one strategy, ordered by level and kind
+  struct Section {
+    string strategy_;
+    std::map<std::pair<size_t, idx_t>, Histogram> hists_;
+  };
+
+  static inline void WriteHistogram(std::ostream &out, const vector<size_t> &values) {
+    out << "[";
+    bool first = true;
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (values[i] == 0) continue;
+      out << (first ? "" : ", ") << "[" << i << ", " << values[i] << "]";
+      first = false;
+    }
+    out << "]";
   }
 
-  inline size_t RandomInteger() {
-    return integers(gen_);
+  // Returns the histogram of [kind] at the current level of this thread, or null if sampling skips the record.
+  inline Histogram *Sample(idx_t kind) {
+    auto &local = Local();
+    size_t level = CurrentLevel();
+    if (level >= local.hists_.size()) local.hists_.resize(level + 1);
+    auto &hists = local.hists_[level];
+    if (kind >= hists.size()) hists.resize(kind + 1);
+    auto &hist = hists[kind];
+    if (hist == nullptr) hist = std::make_unique<Histogram>();
+    if (sample_rate_ > 1 && hist->n_chunk_++ % sample_rate_ != 0) return nullptr;
+    return hist.get();
   }
 
-  struct Histogram {
-    vector<atomic<size_t>> values_;  // in ns
-    vector<atomic<size_t>> cnt_;
+  static inline size_t &CurrentLevel() {
+    thread_local size_t level = 0;
+    return level;
+  }
 
-    Histogram() : values_(kBlockSize + 1), cnt_(kBlockSize + 1) {
+  inline LocalHistograms &Local() {
+    thread_local LocalHistograms *local = nullptr;
+    if (local == nullptr) {
+      // The histograms outlive the thread, so that they can be merged after the thread has finished.
+      auto hists = std::make_unique<LocalHistograms>();
+      local = hists.get();
+      lock_guard<mutex> lock(mutex_);
+      locals_.push_back(std::move(hists));
     }
-  };
+    return *local;
+  }
 
-  mutex mutex_;
-  unordered_map<string, Histogram> hists_;
+  bool enabled_ = false;
+  string path_;
+  size_t sample_rate_ = 1;
 
-  // random
-  std::random_device rd;
-  std::mt19937 gen_;
-  std::uniform_int_distribution<int> integers;
+  mutex mutex_;
+  vector<string> kinds_;
+  vector<unique_ptr<LocalHistograms>> locals_;
+  vector<Section> sections_;
 };
-}  // namespace duckdb
+}  // namespace compaction
 
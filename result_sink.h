@@ -0,0 +1,387 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// result_sink.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <thread>
+
+#include "base.h"
+#include "physical_operator.h"
+#include "profiler.h"
+#include "table_file.h"
+
+namespace compaction {
+
+enum class ResultFormat : uint8_t {
+  // a table file, see table_file.h
+  BINARY = 0,
+  CSV = 1
+};
+
+inline ResultFormat ParseResultFormat(const string &name) {
+  if (name == "binary") return ResultFormat::BINARY;
+  if (name == "csv") return ResultFormat::CSV;
+  throw std::runtime_error("Unknown result format: " + name + " (binary or csv)");
+}
+
+inline const char *ResultFormatName(ResultFormat format) { return format == ResultFormat::BINARY ? "binary" : "csv"; }
+
+// Writes buffers to a file on a background thread. A buffer is written at the next multiple of [alignment] after the
+// previous one, and the writer keeps where each one went. It is double-buffered: the thread writes one buffer while
+// the next one waits, and Submit blocks while both are taken, so the memory is bounded however much is written.
+class BackgroundWriter {
+ public:
+  // [start]: the offset of the first buffer, e.g., after a header that is written at the end
+  BackgroundWriter(const string &path, size_t start, size_t alignment)
+      : path_(path), offset_(start), alignment_(alignment) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) throw std::runtime_error("Cannot create the file: " + path);
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  BackgroundWriter(const BackgroundWriter &) = delete;
+  BackgroundWriter &operator=(const BackgroundWriter &) = delete;
+
+  ~BackgroundWriter() {
+    Stop();
+    close(fd_);
+  }
+
+  // Hands [buffer] of [count] tuples to the thread, and leaves an empty buffer (with capacity) in its place.
+  inline void Submit(vector<char> &buffer, size_t count) {
+    std::unique_lock<mutex> lock(mutex_);
+    Profiler timer;
+    timer.Start();
+    ready_.wait(lock, [&] { return !has_next_; });
+    stall_time_ += timer.Elapsed();
+    next_.swap(buffer);
+    next_count_ = count;
+    has_next_ = true;
+    lock.unlock();
+    ready_.notify_all();
+    buffer.clear();
+  }
+
+  // Waits until all buffers are written.
+  inline void Close() {
+    Stop();
+    if (!error_.empty()) throw std::runtime_error("Cannot write the file " + path_ + ": " + error_);
+  }
+
+  // Writes [bytes] at [offset] on the calling thread, e.g., a header after Close.
+  inline void WriteAt(const void *data, size_t bytes, size_t offset) {
+    auto *pos = static_cast<const char *>(data);
+    while (bytes > 0) {
+      ssize_t written = pwrite(fd_, pos, bytes, offset);
+      if (written < 0 && errno == EINTR) continue;
+      if (written <= 0) {
+        error_ = std::strerror(errno);
+        throw std::runtime_error("Cannot write the file " + path_ + ": " + error_);
+      }
+      pos += written;
+      bytes -= written;
+      offset += written;
+    }
+  }
+
+  // where the buffers went, in the order they were written
+  inline const vector<table_file::SegmentEntry> &Blocks() const { return blocks_; }
+
+  // the end of the last buffer
+  inline size_t End() const { return offset_; }
+
+  // the time the thread spent writing, and the time Submit waited for it
+  inline double WriteTime() const { return write_time_; }
+
+  inline double StallTime() const { return stall_time_; }
+
+ private:
+  string path_;
+  int fd_ = -1;
+  size_t offset_;
+  size_t alignment_;
+  vector<table_file::SegmentEntry> blocks_;
+
+  std::thread thread_;
+  mutex mutex_;
+  std::condition_variable ready_;
+  // the buffer that waits for the thread
+  vector<char> next_;
+  size_t next_count_ = 0;
+  bool has_next_ = false;
+  bool closing_ = false;
+
+  double write_time_ = 0;
+  double stall_time_ = 0;
+  // the first error of the thread
+  string error_;
+
+  inline void Stop() {
+    if (!thread_.joinable()) return;
+    {
+      lock_guard<mutex> lock(mutex_);
+      closing_ = true;
+    }
+    ready_.notify_all();
+    thread_.join();
+  }
+
+  void Run() {
+    vector<char> buffer;
+    while (true) {
+      size_t count;
+      {
+        std::unique_lock<mutex> lock(mutex_);
+        ready_.wait(lock, [&] { return has_next_ || closing_; });
+        if (!has_next_) return;
+        buffer.swap(next_);
+        count = next_count_;
+        has_next_ = false;
+      }
+      ready_.notify_all();
+
+      Profiler timer;
+      timer.Start();
+      offset_ = table_file::Align(offset_, alignment_);
+      if (error_.empty()) {
+        try {
+          WriteAt(buffer.data(), buffer.size(), offset_);
+        } catch (std::exception &) {
+          // the error is kept, and thrown by Close; the buffers that follow are dropped
+        }
+      }
+      blocks_.push_back({offset_, buffer.size(), count});
+      offset_ += buffer.size();
+      write_time_ += timer.Elapsed();
+      buffer.clear();
+    }
+  }
+};
+
+// Streams the results into the file [path] instead of keeping them: as a table file, which --load-table can scan, or
+// as CSV. Each pipeline serializes its chunks into its own buffer, a segment of up to kBlockSize tuples column by
+// column, or kCSVBufferBytes of rows, and hands the full buffer to a BackgroundWriter. The memory is a buffer per
+// pipeline and two for the writer, whatever the size of the result. The buffers of the pipelines are interleaved in
+// the file, so the order of the results is not kept.
+class PhysicalFileSink : public PhysicalSink {
+ public:
+  // the rows of CSV that a pipeline buffers before it hands them to the writer
+  static constexpr size_t kCSVBufferBytes = 1 << 20;
+
+  PhysicalFileSink(const vector<AttributeType> &types, const string &path, ResultFormat format, char delimiter = ',')
+      : types_(types), path_(path), format_(format), delimiter_(delimiter), quoted_chars_{delimiter, '"', '\n', '\r'},
+        column_bytes_(types.size(), 0),
+        serialize_id_(BeeProfiler::Get().Register("[File Sink - Serialize]")),
+        submit_id_(BeeProfiler::Get().Register("[File Sink - Submit]")) {
+    using namespace table_file;
+    if (format_ == ResultFormat::BINARY) {
+      // the segments start after the headers, at page boundaries
+      size_t headers = Align(sizeof(FileHeader) + types_.size() * sizeof(ColumnHeader), kPageSize);
+      writer_ = std::make_unique<BackgroundWriter>(path, headers, kPageSize);
+    } else {
+      writer_ = std::make_unique<BackgroundWriter>(path, 0, 1);
+    }
+    timer_.Start();
+  }
+
+  struct FileSinkState : public OperatorState {
+    // BINARY: the values of the segment so far, per column: the bytes of an INTEGER or DOUBLE column, or the
+    // characters and the end offsets of a STRING column
+    vector<vector<char>> columns_;
+    vector<vector<uint32_t>> offsets_;
+    size_t count_ = 0;
+    // the buffer for the writer
+    vector<char> buffer_;
+    size_t buffer_count_ = 0;
+    vector<uint64_t> column_bytes_;
+    RegionProfiler profiler_;
+
+    explicit FileSinkState(size_t n_cols)
+        : columns_(n_cols), offsets_(n_cols, vector<uint32_t>{0}), column_bytes_(n_cols, 0) {}
+  };
+
+  unique_ptr<OperatorState> GetState() const override { return std::make_unique<FileSinkState>(types_.size()); }
+
+  void Sink(DataChunk &input, OperatorState &state) override {
+    auto &local = static_cast<FileSinkState &>(state);
+    if (format_ == ResultFormat::CSV) {
+      local.profiler_.Start();
+      AppendRows(input, local);
+      local.profiler_.Record(serialize_id_);
+      if (local.buffer_.size() >= kCSVBufferBytes) Submit(local);
+      return;
+    }
+
+    for (size_t start = 0; start < input.count_;) {
+      local.profiler_.Start();
+      size_t n = std::min(kBlockSize - local.count_, input.count_ - start);
+      AppendColumns(input, start, n, local);
+      start += n;
+      if (local.count_ == kBlockSize) EncodeSegment(local);
+      local.profiler_.Record(serialize_id_);
+      if (local.buffer_count_ > 0) Submit(local);
+    }
+  }
+
+  void Finalize(OperatorState &state) override {
+    auto &local = static_cast<FileSinkState &>(state);
+    if (local.count_ > 0) EncodeSegment(local);
+    if (!local.buffer_.empty()) Submit(local);
+    lock_guard<mutex> lock(mutex_);
+    for (size_t c = 0; c < types_.size(); ++c) column_bytes_[c] += local.column_bytes_[c];
+  }
+
+  // Waits for the writer, and writes the headers and the directory of a table file. Must be called after all
+  // pipelines are finalized.
+  inline void Close() {
+    using namespace table_file;
+    writer_->Close();
+    auto &blocks = writer_->Blocks();
+    for (auto &block : blocks) n_tuples_ += block.count_;
+    file_bytes_ = writer_->End();
+    if (format_ == ResultFormat::BINARY) {
+      FileHeader header{};
+      std::memcpy(header.magic_, kMagic, sizeof(kMagic));
+      header.version_ = kVersion;
+      header.n_cols_ = types_.size();
+      header.n_tuples_ = n_tuples_;
+      header.block_size_ = kBlockSize;
+      header.n_segments_ = blocks.size();
+      header.directory_offset_ = Align(file_bytes_, kPageSize);
+      vector<ColumnHeader> columns(types_.size());
+      for (size_t c = 0; c < types_.size(); ++c) columns[c] = {uint8_t(types_[c]), {}, column_bytes_[c]};
+
+      writer_->WriteAt(blocks.data(), blocks.size() * sizeof(SegmentEntry), header.directory_offset_);
+      writer_->WriteAt(&header, sizeof(header), 0);
+      writer_->WriteAt(columns.data(), columns.size() * sizeof(ColumnHeader), sizeof(header));
+      file_bytes_ = header.directory_offset_ + blocks.size() * sizeof(SegmentEntry);
+    }
+    time_ = timer_.Elapsed();
+  }
+
+  // Shows the tuples and the bytes written, and the throughput of the sink.
+  inline void PrintStatistics() const {
+    double mb = file_bytes_ / double(1 << 20);
+    std::cerr << "[File Sink]: " << n_tuples_ << " tuples, " << file_bytes_ << " bytes (" << ResultFormatName(format_)
+              << ") to " << path_ << " in " << time_ << "s: " << mb / time_ << " MB/s\n";
+    std::cerr << "[File Sink - Writer]: " << writer_->WriteTime() << "s writing ("
+              << mb / std::max(writer_->WriteTime(), 1e-9) << " MB/s), the pipelines waited "
+              << writer_->StallTime() << "s\n";
+  }
+
+ private:
+  vector<AttributeType> types_;
+  string path_;
+  ResultFormat format_;
+  char delimiter_;
+  // the characters that make a string quoted in CSV
+  string quoted_chars_;
+  unique_ptr<BackgroundWriter> writer_;
+
+  mutex mutex_;
+  vector<uint64_t> column_bytes_;
+  size_t n_tuples_ = 0;
+  size_t file_bytes_ = 0;
+  Profiler timer_;
+  double time_ = 0;
+
+  // profiling records
+  const idx_t serialize_id_;
+  const idx_t submit_id_;
+
+  inline void Submit(FileSinkState &local) {
+    local.profiler_.Start();
+    writer_->Submit(local.buffer_, local.buffer_count_);
+    local.buffer_count_ = 0;
+    local.profiler_.Record(submit_id_);
+  }
+
+  // Appends the tuples [start, start + n) of [input] to the segment.
+  inline void AppendColumns(DataChunk &input, size_t start, size_t n, FileSinkState &local) const {
+    for (size_t c = 0; c < types_.size(); ++c) {
+      auto &col = input.data_[c];
+      auto &bytes = local.columns_[c];
+      if (types_[c] == AttributeType::STRING) {
+        auto &offsets = local.offsets_[c];
+        for (size_t i = start; i < start + n; ++i) {
+          auto &value = std::get<string>(col.GetValue(col.selection_vector_[i]));
+          bytes.insert(bytes.end(), value.begin(), value.end());
+          offsets.push_back(bytes.size());
+        }
+      } else {
+        size_t size = bytes.size();
+        bytes.resize(size + n * 8);
+        char *out = bytes.data() + size;
+        for (size_t i = start; i < start + n; ++i, out += 8) {
+          auto &value = col.GetValue(col.selection_vector_[i]);
+          if (types_[c] == AttributeType::INTEGER) std::memcpy(out, &std::get<size_t>(value), 8);
+          else std::memcpy(out, &std::get<double>(value), 8);
+        }
+      }
+    }
+    local.count_ += n;
+  }
+
+  // Encodes the segment into the buffer, as in a table file, and starts the next one.
+  inline void EncodeSegment(FileSinkState &local) const {
+    auto &buffer = local.buffer_;
+    for (size_t c = 0; c < types_.size(); ++c) {
+      size_t col_start = buffer.size();
+      if (types_[c] == AttributeType::STRING) {
+        auto &offsets = local.offsets_[c];
+        auto *begin = reinterpret_cast<const char *>(offsets.data());
+        buffer.insert(buffer.end(), begin, begin + offsets.size() * sizeof(uint32_t));
+        offsets.assign(1, 0);
+      }
+      buffer.insert(buffer.end(), local.columns_[c].begin(), local.columns_[c].end());
+      local.columns_[c].clear();
+      buffer.resize(table_file::Align(buffer.size(), 8));
+      local.column_bytes_[c] += buffer.size() - col_start;
+    }
+    local.buffer_count_ = local.count_;
+    local.count_ = 0;
+  }
+
+  // Appends the tuples of [input] to the buffer as rows of CSV, without a header. A string with the delimiter, a quote
+  // or a line break is quoted (CSVReader reads the file back, unless a string has a line break).
+  inline void AppendRows(DataChunk &input, FileSinkState &local) const {
+    auto &buffer = local.buffer_;
+    char number[32];
+    for (size_t i = 0; i < input.count_; ++i) {
+      for (size_t c = 0; c < types_.size(); ++c) {
+        if (c > 0) buffer.push_back(delimiter_);
+        auto &col = input.data_[c];
+        auto &value = col.GetValue(col.selection_vector_[i]);
+        if (types_[c] == AttributeType::STRING) {
+          auto &text = std::get<string>(value);
+          if (text.find_first_of(quoted_chars_) == string::npos) {
+            buffer.insert(buffer.end(), text.begin(), text.end());
+            continue;
+          }
+          buffer.push_back('"');
+          for (char ch : text) {
+            if (ch == '"') buffer.push_back('"');
+            buffer.push_back(ch);
+          }
+          buffer.push_back('"');
+        } else {
+          auto result = types_[c] == AttributeType::INTEGER
+                        ? std::to_chars(number, number + sizeof(number), std::get<size_t>(value))
+                        : std::to_chars(number, number + sizeof(number), std::get<double>(value));
+          buffer.insert(buffer.end(), number, result.ptr);
+        }
+      }
+      buffer.push_back('\n');
+    }
+    local.buffer_count_ += input.count_;
+  }
+};
+}
@@ -10,6 +10,11 @@
 #pragma once
 
 #include "compactor.h"
+#include "strategy.h"
+#include "hash_aggregate.h"
+#include "sort.h"
+#include "generator.h"
+#include "result_sink.h"
 
 // This file contains all parameters used in the project
 namespace compaction {
@@ -22,29 +27,83 @@ size_t kRHSTupleSize = 2e6;
 size_t kChunkFactor = 8;
 double kLoadFactor = 0.5;
 
+// the distribution of the join keys of the probe table (--probe-dist), the probability that a join key repeats the
+// key of the first join column (--key-correlation), and the fan-out of the hash tables (--build-dist): CONSTANT is
+// kChunkFactor tuples per key. See KeyDistribution.
+KeyDistribution kProbeDistribution;
+double kKeyCorrelation = 0;
+KeyDistribution kBuildDistribution(DistributionType::CONSTANT);
+
+// the seed of the generated tables (--seed). The tables depend on it only, not on the number of threads.
+uint64_t kSeed = 2;
+
+// the table file (or CSV file) to scan instead of generating the probe table (--load-table), and the table file to
+// write the probe table to (--save-table), see table_file.h and csv_reader.h. Empty: none.
+string kLoadTablePath;
+string kSaveTablePath;
+// the field delimiter of a CSV file (--csv-delimiter)
+char kCSVDelimiter = ',';
+// the file to stream the results to (--result-file), and its format (--result-format), see result_sink.h. Empty: the
+// results are aggregated, ordered, or collected (if flag_collect_tuples) instead.
+string kResultPath;
+ResultFormat kResultFormat = ResultFormat::BINARY;
+
 // filter setting
 size_t kFilter = 1;
 size_t kTupleSize = 2e7;
 size_t kCols = 10;
 double kSelectivity = 0.2;
 
-// #define flag_dynamic_compact
-
-#if defined(flag_no_compact)
-using Compactor = NaiveCompactor;
-const string strategy_name = "no_compaction";
-#elif defined(flag_full_compact)
-using Compactor = NaiveCompactor;
-const string strategy_name = "full_compaction";
+// The compaction strategies to run one after another on the same data (--strategy). The build flags pick the default.
+#if defined(flag_full_compact)
+vector<Strategy> kStrategies{{true, CompactType::FULL}};
 #elif defined(flag_dynamic_compact)
-using Compactor = DynamicCompactor;
-const string strategy_name = "dynamic_compaction";
+vector<Strategy> kStrategies{{true, CompactType::DYNAMIC}};
 #else
-using Compactor = NaiveCompactor;
-const string strategy_name = "no_compaction";
+vector<Strategy> kStrategies{{true, CompactType::NONE}};
 #endif
 
-constexpr bool kEnableLogicalCompact = true;
+// The policy that picks the threshold of the dynamic compactor, and the number of calls per tuning epoch.
+TunerType kTuner = TunerType::UCB;
+size_t kTunerEpoch = 16;
+// The file to warm-start the tuner from, and to save the learned state to. Empty: cold start, nothing saved.
+string kTunerState;
+// Print the estimates of the tuner after each run, and write the reward history of each compactor (--tuner-log).
+bool kTunerLog = false;
 
 bool flag_collect_tuples = false;
+
+// the plan file of the plan driver (--plan)
+string kPlanPath;
+// or the TPC-H-style query of the plan driver (--tpch), and its scale factor
+string kTPCHQuery;
+double kScaleFactor = 1;
+
+// the aggregation that ends the pipeline: the group columns and the aggregates. No aggregates: the results are
+// collected (if flag_collect_tuples) instead.
+vector<size_t> kGroupBy;
+vector<AggregateSpec> kAggregates;
+
+// the order of the results (--order-by), and the number of results to keep (0: all). No order: the results are
+// aggregated or collected instead.
+vector<SortSpec> kOrderBy;
+size_t kLimit = 0;
+
+// the expressions of the projection (';'-separated, empty: no projection), and the operators it follows
+string kProjection;
+vector<size_t> kProjectionLevels{1};
+
+// morsel-driven parallelism: the number of worker threads, and the number of chunks per morsel
+size_t kThreads = 1;
+size_t kMorselSize = 64;
+
+// chunk-size telemetry: the JSON file to write (empty: off), and record one of every N chunks
+string kTelemetryPath;
+size_t kTelemetrySample = 1;
+
+// count hardware events (or software events, if hardware ones are not available) per profiled region
+bool kPerfCounters = false;
+
+// the Chrome trace file of the pipeline execution (empty: off)
+string kTracePath;
 }
\ No newline at end of file
@@ -0,0 +1,490 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// sort.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "base.h"
+#include "profiler.h"
+#include "data_collection.h"
+#include "physical_operator.h"
+
+namespace compaction {
+
+// the number of leading characters of a string in its sort key. Strings with the same prefix are compared in full.
+constexpr size_t kStringPrefix = 16;
+
+struct SortSpec {
+  size_t col_id_;
+  bool desc_;
+
+  inline string Name() const { return std::to_string(col_id_) + (desc_ ? ":desc" : ""); }
+
+  // <column>, <column>:asc, or <column>:desc
+  static inline SortSpec Parse(const string &spec) {
+    auto colon = spec.find(':');
+    size_t col_id = std::stoul(spec.substr(0, colon));
+    if (colon == string::npos) return {col_id, false};
+    string order = spec.substr(colon + 1);
+    if (order == "asc") return {col_id, false};
+    if (order == "desc") return {col_id, true};
+    throw std::runtime_error("Unknown sort order: " + spec);
+  }
+
+  // a comma-separated list of sort columns, e.g., "4:desc,1"
+  static inline vector<SortSpec> ParseList(const string &specs) {
+    vector<SortSpec> order_by;
+    std::stringstream ss(specs);
+    string spec;
+    while (std::getline(ss, spec, ',')) order_by.push_back(Parse(spec));
+    if (order_by.empty()) throw std::runtime_error("No sort column given");
+    return order_by;
+  }
+};
+
+// The normalized sort key of a tuple: the sort columns encoded one after another into bytes that compare with memcmp
+// in the order of the tuples. An integer is 8 bytes big-endian, a double is its bits with the sign flipped (and the
+// rest inverted for a negative value), and a string is its first kStringPrefix characters, padded with zeros. The
+// bytes of a descending column are inverted. Two strings with the same prefix are compared in full before the columns
+// after them, so memcmp orders the keys by their bytes up to the end of the first string only (PrefixWidth).
+class SortKeyLayout {
+ public:
+  SortKeyLayout(const vector<AttributeType> &input_types, const vector<SortSpec> &order_by) : order_by_(order_by) {
+    for (auto &spec : order_by_) {
+      if (spec.col_id_ >= input_types.size()) throw std::runtime_error("Sort column out of range: " + spec.Name());
+      auto type = input_types[spec.col_id_];
+      types_.push_back(type);
+      offsets_.push_back(width_);
+      if (type == AttributeType::STRING) {
+        width_ += kStringPrefix;
+        if (!has_strings_) prefix_width_ = width_;
+        has_strings_ = true;
+      } else {
+        width_ += sizeof(uint64_t);
+      }
+    }
+    if (!has_strings_) prefix_width_ = width_;
+  }
+
+  // the number of bytes of a key
+  inline size_t Width() const { return width_; }
+
+  // the number of leading bytes of a key that order it when they differ: the whole key, or the bytes up to the end of
+  // the first string
+  inline size_t PrefixWidth() const { return prefix_width_; }
+
+  // Writes the keys of the tuples of [input] to [keys], one every [stride] bytes. Column by column, for the whole chunk.
+  inline void Normalize(DataChunk &input, uint8_t *keys, size_t stride) const {
+    for (size_t k = 0; k < order_by_.size(); ++k) {
+      auto &col = input.data_[order_by_[k].col_id_];
+      auto &sel = col.selection_vector_;
+      uint8_t *key = keys + offsets_[k];
+      switch (types_[k]) {
+        case AttributeType::INTEGER: {
+          for (size_t i = 0; i < input.count_; ++i) {
+            StoreBigEndian(std::get<size_t>(col.GetValue(sel[i])), key + i * stride);
+          }
+          break;
+        }
+        case AttributeType::DOUBLE: {
+          for (size_t i = 0; i < input.count_; ++i) {
+            StoreBigEndian(EncodeDouble(std::get<double>(col.GetValue(sel[i]))), key + i * stride);
+          }
+          break;
+        }
+        case AttributeType::STRING: {
+          for (size_t i = 0; i < input.count_; ++i) {
+            auto &str = std::get<string>(col.GetValue(sel[i]));
+            size_t n = std::min(str.size(), kStringPrefix);
+            std::memcpy(key + i * stride, str.data(), n);
+            std::memset(key + i * stride + n, 0, kStringPrefix - n);
+          }
+          break;
+        }
+        case AttributeType::INVALID: break;
+      }
+      if (order_by_[k].desc_) {
+        size_t n_bytes = types_[k] == AttributeType::STRING ? kStringPrefix : sizeof(uint64_t);
+        for (size_t i = 0; i < input.count_; ++i) {
+          for (size_t b = 0; b < n_bytes; ++b) key[i * stride + b] = ~key[i * stride + b];
+        }
+      }
+    }
+  }
+
+  // Compares two tuples by their keys, and a string whose prefix is the same in both by its full value, before the
+  // columns after it. [left] and [right] return the value of a column of the tuples.
+  template<class Left, class Right>
+  inline int Compare(const uint8_t *left_key, const Left &left, const uint8_t *right_key, const Right &right) const {
+    size_t start = 0;
+    for (size_t k = 0; has_strings_ && k < order_by_.size(); ++k) {
+      if (types_[k] != AttributeType::STRING) continue;
+      size_t end = offsets_[k] + kStringPrefix;
+      int cmp = std::memcmp(left_key + start, right_key + start, end - start);
+      if (cmp != 0) return cmp;
+      cmp = std::get<string>(left(order_by_[k].col_id_)).compare(std::get<string>(right(order_by_[k].col_id_)));
+      if (cmp != 0) return order_by_[k].desc_ ? -cmp : cmp;
+      start = end;
+    }
+    return std::memcmp(left_key + start, right_key + start, width_ - start);
+  }
+
+  inline bool HasStrings() const { return has_strings_; }
+
+ private:
+  vector<SortSpec> order_by_;
+  vector<AttributeType> types_;
+  vector<size_t> offsets_;
+  size_t width_ = 0;
+  size_t prefix_width_ = 0;
+  bool has_strings_ = false;
+
+  static inline void StoreBigEndian(uint64_t value, uint8_t *out) {
+    value = __builtin_bswap64(value);
+    std::memcpy(out, &value, sizeof(value));
+  }
+
+  static inline uint64_t EncodeDouble(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits ^ (uint64_t(1) << 63);
+  }
+};
+
+// A sink that orders its input. The result is ready when all pipelines are finalized.
+class SortedSink : public PhysicalSink {
+ public:
+  // Appends the sorted tuples to [result].
+  virtual void Fetch(DataCollection &result) = 0;
+
+  // Shows the number of tuples and the first [n_tuple] tuples.
+  inline void Print(size_t n_tuple) {
+    DataCollection result(types_);
+    Fetch(result);
+    std::cout << "Number of tuples in the sorted result: " << result.NumTuples() << "\n";
+    result.Print(n_tuple);
+  }
+
+ protected:
+  explicit SortedSink(const vector<AttributeType> &types) : types_(types) {}
+
+  vector<AttributeType> types_;
+};
+
+// ORDER BY ... LIMIT [limit]: keeps the first [limit] tuples in a bounded max-heap, whose top is the current limit-th
+// key. Each chunk is normalized, and the prefixes of the keys are checked against the top in a tight loop, so that
+// only the tuples that may enter the heap are materialized. Each pipeline keeps its own heap, and the heaps are merged
+// when the pipelines are finalized.
+class PhysicalTopN : public SortedSink {
+ public:
+  PhysicalTopN(const vector<AttributeType> &input_types, const vector<SortSpec> &order_by, size_t limit)
+      : SortedSink(input_types), layout_(input_types, order_by), limit_(limit),
+        normalize_id_(BeeProfiler::Get().Register("[TopN - Normalize]")),
+        filter_id_(BeeProfiler::Get().Register("[TopN - Filter]")),
+        heap_id_(BeeProfiler::Get().Register("[TopN - Heap]")),
+        merge_id_(BeeProfiler::Get().Register("[TopN - Merge]")),
+        hist_id_(ZebraProfiler::Get().Register("[TopN]")) {
+    if (limit_ == 0) throw std::runtime_error("The limit must be positive");
+  }
+
+  struct Entry {
+    vector<uint8_t> key_;
+    vector<Attribute> tuple_;
+  };
+
+  struct TopNState : public OperatorState {
+    vector<Entry> heap_;
+    vector<uint8_t> keys_;
+    vector<uint32_t> candidates_ = vector<uint32_t>(kBlockSize);
+    RegionProfiler profiler_;
+
+    explicit TopNState(size_t width) : keys_(kBlockSize * width) {}
+  };
+
+  unique_ptr<OperatorState> GetState() const override { return std::make_unique<TopNState>(layout_.Width()); }
+
+  void Sink(DataChunk &input, OperatorState &state) override {
+    auto &local = static_cast<TopNState &>(state);
+    auto &profiler = local.profiler_;
+    size_t width = layout_.Width(), prefix = layout_.PrefixWidth();
+
+    profiler.Start();
+    layout_.Normalize(input, local.keys_.data(), width);
+    double time = profiler.Record(normalize_id_);
+
+    // the tuples that are not after the top of a full heap
+    profiler.Start();
+    size_t n_candidate = 0;
+    auto &candidates = local.candidates_;
+    if (local.heap_.size() < limit_) {
+      for (size_t i = 0; i < input.count_; ++i) candidates[i] = i;
+      n_candidate = input.count_;
+    } else {
+      const uint8_t *top = local.heap_.front().key_.data();
+      const uint8_t *keys = local.keys_.data();
+      for (size_t i = 0; i < input.count_; ++i) {
+        candidates[n_candidate] = i;
+        n_candidate += std::memcmp(keys + i * width, top, prefix) <= 0;
+      }
+    }
+    time += profiler.Record(filter_id_);
+
+    profiler.Start();
+    size_t values = 0;
+    for (size_t c = 0; c < n_candidate; ++c) {
+      size_t i = candidates[c];
+      const uint8_t *key = local.keys_.data() + i * width;
+      if (local.heap_.size() == limit_ && std::memcmp(key, local.heap_.front().key_.data(), prefix) > 0) continue;
+      Entry entry{vector<uint8_t>(key, key + width), vector<Attribute>(input.data_.size())};
+      for (size_t j = 0; j < entry.tuple_.size(); ++j) {
+        auto &col = input.data_[j];
+        entry.tuple_[j] = col.GetValue(col.selection_vector_[i]);
+      }
+      values += entry.tuple_.size();
+      Push(local.heap_, std::move(entry));
+    }
+    CopyCounters::Local().values_ += values;
+    time += profiler.Record(heap_id_);
+    ZebraProfiler::Get().InsertRecord(hist_id_, input.count_, n_candidate, time);
+  }
+
+  void Finalize(OperatorState &state) override {
+    auto &local = static_cast<TopNState &>(state);
+    lock_guard<mutex> lock(mutex_);
+    local.profiler_.Start();
+    for (auto &entry : local.heap_) Push(heap_, std::move(entry));
+    local.heap_.clear();
+    local.profiler_.Record(merge_id_);
+  }
+
+  void Fetch(DataCollection &result) override {
+    auto sorted = heap_;
+    std::sort_heap(sorted.begin(), sorted.end(), Less{layout_});
+    for (auto &entry : sorted) result.AppendTuple(entry.tuple_);
+  }
+
+ private:
+  SortKeyLayout layout_;
+  size_t limit_;
+  // the first [limit_] tuples of the finalized pipelines
+  vector<Entry> heap_;
+  mutex mutex_;
+
+  // profiling records
+  const idx_t normalize_id_;
+  const idx_t filter_id_;
+  const idx_t heap_id_;
+  const idx_t merge_id_;
+  const idx_t hist_id_;
+
+  struct Less {
+    const SortKeyLayout &layout_;
+
+    inline bool operator()(const Entry &left, const Entry &right) const {
+      auto left_value = [&](size_t col_id) -> const Attribute & { return left.tuple_[col_id]; };
+      auto right_value = [&](size_t col_id) -> const Attribute & { return right.tuple_[col_id]; };
+      return layout_.Compare(left.key_.data(), left_value, right.key_.data(), right_value) < 0;
+    }
+  };
+
+  // Adds [entry] to the max-heap, and drops the last tuple if there are more than [limit_].
+  inline void Push(vector<Entry> &heap, Entry entry) const {
+    Less less{layout_};
+    if (heap.size() == limit_) {
+      if (!less(entry, heap.front())) return;
+      std::pop_heap(heap.begin(), heap.end(), less);
+      heap.back() = std::move(entry);
+    } else {
+      heap.push_back(std::move(entry));
+    }
+    std::push_heap(heap.begin(), heap.end(), less);
+  }
+};
+
+// ORDER BY: materializes the tuples, and sorts their normalized keys with an LSD radix sort. A key is stored with the
+// index of its tuple. Each pipeline sorts its own tuples when it is finalized, and the sorted runs are merged.
+class PhysicalOrder : public SortedSink {
+ public:
+  PhysicalOrder(const vector<AttributeType> &input_types, const vector<SortSpec> &order_by)
+      : SortedSink(input_types), layout_(input_types, order_by), stride_(layout_.Width() + sizeof(uint64_t)),
+        rows_(input_types),
+        normalize_id_(BeeProfiler::Get().Register("[Sort - Normalize]")),
+        materialize_id_(BeeProfiler::Get().Register("[Sort - Materialize]")),
+        sort_id_(BeeProfiler::Get().Register("[Sort - Radix Sort]")),
+        merge_id_(BeeProfiler::Get().Register("[Sort - Merge]")),
+        hist_id_(ZebraProfiler::Get().Register("[Sort]")) {}
+
+  struct OrderState : public OperatorState {
+    DataCollection rows_;
+    // the keys, each followed by the index of its tuple in [rows_]
+    vector<uint8_t> entries_;
+    RegionProfiler profiler_;
+
+    explicit OrderState(const vector<AttributeType> &types) : rows_(types) {}
+  };
+
+  unique_ptr<OperatorState> GetState() const override { return std::make_unique<OrderState>(types_); }
+
+  void Sink(DataChunk &input, OperatorState &state) override {
+    auto &local = static_cast<OrderState &>(state);
+    auto &profiler = local.profiler_;
+
+    profiler.Start();
+    size_t offset = local.entries_.size();
+    size_t row = local.rows_.NumTuples();
+    local.entries_.resize(offset + input.count_ * stride_);
+    uint8_t *entries = local.entries_.data() + offset;
+    layout_.Normalize(input, entries, stride_);
+    for (size_t i = 0; i < input.count_; ++i) {
+      uint64_t idx = row + i;
+      std::memcpy(entries + i * stride_ + layout_.Width(), &idx, sizeof(idx));
+    }
+    double time = profiler.Record(normalize_id_);
+
+    profiler.Start();
+    local.rows_.AppendChunk(input);
+    time += profiler.Record(materialize_id_);
+    ZebraProfiler::Get().InsertSinkRecord(hist_id_, input.count_, time);
+  }
+
+  void Finalize(OperatorState &state) override {
+    auto &local = static_cast<OrderState &>(state);
+    auto &profiler = local.profiler_;
+
+    profiler.Start();
+    RadixSort(local.entries_);
+    SortTies(local.entries_, local.rows_);
+    profiler.Record(sort_id_);
+
+    lock_guard<mutex> lock(mutex_);
+    profiler.Start();
+    Merge(local.entries_, local.rows_);
+    profiler.Record(merge_id_);
+  }
+
+  void Fetch(DataCollection &result) override {
+    vector<Attribute> tuple;
+    for (size_t e = 0; e < entries_.size(); e += stride_) {
+      rows_.FetchTuple(Row(entries_.data() + e), tuple);
+      result.AppendTuple(tuple);
+    }
+  }
+
+ private:
+  SortKeyLayout layout_;
+  // the bytes of an entry: the key and the index of its tuple
+  size_t stride_;
+  // the tuples of the finalized pipelines, and their entries in order
+  DataCollection rows_;
+  vector<uint8_t> entries_;
+  mutex mutex_;
+
+  // profiling records
+  const idx_t normalize_id_;
+  const idx_t materialize_id_;
+  const idx_t sort_id_;
+  const idx_t merge_id_;
+  const idx_t hist_id_;
+
+  // the values of the tuple [row] of [rows], by column
+  static inline auto Values(DataCollection &rows, uint64_t row) {
+    return [&rows, row](size_t col_id) -> const Attribute & { return rows.GetValue(row, col_id); };
+  }
+
+  inline uint64_t Row(const uint8_t *entry) const {
+    uint64_t row;
+    std::memcpy(&row, entry + layout_.Width(), sizeof(row));
+    return row;
+  }
+
+  // Sorts the entries on the prefixes of their keys, from the last byte to the first. A byte that is the same in all
+  // entries (e.g., the high bytes of small integers) is skipped.
+  inline void RadixSort(vector<uint8_t> &entries) const {
+    size_t n = entries.size() / stride_;
+    if (n < 2) return;
+    vector<uint8_t> temp(entries.size());
+    for (size_t b = layout_.PrefixWidth(); b-- > 0;) {
+      size_t offsets[256] = {0};
+      for (size_t i = 0; i < n; ++i) offsets[entries[i * stride_ + b]]++;
+      if (offsets[entries[b]] == n) continue;
+
+      size_t sum = 0;
+      for (auto &offset : offsets) {
+        size_t count = offset;
+        offset = sum;
+        sum += count;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        const uint8_t *entry = entries.data() + i * stride_;
+        std::memcpy(temp.data() + offsets[entry[b]]++ * stride_, entry, stride_);
+      }
+      entries.swap(temp);
+    }
+  }
+
+  // Orders the runs of entries with the same prefix by the rest of their keys, comparing the strings in full.
+  inline void SortTies(vector<uint8_t> &entries, DataCollection &rows) const {
+    if (!layout_.HasStrings()) return;
+    size_t n = entries.size() / stride_, prefix = layout_.PrefixWidth();
+    vector<const uint8_t *> run;
+    vector<uint8_t> sorted;
+    for (size_t start = 0, end; start < n; start = end) {
+      for (end = start + 1; end < n; ++end) {
+        if (std::memcmp(entries.data() + start * stride_, entries.data() + end * stride_, prefix) != 0) break;
+      }
+      if (end - start < 2) continue;
+      run.clear();
+      for (size_t i = start; i < end; ++i) run.push_back(entries.data() + i * stride_);
+      std::sort(run.begin(), run.end(), [&](const uint8_t *left, const uint8_t *right) {
+        return layout_.Compare(left, Values(rows, Row(left)), right, Values(rows, Row(right))) < 0;
+      });
+      sorted.resize(run.size() * stride_);
+      for (size_t i = 0; i < run.size(); ++i) std::memcpy(sorted.data() + i * stride_, run[i], stride_);
+      std::memcpy(entries.data() + start * stride_, sorted.data(), sorted.size());
+    }
+  }
+
+  // Merges the sorted entries of a pipeline into the sorted entries of the finalized pipelines, and moves its tuples.
+  inline void Merge(vector<uint8_t> &entries, DataCollection &rows) {
+    uint64_t base = rows_.NumTuples();
+    vector<uint8_t> merged(entries_.size() + entries.size());
+    size_t l = 0, r = 0, m = 0;
+    while (l < entries_.size() || r < entries.size()) {
+      bool left = r == entries.size();
+      if (!left && l < entries_.size()) {
+        const uint8_t *left_entry = entries_.data() + l, *right_entry = entries.data() + r;
+        left = layout_.Compare(left_entry, Values(rows_, Row(left_entry)),
+                               right_entry, Values(rows, Row(right_entry))) <= 0;
+      }
+      if (left) {
+        std::memcpy(merged.data() + m, entries_.data() + l, stride_);
+        l += stride_;
+      } else {
+        std::memcpy(merged.data() + m, entries.data() + r, stride_);
+        uint64_t row = Row(entries.data() + r) + base;
+        std::memcpy(merged.data() + m + layout_.Width(), &row, sizeof(row));
+        r += stride_;
+      }
+      m += stride_;
+    }
+    entries_.swap(merged);
+    entries.clear();
+    rows_.Merge(rows);
+  }
+};
+
+// the Top-N sink if [limit] is positive, else the full sort
+inline unique_ptr<SortedSink> CreateSortedSink(const vector<AttributeType> &input_types,
+                                               const vector<SortSpec> &order_by, size_t limit) {
+  if (limit > 0) return std::make_unique<PhysicalTopN>(input_types, order_by, limit);
+  return std::make_unique<PhysicalOrder>(input_types, order_by);
+}
+}
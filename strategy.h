@@ -0,0 +1,90 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// strategy.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <sstream>
+#include <type_traits>
+
+#include "base.h"
+
+namespace compaction {
+
+// The compactor that sits after each operator.
+enum class CompactType : uint8_t {
+  NONE = 0,
+  FULL = 1,
+  DYNAMIC = 2
+};
+
+// A compaction strategy: whether the join compacts its results logically (ScanStructure::Next), and which compactor
+// sits after each operator.
+struct Strategy {
+  bool logical_;
+  CompactType compact_;
+
+  // none, logical, full, dynamic, logical+full, logical+dynamic
+  inline string Name() const {
+    static const char *compact_names[] = {"none", "full", "dynamic"};
+    if (compact_ == CompactType::NONE) return logical_ ? "logical" : "none";
+    return string(logical_ ? "logical+" : "") + compact_names[uint8_t(compact_)];
+  }
+
+  static inline Strategy Parse(const string &name) {
+    Strategy strategy{false, CompactType::NONE};
+    std::stringstream ss(name);
+    string part;
+    while (std::getline(ss, part, '+')) {
+      if (part == "logical") strategy.logical_ = true;
+      else if (part == "full") strategy.compact_ = CompactType::FULL;
+      else if (part == "dynamic") strategy.compact_ = CompactType::DYNAMIC;
+      else if (part != "none") throw std::runtime_error("Unknown strategy: " + name);
+    }
+    return strategy;
+  }
+
+  // a comma-separated list of strategies, e.g., "logical,logical+dynamic"
+  static inline vector<Strategy> ParseList(const string &names) {
+    vector<Strategy> strategies;
+    std::stringstream ss(names);
+    string name;
+    while (std::getline(ss, name, ',')) strategies.push_back(Parse(name));
+    if (strategies.empty()) throw std::runtime_error("No strategy given");
+    return strategies;
+  }
+};
+
+// The part of the signature of a compactor (CompactTuner) that the strategy and the settings decide rather than the
+// operators: whether the joins compact logically, and the block size. Both change the chunk sizes the tuner learns on.
+inline string StrategySignature(bool logical) {
+  return string(logical ? "logical" : "physical") + "|block-" + std::to_string(kBlockSize);
+}
+
+// Calls f(std::integral_constant<bool, logical>, std::integral_constant<CompactType, compact>) with the strategy as
+// compile-time constants. The pipeline is compiled for the strategy (Pipeline<kCompact>), so the chunks do not test
+// it: the pipelines without compaction have no compactor code, and the others call their compactors directly. The
+// chunks only pay the virtual calls of the operators.
+template<class F>
+inline void DispatchStrategy(const Strategy &strategy, F &&f) {
+  auto dispatch = [&](auto compact) {
+    if (strategy.logical_) f(std::true_type{}, compact);
+    else f(std::false_type{}, compact);
+  };
+  switch (strategy.compact_) {
+    case CompactType::NONE:
+      dispatch(std::integral_constant<CompactType, CompactType::NONE>{});
+      break;
+    case CompactType::FULL:
+      dispatch(std::integral_constant<CompactType, CompactType::FULL>{});
+      break;
+    case CompactType::DYNAMIC:
+      dispatch(std::integral_constant<CompactType, CompactType::DYNAMIC>{});
+      break;
+  }
+}
+}
@@ -0,0 +1,169 @@
+#!/bin/bash
+
+# Run a pipeline over a grid of parameters, and append the results to a CSV store.
+# Usage: bash ./sweep.sh [options]
+#   e.g. bash ./sweep.sh --joins "2 4" --chunk-factor "1 8" --payload "[0,0,0,0] [0,1000,0,0]" --repetitions 5
+#
+# Each line of the store is one metric of one run: the total time, and the total time, calls and tuples of each
+# profiled operator in the BeeProfiler output (summed over the instances of an operator). The strategies of a point run
+# one after another in the same process (--strategy), on the same data. With --baseline, the median of
+# each metric is compared with the baseline store, and the script exits with 1 if any metric regressed.
+
+pipeline=filter_and_join
+executable=""
+strategies="logical logical+dynamic"
+joins="4"
+chunk_factors="8"
+selectivities="0.2"
+payloads="[0,1000,0,0]"
+block_sizes="2048"
+lhs_size=2000000
+rhs_size=200000
+repetitions=3
+output=results.csv
+baseline=""
+tolerance=0.1
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --pipeline) pipeline="$2"; shift ;;
+        --executable) executable="$2"; shift ;;
+        --strategy) strategies="$2"; shift ;;
+        --joins) joins="$2"; shift ;;
+        --chunk-factor) chunk_factors="$2"; shift ;;
+        --selectivity) selectivities="$2"; shift ;;
+        --payload) payloads="$2"; shift ;;
+        --block-size) block_sizes="$2"; shift ;;
+        --lhs-size) lhs_size="$2"; shift ;;
+        --rhs-size) rhs_size="$2"; shift ;;
+        --repetitions) repetitions="$2"; shift ;;
+        --output) output="$2"; shift ;;
+        --baseline) baseline="$2"; shift ;;
+        --tolerance) tolerance="$2"; shift ;;
+        *)
+            echo "Usage: bash ./sweep.sh [options]"
+            echo "  --pipeline [name]        compaction or filter_and_join (default)"
+            echo "  --executable [path]      The executable of the pipeline (default: ./build/[pipeline])"
+            echo "  --strategy [list]        Strategies of --strategy, e.g. \"logical logical+full logical+dynamic\""
+            echo "  --joins [list]           Numbers of joins"
+            echo "  --chunk-factor [list]    Chunk factors"
+            echo "  --selectivity [list]     Filter selectivities (filter_and_join only)"
+            echo "  --payload [list]         Payload length lists, one per point, e.g. \"[0,0,0,0] [0,1000,0,0]\""
+            echo "  --block-size [list]      Block sizes"
+            echo "  --lhs-size [value]       Size of LHS tuples"
+            echo "  --rhs-size [value]       Size of RHS tuples"
+            echo "  --repetitions [value]    Runs per point"
+            echo "  --output [path]          The CSV store to append to (default: results.csv)"
+            echo "  --baseline [path]        Flag the metrics whose median regressed against this store"
+            echo "  --tolerance [value]      Relative slowdown that counts as a regression (default: 0.1)"
+            exit 1 ;;
+    esac
+    shift
+done
+
+run_id=$(date +%Y%m%d-%H%M%S)
+revision=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+if [ ! -f "${output}" ]; then
+    echo "run_id,revision,pipeline,strategy,joins,chunk_factor,selectivity,payload,block_size,repetition,metric,value" > "${output}"
+fi
+
+# Print the metrics of one run as "[head],strategy,[tail],metric,value" lines, for each strategy of the run.
+parse_output() {
+    awk -v head="$1" -v tail="$2" '
+        function report(    k) {
+            for (k in order) print head","strategy","tail","k","(k in sum ? sum[k] : cnt[k])
+            delete sum; delete cnt; delete order
+        }
+        /^-+ Strategy: / { report(); strategy = $3; next }
+        /^\[Total Time\]:/ { sub(/s$/, "", $3); print head","strategy","tail",[Total Time],"$3; next }
+        /^Total: / {
+            # Total: <value> [s]\tCalls: <n>\tAvg: <avg> [s]\t<key> [0x<address>]
+            n = split($0, fields, "\t")
+            key = fields[n]
+            sub(/ 0x[0-9a-f]+$/, "", key)
+            gsub(/,/, ";", key)
+            split(fields[1], total, " ")
+            split(fields[2], calls, " ")
+            unit = (fields[1] ~ / s$/) ? "time" : "tuples"
+            sum[key" "unit] += total[2]
+            cnt[key" calls"] += calls[2]
+            order[key" "unit] = 1
+            order[key" calls"] = 1
+        }
+        END { report() }
+    '
+}
+
+if [ -z "${executable}" ]; then
+    executable=./build/${pipeline}
+fi
+if [ ! -f "${executable}" ]; then
+    echo "Please build the executables first: bash ./build_versions.sh (missing ${executable})"
+    exit 1
+fi
+strategy_list=$(echo ${strategies} | tr ' ' ',')
+
+for n_join in ${joins}; do
+    for chunk_factor in ${chunk_factors}; do
+        for selectivity in ${selectivities}; do
+            for payload in ${payloads}; do
+                n_payload=$(echo "${payload}" | tr -d '[]' | tr ',' '\n' | wc -l)
+                if [ "${n_payload}" -lt "${n_join}" ]; then
+                    echo "Skip ${payload}: fewer payload lengths than ${n_join} joins" >&2
+                    continue
+                fi
+                for block_size in ${block_sizes}; do
+                    args=(--strategy "${strategy_list}" --join-num "${n_join}" --chunk-factor "${chunk_factor}"
+                          --lhs-size "${lhs_size}" --rhs-size "${rhs_size}" --block-size "${block_size}"
+                          --payload-length="${payload}")
+                    if [ "${pipeline}" == "filter_and_join" ]; then
+                        args+=(--selectivity "${selectivity}")
+                    fi
+                    # the payload list is stored with ';' so that it stays one CSV field
+                    head="${run_id},${revision},${pipeline}"
+                    tail="${n_join},${chunk_factor},${selectivity},$(echo "${payload}" | tr ',' ';'),${block_size}"
+                    echo "${args[*]}" >&2
+                    for ((r = 0; r < repetitions; r++)); do
+                        "${executable}" "${args[@]}" 2>&1 >/dev/null | parse_output "${head}" "${tail},${r}" >> "${output}"
+                    done
+                done
+            done
+        done
+    done
+done
+
+if [ -z "${baseline}" ]; then
+    exit 0
+fi
+
+# Compare the medians of this run with the medians of the baseline, per configuration and time metric.
+awk -F, -v run_id="${run_id}" -v tolerance="${tolerance}" '
+    function median(values, n,    i, j, t) {
+        for (i = 2; i <= n; i++) {
+            for (j = i; j > 1 && values[j - 1] > values[j]; j--) { t = values[j]; values[j] = values[j - 1]; values[j - 1] = t }
+        }
+        return n % 2 ? values[(n + 1) / 2] : (values[n / 2] + values[n / 2 + 1]) / 2
+    }
+    FNR == 1 { file++; next }
+    $11 !~ /time$|^\[Total Time\]$/ { next }
+    file == 2 && $1 != run_id { next }
+    {
+        key = $3","$4","$5","$6","$7","$8","$9","$11
+        if (file == 1) { base[key, ++n_base[key]] = $12 } else { curr[key, ++n_curr[key]] = $12 }
+    }
+    END {
+        n_regression = 0
+        for (key in n_curr) {
+            if (!(key in n_base)) continue
+            delete values; for (i = 1; i <= n_base[key]; i++) values[i] = base[key, i]; b = median(values, n_base[key])
+            delete values; for (i = 1; i <= n_curr[key]; i++) values[i] = curr[key, i]; c = median(values, n_curr[key])
+            if (b > 0 && c > b * (1 + tolerance)) {
+                printf "[Regression] %s: %g -> %g (+%.1f%%)\n", key, b, c, (c / b - 1) * 100
+                n_regression++
+            }
+        }
+        print "Regressions: " n_regression
+        exit n_regression > 0
+    }
+' "${baseline}" "${output}"
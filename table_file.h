@@ -0,0 +1,308 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// table_file.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstring>
+#include <fstream>
+
+#include "base.h"
+#include "csv_reader.h"
+#include "data_collection.h"
+#include "generator.h"
+#include "mapped_file.h"
+
+namespace compaction {
+
+// A table file stores a table column by column, in segments of up to block_size tuples:
+//
+//   FileHeader | ColumnHeader x n_cols | segment 0 | segment 1 | ... | SegmentEntry x n_segments
+//
+// A segment starts at a page boundary, so that it can be read ahead on its own, and holds its columns one after
+// another, each 8-byte aligned: an INTEGER column is uint64_t[count], a DOUBLE column double[count], and a STRING
+// column uint32_t[count + 1] offsets into the characters that follow them. The directory of the segments is at the
+// end, since the size of a segment is only known once it is written. WriteTable fills every segment but the last;
+// the file sink (result_sink.h) writes the segments of several pipelines, so any of them can be partial.
+namespace table_file {
+constexpr char kMagic[8] = {'C', 'M', 'P', 'T', 'A', 'B', 'L', 'E'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kPageSize = 4096;
+
+struct FileHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t n_cols_;
+  uint64_t n_tuples_;
+  uint64_t block_size_;
+  uint64_t n_segments_;
+  // the offset of the SegmentEntry array
+  uint64_t directory_offset_;
+};
+
+struct ColumnHeader {
+  uint8_t type_;
+  uint8_t reserved_[7];
+  // the bytes of the column in all segments
+  uint64_t bytes_;
+};
+
+struct SegmentEntry {
+  uint64_t offset_;
+  uint64_t bytes_;
+  uint64_t count_;
+};
+
+inline size_t Align(size_t offset, size_t alignment) { return (offset + alignment - 1) / alignment * alignment; }
+}
+
+// Writes [table] to the table file [path], a segment of kBlockSize tuples at a time.
+inline void WriteTable(DataCollection &table, const string &path) {
+  using namespace table_file;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) throw std::runtime_error("Cannot create the table file: " + path);
+  auto &types = table.Types();
+  size_t n_tuples = table.NumTuples();
+  size_t n_segments = (n_tuples + kBlockSize - 1) / kBlockSize;
+
+  FileHeader header{};
+  std::memcpy(header.magic_, kMagic, sizeof(kMagic));
+  header.version_ = kVersion;
+  header.n_cols_ = types.size();
+  header.n_tuples_ = n_tuples;
+  header.block_size_ = kBlockSize;
+  header.n_segments_ = n_segments;
+  vector<ColumnHeader> columns(types.size());
+  for (size_t c = 0; c < types.size(); ++c) columns[c].type_ = uint8_t(types[c]);
+
+  // Leave room for the headers, and write them at the end.
+  size_t offset = Align(sizeof(FileHeader) + columns.size() * sizeof(ColumnHeader), kPageSize);
+  vector<SegmentEntry> directory(n_segments);
+  DataChunk chunk(types);
+  vector<char> buffer;
+  for (size_t s = 0; s < n_segments; ++s) {
+    size_t start = s * kBlockSize;
+    table.ScanChunk(start, std::min(start + kBlockSize, n_tuples), chunk);
+
+    // encode the columns of the segment one after another
+    buffer.clear();
+    for (size_t c = 0; c < types.size(); ++c) {
+      auto &col = chunk.data_[c];
+      size_t col_start = buffer.size();
+      if (types[c] == AttributeType::STRING) {
+        vector<uint32_t> offsets(chunk.count_ + 1, 0);
+        string chars;
+        for (size_t i = 0; i < chunk.count_; ++i) {
+          chars += std::get<string>(col.GetValue(col.selection_vector_[i]));
+          offsets[i + 1] = chars.size();
+        }
+        buffer.resize(col_start + offsets.size() * sizeof(uint32_t) + chars.size());
+        std::memcpy(buffer.data() + col_start, offsets.data(), offsets.size() * sizeof(uint32_t));
+        std::memcpy(buffer.data() + col_start + offsets.size() * sizeof(uint32_t), chars.data(), chars.size());
+      } else {
+        buffer.resize(col_start + chunk.count_ * sizeof(uint64_t));
+        auto *values = buffer.data() + col_start;
+        for (size_t i = 0; i < chunk.count_; ++i) {
+          auto &value = col.GetValue(col.selection_vector_[i]);
+          if (types[c] == AttributeType::INTEGER) std::memcpy(values + i * 8, &std::get<size_t>(value), 8);
+          else std::memcpy(values + i * 8, &std::get<double>(value), 8);
+        }
+      }
+      buffer.resize(Align(buffer.size(), 8));
+      columns[c].bytes_ += buffer.size() - col_start;
+    }
+
+    directory[s] = {offset, buffer.size(), chunk.count_};
+    out.seekp(offset);
+    out.write(buffer.data(), buffer.size());
+    offset = Align(offset + buffer.size(), kPageSize);
+  }
+
+  header.directory_offset_ = offset;
+  out.seekp(offset);
+  out.write(reinterpret_cast<const char *>(directory.data()), directory.size() * sizeof(SegmentEntry));
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(columns.data()), columns.size() * sizeof(ColumnHeader));
+  if (!out) throw std::runtime_error("Cannot write the table file: " + path);
+}
+
+// A table file mapped into memory. A scan decodes the columns of a segment from the mapped pages into the chunk, and
+// asks the kernel to read the segments ahead of it. Several threads can scan it at the same time.
+class MappedTable final : public Table {
+ public:
+  // the number of segments that a scan reads ahead
+  static constexpr size_t kReadAhead = 16;
+
+  explicit MappedTable(const string &path) : path_(path), file_(path) {
+    using namespace table_file;
+    // The morsels are claimed in order, so the file is read about sequentially.
+    file_.Advise(0, file_.Size(), MADV_SEQUENTIAL);
+
+    auto *data = file_.Data();
+    if (file_.Size() < sizeof(FileHeader)) throw std::runtime_error("Not a table file: " + path);
+    auto &header = *reinterpret_cast<const FileHeader *>(data);
+    if (std::memcmp(header.magic_, kMagic, sizeof(kMagic)) != 0 || header.version_ != kVersion ||
+        header.block_size_ > kBlockSize || header.block_size_ == 0) {
+      throw std::runtime_error("Not a table file, or written with a larger block size: " + path);
+    }
+    // The header is not trusted: the column headers and the directory have to be in the file (the directory of an
+    // empty table is empty, and its offset can be past the end of the file), and the types have to be known.
+    size_t size = file_.Size();
+    if (header.n_cols_ > (size - sizeof(FileHeader)) / sizeof(ColumnHeader) ||
+        header.n_segments_ > size / sizeof(SegmentEntry) ||
+        (header.n_segments_ > 0 && (header.directory_offset_ > size ||
+            header.n_segments_ * sizeof(SegmentEntry) > size - header.directory_offset_))) {
+      throw std::runtime_error("Corrupt table file: " + path);
+    }
+    n_tuples_ = header.n_tuples_;
+    block_size_ = header.block_size_;
+    auto *columns = reinterpret_cast<const ColumnHeader *>(data + sizeof(FileHeader));
+    for (size_t c = 0; c < header.n_cols_; ++c) {
+      if (columns[c].type_ > uint8_t(AttributeType::STRING)) throw std::runtime_error("Corrupt table file: " + path);
+      types_.push_back(AttributeType(columns[c].type_));
+    }
+    directory_ = reinterpret_cast<const SegmentEntry *>(data + header.directory_offset_);
+    n_segments_ = header.n_segments_;
+    first_tuple_.resize(n_segments_ + 1, 0);
+    for (size_t s = 0; s < n_segments_; ++s) {
+      auto &entry = directory_[s];
+      if (entry.count_ > block_size_ || entry.offset_ % 8 != 0 || entry.offset_ > size ||
+          entry.bytes_ > size - entry.offset_ || !ValidSegment(s)) {
+        throw std::runtime_error("Corrupt table file: " + path);
+      }
+      first_tuple_[s + 1] = first_tuple_[s] + entry.count_;
+    }
+    if (first_tuple_[n_segments_] != n_tuples_) throw std::runtime_error("Corrupt table file: " + path);
+  }
+
+  inline size_t NumTuples() const override { return n_tuples_; }
+
+  inline const vector<AttributeType> &Types() const override { return types_; }
+
+  // The chunk gets its own storage if a previous chunk is still referenced downstream, e.g., by a compactor.
+  void ScanChunk(size_t start, size_t end, DataChunk &chunk) override {
+    assert(end - start <= kBlockSize && chunk.types_ == types_);
+    for (auto &col : chunk.data_) col.Prepare(end - start);
+    chunk.count_ = end - start;
+
+    // the segment of the tuple [start]: the segments are full, unless the file was written by the file sink
+    size_t s = start / block_size_;
+    if (s >= n_segments_ || first_tuple_[s] != s * block_size_ || first_tuple_[s + 1] <= start) {
+      s = std::upper_bound(first_tuple_.begin(), first_tuple_.end(), start) - first_tuple_.begin() - 1;
+    }
+    for (size_t idx = start; idx < end; ++s) {
+      size_t offset = idx - first_tuple_[s];
+      size_t n = std::min(end - idx, directory_[s].count_ - offset);
+      if (offset == 0 && s + kReadAhead < n_segments_) ReadAhead(s + kReadAhead);
+      DecodeSegment(s, offset, n, chunk, idx - start);
+      idx += n;
+    }
+  }
+
+  inline const string &Path() const { return path_; }
+
+ private:
+  string path_;
+  MappedFile file_;
+  vector<AttributeType> types_;
+  size_t n_tuples_ = 0;
+  size_t block_size_ = 0;
+  const table_file::SegmentEntry *directory_ = nullptr;
+  size_t n_segments_ = 0;
+  // the first tuple of each segment, and the number of tuples at the end
+  vector<size_t> first_tuple_;
+
+  inline void ReadAhead(size_t s) const {
+    file_.Advise(directory_[s].offset_, directory_[s].bytes_, MADV_WILLNEED);
+  }
+
+  // Whether the columns of the segment [s] fit in its bytes, and the strings in their characters, so that
+  // DecodeSegment does not read past the segment.
+  inline bool ValidSegment(size_t s) const {
+    using table_file::Align;
+    const char *col_data = file_.Data() + directory_[s].offset_;
+    size_t count = directory_[s].count_, left = directory_[s].bytes_;
+    for (auto type : types_) {
+      size_t bytes = count * sizeof(uint64_t);
+      if (type == AttributeType::STRING) {
+        size_t n_offsets = (count + 1) * sizeof(uint32_t);
+        if (n_offsets > left) return false;
+        auto *offsets = reinterpret_cast<const uint32_t *>(col_data);
+        for (size_t i = 0; i < count; ++i) {
+          if (offsets[i] > offsets[i + 1]) return false;
+        }
+        bytes = Align(n_offsets + offsets[count], 8);
+      }
+      if (bytes > left) return false;
+      col_data += bytes;
+      left -= bytes;
+    }
+    return true;
+  }
+
+  // Decodes the tuples [offset, offset + n) of the segment [s] into the chunk, from its tuple [chunk_offset] on.
+  inline void DecodeSegment(size_t s, size_t offset, size_t n, DataChunk &chunk, size_t chunk_offset) const {
+    using table_file::Align;
+    const char *col_data = file_.Data() + directory_[s].offset_;
+    size_t count = directory_[s].count_;
+    for (size_t c = 0; c < types_.size(); ++c) {
+      auto &col = chunk.data_[c];
+      if (types_[c] == AttributeType::STRING) {
+        auto *offsets = reinterpret_cast<const uint32_t *>(col_data);
+        const char *chars = col_data + (count + 1) * sizeof(uint32_t);
+        for (size_t i = 0; i < n; ++i) {
+          uint32_t begin = offsets[offset + i], end = offsets[offset + i + 1];
+          col.GetValue(chunk_offset + i).emplace<string>(chars + begin, end - begin);
+        }
+        col_data += Align((count + 1) * sizeof(uint32_t) + offsets[count], 8);
+      } else if (types_[c] == AttributeType::INTEGER) {
+        auto *values = reinterpret_cast<const uint64_t *>(col_data);
+        for (size_t i = 0; i < n; ++i) col.GetValue(chunk_offset + i) = size_t(values[offset + i]);
+        col_data += count * sizeof(uint64_t);
+      } else {
+        auto *values = reinterpret_cast<const double *>(col_data);
+        for (size_t i = 0; i < n; ++i) col.GetValue(chunk_offset + i) = values[offset + i];
+        col_data += count * sizeof(double);
+      }
+    }
+  }
+};
+
+// Whether [path] is a table file, rather than a CSV file.
+inline bool IsTableFile(const string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(table_file::kMagic)] = {};
+  in.read(magic, sizeof(magic));
+  return in && std::memcmp(magic, table_file::kMagic, sizeof(magic)) == 0;
+}
+
+// The probe table of a query with the columns [columns]: scanned from the table file [load_path], or loaded from it
+// if it is a CSV file with the delimiter [delimiter], if it is given. Or else generated. The table is written to the
+// table file [save_path] if it is given.
+inline unique_ptr<Table> CreateTable(const vector<ColumnSpec> &columns, size_t n_tuples, uint64_t seed,
+                                     const string &load_path, const string &save_path, char delimiter = ',') {
+  auto types = ColumnTypes(columns);
+  if (!load_path.empty() && IsTableFile(load_path)) {
+    auto table = std::make_unique<MappedTable>(load_path);
+    if (table->Types() != types) {
+      throw std::runtime_error("The columns of the table file do not match the query: " + load_path);
+    }
+    return table;
+  }
+
+  unique_ptr<DataCollection> table;
+  if (!load_path.empty()) {
+    table = ReadCSV(load_path, delimiter, types);
+  } else {
+    table = std::make_unique<DataCollection>(types);
+    GenerateTable(*table, columns, n_tuples, seed);
+  }
+  if (!save_path.empty()) WriteTable(*table, save_path);
+  return table;
+}
+}
@@ -0,0 +1,116 @@
+#include <fstream>
+
+#include "test.h"
+#include "../csv_reader.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+// the CSV file [name] with the text [contents]
+unique_ptr<TempFile> WriteFile(const string &name, const string &contents) {
+  auto file = std::make_unique<TempFile>(name);
+  std::ofstream out(file->Path(), std::ios::binary);
+  out << contents;
+  return file;
+}
+
+// Quoted fields can hold the delimiter and quotes, and "" is a quote.
+void Quoting() {
+  auto file = WriteFile("quoting.csv", "1,\"a,b\"\n"
+                                       "2,\"say \"\"hi\"\"\"\n"
+                                       "3,\"\"\n"
+                                       "4,plain\n"
+                                       "5,\"\"\"\"\n");
+  vector<AttributeType> types = {AttributeType::INTEGER, AttributeType::STRING};
+  auto table = ReadCSV(file->Path(), ',', types);
+  auto expected = MakeTable(types, {{size_t(1), string("a,b")}, {size_t(2), string("say \"hi\"")},
+                                    {size_t(3), string()}, {size_t(4), string("plain")}, {size_t(5), string("\"")}});
+  CHECK(Rows(*table) == Rows(*expected));
+}
+
+// The types are inferred from the rows after the header, and a header is skipped.
+void InferTypes() {
+  auto file = WriteFile("infer.csv", "id,price,name\n"
+                                     "1,2.5,x\n"
+                                     "2,3,\"y,z\"\n");
+  CSVReader reader(file->Path(), ',');
+  auto table = reader.Read();
+  vector<AttributeType> types = {AttributeType::INTEGER, AttributeType::DOUBLE, AttributeType::STRING};
+  CHECK(reader.Types() == types);
+  auto expected = MakeTable(types, {{size_t(1), 2.5, string("x")}, {size_t(2), 3.0, string("y,z")}});
+  CHECK(Rows(*table) == Rows(*expected));
+
+  // without a header, the first row is data, and its number makes the column a DOUBLE column
+  auto data = WriteFile("no_header.csv", "1,2.5,x\n2,3,y\n");
+  CSVReader data_reader(data->Path(), ',');
+  CHECK(data_reader.Read()->NumTuples() == 2);
+  CHECK(data_reader.Types() == types);
+}
+
+// A delimiter at the end of the row (as in dbgen), "\r\n", a missing line break, and blank lines at the end of the
+// file.
+void LineEnds() {
+  auto file = WriteFile("line_ends.tbl", "1|a|\r\n2|b|\n3|\"c|d\"|");
+  vector<AttributeType> types = {AttributeType::INTEGER, AttributeType::STRING};
+  auto table = ReadCSV(file->Path(), '|', types);
+  auto expected = MakeTable(types, {{size_t(1), string("a")}, {size_t(2), string("b")}, {size_t(3), string("c|d")}});
+  CHECK(Rows(*table) == Rows(*expected));
+
+  // blank lines at the end of the file are not rows
+  auto blank = WriteFile("blank_lines.csv", "1,a \n2,b\n\n \r\n\t\n");
+  table = ReadCSV(blank->Path(), ',', types);
+  expected = MakeTable(types, {{size_t(1), string("a ")}, {size_t(2), string("b")}});
+  CHECK(Rows(*table) == Rows(*expected));
+  auto only_blank = WriteFile("only_blank_lines.csv", "\n\n");
+  CHECK(ReadCSV(only_blank->Path(), ',', types)->NumTuples() == 0);
+}
+
+// A file of many segments and byte ranges is read in order, whatever the thread that parses a row.
+void ManySegments() {
+  size_t n_rows = 200000;
+  string contents;
+  for (size_t i = 0; i < n_rows; ++i) {
+    contents += std::to_string(i) + "," + (i % 3 == 0 ? "\"quoted,text\"" : "text") + "," + std::to_string(i * 0.5) +
+                "\n";
+  }
+  CHECK(contents.size() > 4 * CSVReader::kMinRangeBytes);
+  auto file = WriteFile("many.csv", contents);
+  auto table = ReadCSV(file->Path(), ',');
+  CHECK(table->NumTuples() == n_rows);
+  auto rows = Rows(*table);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    CHECK(std::get<size_t>(rows[i][0]) == i);
+    CHECK(std::get<string>(rows[i][1]) == (i % 3 == 0 ? "quoted,text" : "text"));
+    CHECK(std::get<double>(rows[i][2]) == i * 0.5);
+  }
+}
+
+// A row that does not match the columns is an error that names it.
+void Errors() {
+  vector<AttributeType> types = {AttributeType::INTEGER, AttributeType::STRING};
+  auto columns = WriteFile("columns.csv", "1,a\n2,b,c\n");
+  CHECK_THROWS(ReadCSV(columns->Path(), ',', types));
+  auto number = WriteFile("number.csv", "1,a\nx,b\n");
+  CHECK_THROWS(ReadCSV(number->Path(), ',', types));
+  auto quote = WriteFile("quote.csv", "1,\"a\n2,b\n");
+  CHECK_THROWS(ReadCSV(quote->Path(), ',', types));
+  auto after_quote = WriteFile("after_quote.csv", "1,\"a\"b\n");
+  CHECK_THROWS(ReadCSV(after_quote->Path(), ',', types));
+  auto header = WriteFile("header.csv", "id,name\n");
+  CHECK_THROWS(ReadCSV(header->Path(), ',', {AttributeType::INTEGER}));
+
+  try {
+    ReadCSV(number->Path(), ',', types);
+  } catch (std::runtime_error &e) {
+    CHECK(string(e.what()).find("row 1") != string::npos);
+  }
+}
+
+int main() {
+  TEST(Quoting);
+  TEST(InferTypes);
+  TEST(LineEnds);
+  TEST(ManySegments);
+  TEST(Errors);
+  return Result();
+}
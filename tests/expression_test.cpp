@@ -0,0 +1,125 @@
+#include <functional>
+
+#include "test.h"
+#include "../expression.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+const vector<AttributeType> kTypes = {AttributeType::INTEGER, AttributeType::DOUBLE, AttributeType::STRING};
+
+// Precedence, associativity and parentheses, as ToString shows them.
+void Parse() {
+  CHECK(Expression::Parse("#1 + 2 * #0")->ToString() == "(#1 + (2 * #0))");
+  CHECK(Expression::Parse("(#1 + 2) * #0")->ToString() == "((#1 + 2) * #0)");
+  CHECK(Expression::Parse("10 - 2 - 3")->ToString() == "((10 - 2) - 3)");
+  CHECK(Expression::Parse("#0 / 2 * 3")->ToString() == "((#0 / 2) * 3)");
+  CHECK(Expression::Parse("#0+1<=#1*2")->ToString() == "((#0 + 1) <= (#1 * 2))");
+  CHECK(Expression::Parse("CASE WHEN #0 != 1 THEN 2.5 ELSE CASE WHEN #1 > 0 THEN 1 ELSE 0 END END")->ToString() ==
+        "CASE WHEN (#0 != 1) THEN 2.5 ELSE CASE WHEN (#1 > 0) THEN 1 ELSE 0 END END");
+  CHECK(Expression::Parse("1 + CASE WHEN #0 = 1 THEN 2 ELSE 3 END")->ToString() ==
+        "(1 + CASE WHEN (#0 = 1) THEN 2 ELSE 3 END)");
+
+  auto list = Expression::ParseList("#0 * 2; #1 - 1;");
+  CHECK(list.size() == 2);
+  CHECK(list[1]->ToString() == "(#1 - 1)");
+
+  CHECK_THROWS(Expression::Parse(""));
+  CHECK_THROWS(Expression::Parse("#0 +"));
+  CHECK_THROWS(Expression::Parse("#0 2"));
+  CHECK_THROWS(Expression::Parse("(#0 + 1"));
+  CHECK_THROWS(Expression::Parse("CASE WHEN #0 THEN 1 END"));
+  CHECK_THROWS(Expression::Parse("CASEWHEN #0 THEN 1 ELSE 2 END"));
+  CHECK_THROWS(Expression::ParseList(" ; "));
+}
+
+// Integers stay integers, a double makes a double, and a comparison is an integer.
+void Bind() {
+  auto type = [](const string &text) {
+    auto expression = Expression::Parse(text);
+    expression->Bind(kTypes);
+    return expression->result_type_;
+  };
+  CHECK(type("#0 + 1") == AttributeType::INTEGER);
+  CHECK(type("#0 + 1.0") == AttributeType::DOUBLE);
+  CHECK(type("#0 * #1") == AttributeType::DOUBLE);
+  CHECK(type("#1 < #0") == AttributeType::INTEGER);
+  CHECK(type("CASE WHEN #1 < 1 THEN #0 ELSE 2 END") == AttributeType::INTEGER);
+  CHECK(type("CASE WHEN #1 < 1 THEN #0 ELSE #1 END") == AttributeType::DOUBLE);
+  CHECK_THROWS(type("#2 + 1"));
+  CHECK_THROWS(type("#3 + 1"));
+
+  // the nodes are numbered children first
+  auto expression = Expression::Parse("#0 + #1 * 2");
+  CHECK(expression->Bind(kTypes) == 5);
+  CHECK(expression->id_ == 4);
+}
+
+// The projection evaluates each expression for the selected tuples of a chunk, and appends it as a column.
+void Project() {
+  using Row = vector<Attribute>;
+  struct Case {
+    string text;
+    std::function<Attribute(size_t, double)> expected;
+  };
+  vector<Case> cases = {
+      {"#0 + 3", [](size_t a, double) { return Attribute(a + 3); }},
+      {"#0 * #0 - #0", [](size_t a, double) { return Attribute(a * a - a); }},
+      {"#0 / 7", [](size_t a, double) { return Attribute(a / 7); }},
+      {"#0 / (#0 - #0)", [](size_t, double) { return Attribute(size_t(0)); }},
+      {"#1 * 2 + #0", [](size_t a, double b) { return Attribute(b * 2 + double(a)); }},
+      {"#0 / 2.0", [](size_t a, double) { return Attribute(double(a) / 2.0); }},
+      {"#0 < 50", [](size_t a, double) { return Attribute(size_t(a < 50)); }},
+      {"#1 >= 10.5", [](size_t, double b) { return Attribute(size_t(b >= 10.5)); }},
+      {"#0 = 7", [](size_t a, double) { return Attribute(size_t(a == 7)); }},
+      {"#0 != 7", [](size_t a, double) { return Attribute(size_t(a != 7)); }},
+      {"#0 <= #1", [](size_t a, double b) { return Attribute(size_t(double(a) <= b)); }},
+      {"#0 > #1", [](size_t a, double b) { return Attribute(size_t(double(a) > b)); }},
+      {"CASE WHEN #0 < 50 THEN #0 * 2 ELSE 1 END", [](size_t a, double) { return Attribute(a < 50 ? a * 2 : 1); }},
+      {"CASE WHEN #0 < 50 THEN #0 ELSE #1 + 0.5 END",
+       [](size_t a, double b) { return Attribute(a < 50 ? double(a) : b + 0.5); }},
+  };
+
+  vector<Row> rows;
+  for (size_t i = 0; i < kBlockSize; ++i) rows.push_back({i % 100, double(i % 37) * 0.75, string("s")});
+  auto input = MakeTable(kTypes, rows);
+  auto chunk = input->FetchChunk(0, kBlockSize);
+  // every third tuple, as a filter would leave them
+  vector<uint32_t> selection;
+  for (uint32_t i = 0; i < kBlockSize; i += 3) selection.push_back(i);
+  DataChunk sliced(kTypes);
+  sliced.Slice(chunk, selection, selection.size());
+
+  string text;
+  for (auto &c : cases) text += c.text + ";";
+  PhysicalProjection projection(kTypes, Expression::ParseList(text));
+  CHECK(projection.Types().size() == kTypes.size() + cases.size());
+  DataChunk output(projection.Types());
+  auto state = projection.GetState();
+  projection.Execute(sliced, output, *state);
+  CHECK(output.count_ == selection.size());
+
+  for (size_t i = 0; i < output.count_; ++i) {
+    auto &row = rows[selection[i]];
+    for (size_t c = 0; c < kTypes.size(); ++c) {
+      auto &col = output.data_[c];
+      CHECK(col.GetValue(col.selection_vector_[i]) == row[c]);
+    }
+    for (size_t e = 0; e < cases.size(); ++e) {
+      auto &col = output.data_[kTypes.size() + e];
+      auto expected = cases[e].expected(std::get<size_t>(row[0]), std::get<double>(row[1]));
+      if (col.GetValue(col.selection_vector_[i]) != expected) {
+        std::cerr << cases[e].text << ": wrong value at " << i << "\n";
+        n_failures++;
+        break;
+      }
+    }
+  }
+}
+
+int main() {
+  TEST(Parse);
+  TEST(Bind);
+  TEST(Project);
+  return Result();
+}
@@ -0,0 +1,144 @@
+#include <cmath>
+
+#include "test.h"
+#include "../generator.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+constexpr size_t kRows = 200000;
+
+// the number of draws of each of [n_keys] keys of the column 0 of [column], over kRows rows
+vector<size_t> Histogram(const ColumnSpec &column, size_t n_keys) {
+  DataCollection table({AttributeType::INTEGER});
+  GenerateTable(table, {column}, kRows, 7);
+  vector<size_t> counts(n_keys, 0);
+  for (auto &row : Rows(table)) {
+    size_t key = std::get<size_t>(row[0]) - column.min_;
+    CHECK(key < n_keys);
+    if (key < n_keys) counts[key]++;
+  }
+  return counts;
+}
+
+void ParseDistributions() {
+  CHECK(KeyDistribution::Parse("uniform").type_ == DistributionType::UNIFORM);
+  CHECK(KeyDistribution::Parse("constant").type_ == DistributionType::CONSTANT);
+  CHECK(KeyDistribution::Parse("zipf").skew_ == 1);
+  CHECK(KeyDistribution::Parse("zipf:1.5").skew_ == 1.5);
+  auto hotset = KeyDistribution::Parse("hotset:0.2:0.7");
+  CHECK(hotset.type_ == DistributionType::HOTSET);
+  CHECK(hotset.hot_keys_ == 0.2 && hotset.hot_share_ == 0.7);
+  for (auto text : {"uniform", "constant", "zipf:1.5", "hotset:0.2:0.7"}) {
+    CHECK(KeyDistribution::Parse(KeyDistribution::Parse(text).Name()).Name() == KeyDistribution::Parse(text).Name());
+  }
+  CHECK_THROWS(KeyDistribution::Parse(""));
+  CHECK_THROWS(KeyDistribution::Parse("normal"));
+  CHECK_THROWS(KeyDistribution::Parse("zipf:0"));
+  CHECK_THROWS(KeyDistribution::Parse("hotset:0"));
+  CHECK_THROWS(KeyDistribution::Parse("hotset:0.1:1.5"));
+  CHECK_THROWS(KeyDistribution::Parse("uniform:1"));
+}
+
+// The key i is drawn in proportion to 1 / (i + 1)^skew.
+void Zipf() {
+  for (double skew : {0.5, 1.0, 2.0}) {
+    KeyDistribution distribution(DistributionType::ZIPF);
+    distribution.skew_ = skew;
+    size_t n_keys = 100;
+    auto counts = Histogram(ColumnSpec::Key(10, 10 + n_keys - 1, distribution), n_keys);
+    double total = 0;
+    for (size_t i = 0; i < n_keys; ++i) total += std::pow(i + 1, -skew);
+    for (size_t i : {0, 1, 9}) {
+      double expected = std::pow(i + 1, -skew) / total;
+      CHECK(std::abs(double(counts[i]) / kRows - expected) < 0.01);
+    }
+  }
+}
+
+// The hot keys get their share of the draws, and each key of a set about the same.
+void HotSet() {
+  auto distribution = KeyDistribution::Parse("hotset:0.1:0.8");
+  size_t n_keys = 1000;
+  auto counts = Histogram(ColumnSpec::Key(0, n_keys - 1, distribution), n_keys);
+  size_t hot = 0;
+  for (size_t i = 0; i < 100; ++i) hot += counts[i];
+  CHECK(std::abs(double(hot) / kRows - 0.8) < 0.01);
+  auto [cold_min, cold_max] = std::minmax_element(counts.begin() + 100, counts.end());
+  CHECK(*cold_min > 0 && *cold_max < 3 * kRows / 5 / (n_keys - 100));
+}
+
+// The rows are spread evenly over the keys in order, and a key column takes steps.
+void Constant() {
+  auto column = ColumnSpec::Key(0, 9 * 4, KeyDistribution(DistributionType::CONSTANT));
+  column.step_ = 4;
+  DataCollection table({AttributeType::INTEGER});
+  GenerateTable(table, {column}, 100, 7);
+  auto rows = Rows(table);
+  for (size_t i = 0; i < rows.size(); ++i) CHECK(std::get<size_t>(rows[i][0]) == i / 10 * 4);
+  CHECK(table.NumTuples() == 100);
+}
+
+// A correlated column repeats the key of its column with the probability of the correlation, and keeps its own
+// distribution otherwise.
+void Correlation() {
+  size_t n_keys = 1000;
+  auto zipf = KeyDistribution::Parse("zipf:1");
+  for (double correlation : {0.0, 0.3, 1.0}) {
+    vector<ColumnSpec> columns = {ColumnSpec::Key(0, n_keys - 1, zipf),
+                                  ColumnSpec::JoinKey(0, n_keys - 1, zipf, 0, correlation)};
+    DataCollection table(ColumnTypes(columns));
+    GenerateTable(table, columns, kRows, 7);
+    size_t same = 0;
+    for (auto &row : Rows(table)) same += row[0] == row[1];
+    // two independent Zipf draws are the same key with the probability sum p_i^2
+    double total = 0, collision = 0;
+    for (size_t i = 1; i <= n_keys; ++i) total += 1.0 / i;
+    for (size_t i = 1; i <= n_keys; ++i) collision += 1.0 / (i * i) / (total * total);
+    double expected = correlation + (1 - correlation) * collision;
+    CHECK(std::abs(double(same) / kRows - expected) < 0.01);
+  }
+  // uniform keys without a correlation are a plain uniform column
+  CHECK(ColumnSpec::JoinKey(0, 9, KeyDistribution(), 0, 0).generator_ == GeneratorType::UNIFORM);
+}
+
+// The tuples depend on the seed only, not on the segments or the threads that generate them.
+void Deterministic() {
+  vector<ColumnSpec> columns = {ColumnSpec::Uniform(0, 1000000),
+                                ColumnSpec::Key(0, 999, KeyDistribution::Parse("zipf")), ColumnSpec::String("text")};
+  auto types = ColumnTypes(columns);
+  DataCollection first(types), second(types), other(types);
+  GenerateTable(first, columns, 5 * kBlockSize + 3, 11);
+  GenerateTable(second, columns, 5 * kBlockSize + 3, 11);
+  GenerateTable(other, columns, 5 * kBlockSize + 3, 12);
+  CHECK(Rows(first) == Rows(second));
+  CHECK(Rows(first) != Rows(other));
+
+  // a prefix of the table is the table of fewer tuples (unless it has CONSTANT keys)
+  DataCollection prefix(types);
+  GenerateTable(prefix, columns, 1000, 11);
+  auto rows = Rows(first);
+  rows.resize(1000);
+  CHECK(Rows(prefix) == rows);
+}
+
+// A uniform column covers its range, and nothing outside it.
+void Uniform() {
+  auto counts = Histogram(ColumnSpec::Uniform(5, 14), 10);
+  for (size_t count : counts) CHECK(std::abs(double(count) / kRows - 0.1) < 0.01);
+  CHECK(Philox::Uniform(1, 0, 0, 0, ~size_t(0)) == Philox::Bits(1, 0, 0));
+  CHECK(Philox::Bits(1, 0, 0) != Philox::Bits(1, 0, 1));
+  CHECK(Philox::Bits(1, 0, 0) != Philox::Bits(1, 1, 0));
+  CHECK(Philox::Bits(1, 0, 0) != Philox::Bits(2, 0, 0));
+}
+
+int main() {
+  TEST(ParseDistributions);
+  TEST(Zipf);
+  TEST(HotSet);
+  TEST(Constant);
+  TEST(Correlation);
+  TEST(Deterministic);
+  TEST(Uniform);
+  return Result();
+}
@@ -0,0 +1,128 @@
+#include <map>
+
+#include "test.h"
+#include "../hash_aggregate.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+const vector<AttributeType> kTypes = {AttributeType::INTEGER, AttributeType::STRING, AttributeType::INTEGER,
+                                      AttributeType::DOUBLE};
+
+// Tuples of an integer key with [n_keys] values, a string key, an integer and a double (halves, so that the sums are
+// exact in any order).
+unique_ptr<DataCollection> MakeInput(size_t n_rows, size_t n_keys) {
+  const vector<string> names = {"", "a", "b", "a longer name than the others"};
+  vector<vector<Attribute>> rows;
+  for (size_t i = 0; i < n_rows; ++i) {
+    rows.push_back({Philox::Uniform(3, 0, i, 0, n_keys - 1), names[Philox::Uniform(3, 1, i, 0, 3)],
+                    Philox::Uniform(3, 2, i, 0, 1000000), double(Philox::Uniform(3, 3, i, 0, 2000)) * 0.5});
+  }
+  return MakeTable(kTypes, rows);
+}
+
+// Sinks [input] into [aggregate] from three pipelines, and fetches the groups, sorted.
+vector<vector<Attribute>> Aggregate(DataCollection &input, PhysicalHashAggregate &aggregate) {
+  vector<unique_ptr<OperatorState>> states;
+  for (size_t i = 0; i < 3; ++i) states.push_back(aggregate.GetState());
+  for (size_t start = 0, i = 0; start < input.NumTuples(); start += kBlockSize, ++i) {
+    auto chunk = input.FetchChunk(start, std::min(start + kBlockSize, input.NumTuples()));
+    aggregate.Sink(chunk, *states[i % 3]);
+  }
+  for (auto &state : states) aggregate.Finalize(*state);
+  DataCollection result(aggregate.Types());
+  aggregate.Fetch(result);
+  CHECK(result.NumTuples() == aggregate.NumGroups());
+  return SortedRows(result);
+}
+
+// the groups of [input], computed tuple by tuple
+vector<vector<Attribute>> Expected(DataCollection &input, const vector<size_t> &group_by,
+                                   const vector<AggregateSpec> &aggregates) {
+  std::map<vector<Attribute>, vector<Attribute>> groups;
+  for (auto &row : Rows(input)) {
+    vector<Attribute> key;
+    for (auto col_id : group_by) key.push_back(row[col_id]);
+    auto [it, created] = groups.try_emplace(key);
+    auto &states = it->second;
+    for (size_t a = 0; a < aggregates.size(); ++a) {
+      auto &spec = aggregates[a];
+      if (spec.type_ == AggregateType::COUNT) {
+        if (created) states.emplace_back(size_t(0));
+        std::get<size_t>(states[a])++;
+        continue;
+      }
+      auto &value = row[spec.col_id_];
+      if (created) {
+        states.push_back(value);
+      } else if (spec.type_ == AggregateType::SUM) {
+        if (value.index() == 0) std::get<size_t>(states[a]) += std::get<size_t>(value);
+        else std::get<double>(states[a]) += std::get<double>(value);
+      } else if (spec.type_ == AggregateType::MIN) {
+        states[a] = std::min(states[a], value);
+      } else {
+        states[a] = std::max(states[a], value);
+      }
+    }
+  }
+  vector<vector<Attribute>> result;
+  for (auto &[key, states] : groups) {
+    auto &row = result.emplace_back(key);
+    row.insert(row.end(), states.begin(), states.end());
+  }
+  return result;
+}
+
+const vector<AggregateSpec> kSpecs = AggregateSpec::ParseList("count,sum(2),min(2),max(2),sum(3),min(3),max(3)");
+
+// The groups of integer keys, string keys and both, with few groups and with enough groups to grow the table.
+void GroupBy() {
+  for (size_t n_keys : {size_t(3), size_t(50000)}) {
+    auto input = MakeInput(20 * kBlockSize + 7, n_keys);
+    for (auto &group_by : vector<vector<size_t>>{{0}, {1}, {0, 1}, {1, 0}}) {
+      PhysicalHashAggregate aggregate(kTypes, group_by, kSpecs);
+      CHECK(Aggregate(*input, aggregate) == Expected(*input, group_by, kSpecs));
+    }
+  }
+}
+
+// Without group columns, all tuples are one group.
+void Ungrouped() {
+  auto input = MakeInput(5 * kBlockSize, 10);
+  PhysicalHashAggregate aggregate(kTypes, {}, kSpecs);
+  auto result = Aggregate(*input, aggregate);
+  CHECK(result.size() == 1);
+  CHECK(result == Expected(*input, {}, kSpecs));
+}
+
+// The result schema is the group columns, then the aggregates: a count or an integer is an integer.
+void Schema() {
+  PhysicalHashAggregate aggregate(kTypes, {1, 0}, AggregateSpec::ParseList("count,sum(3),max(2)"));
+  vector<AttributeType> types = {AttributeType::STRING, AttributeType::INTEGER, AttributeType::INTEGER,
+                                 AttributeType::DOUBLE, AttributeType::INTEGER};
+  CHECK(aggregate.Types() == types);
+  CHECK_THROWS(PhysicalHashAggregate(kTypes, {3}, kSpecs));
+  CHECK_THROWS(PhysicalHashAggregate(kTypes, {4}, kSpecs));
+  CHECK_THROWS(PhysicalHashAggregate(kTypes, {0}, AggregateSpec::ParseList("sum(1)")));
+  CHECK_THROWS(PhysicalHashAggregate(kTypes, {0}, AggregateSpec::ParseList("min(9)")));
+}
+
+void ParseAggregates() {
+  auto aggregates = AggregateSpec::ParseList("count,sum(2),min(0),max(13)");
+  CHECK(aggregates.size() == 4);
+  CHECK(aggregates[0].type_ == AggregateType::COUNT);
+  CHECK(aggregates[1].type_ == AggregateType::SUM && aggregates[1].col_id_ == 2);
+  CHECK(aggregates[3].Name() == "max(13)");
+  CHECK(ParseColumns("0,4") == (vector<size_t>{0, 4}));
+  CHECK_THROWS(AggregateSpec::ParseList(""));
+  CHECK_THROWS(AggregateSpec::Parse("avg(1)"));
+  CHECK_THROWS(AggregateSpec::Parse("sum(1"));
+}
+
+int main() {
+  TEST(ParseAggregates);
+  TEST(Schema);
+  TEST(GroupBy);
+  TEST(Ungrouped);
+  return Result();
+}
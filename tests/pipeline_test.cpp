@@ -0,0 +1,136 @@
+#include <algorithm>
+
+#include "test.h"
+#include "../pipeline.h"
+#include "../expression.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+const vector<AttributeType> kTypes = {AttributeType::INTEGER, AttributeType::INTEGER, AttributeType::STRING};
+// the hash table: 2000 tuples, 4 per key, so its keys are the multiples of 4 below 2000
+const size_t kHashTableRows = 2000;
+const size_t kFanOut = 4;
+
+// Tuples of a filter column in [0, 100), a join key in [0, 4000) and a string.
+vector<vector<Attribute>> MakeRows(size_t n_rows) {
+  vector<vector<Attribute>> rows;
+  for (size_t i = 0; i < n_rows; ++i) {
+    rows.push_back({Philox::Uniform(7, 0, i, 0, 99), Philox::Uniform(7, 1, i, 0, 3999), "s" + std::to_string(i)});
+  }
+  return rows;
+}
+
+// the result of filter(#0 < 50) -> join(#1) -> project(#0 + #3), computed tuple by tuple
+vector<vector<Attribute>> Expected(const vector<vector<Attribute>> &rows) {
+  vector<vector<Attribute>> result;
+  for (auto &row : rows) {
+    size_t value = std::get<size_t>(row[0]), key = std::get<size_t>(row[1]);
+    if (value >= 50 || key % kFanOut != 0 || key >= kHashTableRows) continue;
+    for (size_t cnt = key; cnt < key + kFanOut; ++cnt) {
+      auto &tuple = result.emplace_back(row);
+      tuple.insert(tuple.end(), {key, std::to_string(cnt) + "|", value + key});
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// Runs the pipeline on [table] with [n_pipelines] workers, and returns the results, sorted.
+template<bool kLogical, CompactType kCompact>
+vector<vector<Attribute>> Run(Table &table, HashTable &ht, size_t n_pipelines, size_t morsel_size) {
+  auto join_types = kTypes;
+  join_types.push_back(AttributeType::INTEGER);
+  join_types.push_back(AttributeType::STRING);
+  auto projection_types = join_types;
+  projection_types.push_back(AttributeType::INTEGER);
+
+  DataCollection result(projection_types);
+  ResultCollector sink(&result);
+  // the tuner switches the thresholds of the dynamic compactors after every call
+  if constexpr (kCompact == CompactType::DYNAMIC) CompactTuner::Get().SetEpoch(1);
+  vector<unique_ptr<Pipeline<kCompact>>> pipelines(n_pipelines);
+  // the tuner ids of the compactors, shared by the pipelines of all workers
+  vector<idx_t> tuner_ids;
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    for (size_t i = 0; i < 2; ++i) tuner_ids.push_back(CompactTuner::Get().Initialize());
+  }
+  for (auto &pipeline : pipelines) {
+    pipeline = std::make_unique<Pipeline<kCompact>>(sink);
+    pipeline->AddOperator(std::make_unique<PhysicalFilter>(0.5, 0, kTypes));
+    pipeline->AddOperator(std::make_unique<PhysicalHashJoin<kLogical>>(ht, 1, join_types));
+    pipeline->AddOperator(std::make_unique<PhysicalProjection>(join_types, Expression::ParseList("#0 + #3")));
+    if constexpr (kCompact == CompactType::FULL) {
+      pipeline->InsertCompactor(0, std::make_unique<FullCompaction>(kTypes));
+      pipeline->InsertCompactor(1, std::make_unique<FullCompaction>(join_types));
+    } else if constexpr (kCompact == CompactType::DYNAMIC) {
+      pipeline->InsertCompactor(0, std::make_unique<DynamicCompaction>(tuner_ids[0], 0, kTypes));
+      pipeline->InsertCompactor(1, std::make_unique<DynamicCompaction>(tuner_ids[1], 1, join_types));
+    }
+  }
+  auto statistics = ExecuteMorsels(table, pipelines, morsel_size);
+  if constexpr (kCompact == CompactType::DYNAMIC) {
+    CompactTuner::Get().Reset();
+    CompactTuner::Get().SetEpoch(16);
+  }
+
+  // the workers claim each tuple once
+  size_t n_tuples = 0;
+  for (auto &statistic : statistics) n_tuples += statistic.n_tuples_;
+  CHECK(n_tuples == table.NumTuples());
+  return SortedRows(result);
+}
+
+// The results are the same with one or several pipelines, with any morsel size, and with or without compaction. The
+// dynamic compactors of several workers share their tuners, and switch the thresholds while the workers run.
+void Morsels() {
+  auto rows = MakeRows(25 * kBlockSize + 13);
+  auto table = MakeTable(kTypes, rows);
+  auto join_types = kTypes;
+  join_types.push_back(AttributeType::INTEGER);
+  join_types.push_back(AttributeType::STRING);
+  HashTable ht(kHashTableRows, kFanOut, 0, join_types);
+  auto expected = Expected(rows);
+  CHECK(!expected.empty());
+
+  for (size_t n_pipelines : {size_t(1), size_t(4)}) {
+    for (size_t morsel_size : {size_t(1), kBlockSize, 3 * kBlockSize + 100}) {
+      CHECK((Run<false, CompactType::NONE>(*table, ht, n_pipelines, morsel_size)) == expected);
+      CHECK((Run<true, CompactType::NONE>(*table, ht, n_pipelines, morsel_size)) == expected);
+      CHECK((Run<false, CompactType::FULL>(*table, ht, n_pipelines, morsel_size)) == expected);
+      CHECK((Run<true, CompactType::FULL>(*table, ht, n_pipelines, morsel_size)) == expected);
+      CHECK((Run<false, CompactType::DYNAMIC>(*table, ht, n_pipelines, morsel_size)) == expected);
+      CHECK((Run<true, CompactType::DYNAMIC>(*table, ht, n_pipelines, morsel_size)) == expected);
+    }
+  }
+}
+
+// The morsels cover the tuples once, and a morsel size of 0 is one tuple.
+void Source() {
+  for (size_t morsel_size : {size_t(1), size_t(7), size_t(100)}) {
+    MorselSource source(100, morsel_size);
+    size_t start, end, next = 0;
+    while (source.Next(start, end)) {
+      CHECK(start == next && end > start && end - start <= morsel_size);
+      next = end;
+    }
+    CHECK(next == 100);
+    CHECK(!source.Next(start, end));
+  }
+
+  auto table = MakeTable(kTypes, MakeRows(10));
+  DataCollection result(kTypes);
+  ResultCollector sink(&result);
+  vector<unique_ptr<Pipeline<>>> pipelines;
+  pipelines.push_back(std::make_unique<Pipeline<>>(sink));
+  pipelines[0]->AddOperator(std::make_unique<PhysicalFilter>(1, 0, kTypes));
+  auto statistics = ExecuteMorsels(*table, pipelines, 0);
+  CHECK(statistics[0].n_morsel_ == 10);
+  CHECK(Rows(result) == Rows(*table));
+}
+
+int main() {
+  TEST(Source);
+  TEST(Morsels);
+  return Result();
+}
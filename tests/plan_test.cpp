@@ -0,0 +1,157 @@
+#include "test.h"
+#include "../plan.h"
+#include "../tpch.h"
+#include "../expression.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+// the example of plan.h
+const char *kExample = "table rows=2000000 seed=2\n"
+                       "column uniform min=0 max=100\n"
+                       "column uniform min=0 max=200000\n"
+                       "column string value=|\n"
+                       "\n"
+                       "  # a comment\n"
+                       "hashtable rhs1 rows=200000 chunk-factor=8 payload=1000 load-factor=0.5\n"
+                       "filter column=0 selectivity=0.2\n"
+                       "compact\n"
+                       "join rhs1 column=1\n"
+                       "compact\n"
+                       "project #1 * 2; CASE WHEN #0 < 10 THEN 1 ELSE 0 END\n"
+                       "aggregate count,sum(5) group-by=0\n";
+
+void Example() {
+  auto plan = PlanSpec::Parse(kExample);
+  CHECK(plan.table_.rows_ == 2000000 && plan.table_.seed_ == 2);
+  CHECK(plan.table_.columns_.size() == 3);
+  CHECK(plan.table_.columns_[1].generator_ == GeneratorType::UNIFORM && plan.table_.columns_[1].max_ == 200000);
+  CHECK(plan.table_.columns_[2].generator_ == GeneratorType::STRING && plan.table_.columns_[2].text_ == "|");
+
+  CHECK(plan.hash_tables_.size() == 1);
+  auto &ht = plan.hash_tables_[0];
+  CHECK(ht.name_ == "rhs1" && ht.rows_ == 200000 && ht.chunk_factor_ == 8 && ht.payload_ == 1000);
+  CHECK(ht.load_factor_ == 0.5 && ht.fan_out_.type_ == DistributionType::CONSTANT && ht.seed_ == 1);
+
+  CHECK(plan.operators_.size() == 3);
+  CHECK(plan.operators_[0].type_ == PlanOperatorType::FILTER && plan.operators_[0].selectivity_ == 0.2);
+  CHECK(plan.operators_[0].compact_);
+  CHECK(plan.operators_[1].type_ == PlanOperatorType::JOIN && plan.operators_[1].ht_id_ == 0);
+  CHECK(plan.operators_[1].col_id_ == 1 && plan.operators_[1].compact_);
+  CHECK(plan.operators_[2].type_ == PlanOperatorType::PROJECT && !plan.operators_[2].compact_);
+  CHECK(Expression::ParseList(plan.operators_[2].expressions_).size() == 2);
+
+  CHECK(plan.group_by_ == vector<size_t>{0});
+  CHECK(plan.aggregates_.size() == 2 && plan.aggregates_[1].col_id_ == 5);
+  CHECK(plan.order_by_.empty() && plan.limit_ == 0);
+}
+
+// The options of the key columns, the filters and the sort.
+void Options() {
+  auto plan = PlanSpec::Parse("table rows=10\n"
+                              "column sequence\n"
+                              "column constant value=7\n"
+                              "column key min=8 max=80 step=8 dist=zipf:0.5\n"
+                              "column key min=8 max=80 step=8 dist=zipf:0.5 correlate=2 correlation=0.25\n"
+                              "column key max=80 step=8 dist=hotset:0.1:0.5\n"
+                              "hashtable a rows=5 fan-out=zipf seed=9\n"
+                              "filter column=3 less-than=25\n"
+                              "join a column=2\n"
+                              "order-by 0:desc,1 limit=5\n");
+  auto &columns = plan.table_.columns_;
+  CHECK(plan.table_.seed_ == 2);
+  CHECK(columns[0].generator_ == GeneratorType::SEQUENCE);
+  CHECK(columns[1].generator_ == GeneratorType::CONSTANT && columns[1].value_ == 7);
+  CHECK(columns[2].generator_ == GeneratorType::KEY && columns[2].min_ == 8 && columns[2].step_ == 8);
+  CHECK(columns[2].distribution_.type_ == DistributionType::ZIPF && columns[2].distribution_.skew_ == 0.5);
+  CHECK(columns[3].min_ == 8 && columns[3].correlated_col_ == 2 && columns[3].correlation_ == 0.25);
+  CHECK(columns[4].distribution_.type_ == DistributionType::HOTSET && columns[4].distribution_.hot_share_ == 0.5);
+  CHECK(plan.hash_tables_[0].fan_out_.type_ == DistributionType::ZIPF && plan.hash_tables_[0].seed_ == 9);
+  CHECK(plan.operators_[0].selectivity_ == 0.25);
+  CHECK(plan.order_by_.size() == 2 && plan.order_by_[0].desc_ && plan.limit_ == 5);
+  CHECK(plan.aggregates_.empty());
+}
+
+// A wrong statement is an error that names its line.
+void Errors() {
+  string table = "table rows=10\ncolumn sequence\n";
+  auto error = [&](const string &statements) {
+    try {
+      PlanSpec::Parse(table + statements);
+    } catch (std::runtime_error &e) {
+      return string(e.what());
+    }
+    return string();
+  };
+  CHECK(error("filter column=0 selectivity=0.5 bogus=1\n").find("Plan line 3") == 0);
+  CHECK(error("filter column=0 selectivity=0.5\nfrobnicate\n").find("Plan line 4: Unknown statement") == 0);
+  CHECK(!error("filter column=0\n").empty());
+  CHECK(!error("join missing column=0\n").empty());
+  CHECK(!error("compact\nfilter column=0 selectivity=0.5\n").empty());
+  CHECK(!error("filter column=0 selectivity=0.5\naggregate count\norder-by 0\n").empty());
+  CHECK(!error("column key min=9 max=1\nfilter column=0 selectivity=0.5\n").empty());
+  CHECK(!error("column key max=9 correlate=5 correlation=0.5\nfilter column=0 selectivity=0.5\n").empty());
+  // the column of a correlation draws its keys the same way, and is not correlated itself
+  CHECK(!error("column key max=9 correlate=0 correlation=0.5\nfilter column=0 selectivity=0.5\n").empty());
+  string key = "column key max=9 dist=zipf\n";
+  CHECK(error(key + "column key max=9 dist=zipf correlate=1 correlation=0.5\nfilter column=0 selectivity=0.5\n")
+            .empty());
+  CHECK(!error(key + "column key max=8 dist=zipf correlate=1 correlation=0.5\nfilter column=0 selectivity=0.5\n")
+             .empty());
+  CHECK(!error(key + "column key max=9 correlate=1 correlation=0.5\nfilter column=0 selectivity=0.5\n").empty());
+  CHECK(!error(key + "column key max=9 dist=zipf correlate=1 correlation=0.5\n"
+                     "column key max=9 dist=zipf correlate=2 correlation=0.5\nfilter column=0 selectivity=0.5\n")
+             .empty());
+  CHECK(!error("column normal\nfilter column=0 selectivity=0.5\n").empty());
+  CHECK(!error("").empty());
+  CHECK_THROWS(PlanSpec::Parse("filter column=0 selectivity=0.5\n"));
+  CHECK_THROWS(PlanSpec::Load("plans/missing.plan"));
+}
+
+// the number of columns after the operators of [plan], checking that each column the plan reads exists
+size_t CheckColumns(const PlanSpec &plan) {
+  size_t n_cols = plan.table_.columns_.size();
+  for (auto &op : plan.operators_) {
+    if (op.type_ == PlanOperatorType::PROJECT) {
+      auto expressions = Expression::ParseList(op.expressions_);
+      vector<AttributeType> types(n_cols, AttributeType::INTEGER);
+      for (auto &expression : expressions) expression->Bind(types);
+      n_cols += expressions.size();
+      continue;
+    }
+    CHECK(op.col_id_ < n_cols);
+    if (op.type_ == PlanOperatorType::JOIN) n_cols += 2;
+  }
+  for (auto col_id : plan.group_by_) CHECK(col_id < n_cols);
+  for (auto &spec : plan.aggregates_) CHECK(spec.type_ == AggregateType::COUNT || spec.col_id_ < n_cols);
+  for (auto &spec : plan.order_by_) CHECK(spec.col_id_ < n_cols);
+  return n_cols;
+}
+
+// The plans of the repository, and the TPC-H-style plans at several scale factors, parse and read existing columns.
+void Plans() {
+  for (auto path : {"plans/filter_and_join.plan", "plans/skewed.plan", "plans/snowflake.plan"}) {
+    CheckColumns(PlanSpec::Load(path));
+  }
+  for (auto &query : TPCHQueries()) {
+    for (double sf : {0.001, 0.1, 1.0, 10.0}) {
+      auto plan = PlanSpec::Parse(TPCHPlan(query, sf));
+      CheckColumns(plan);
+      CHECK(!plan.aggregates_.empty());
+      for (auto &ht : plan.hash_tables_) CHECK(ht.rows_ > 0);
+    }
+  }
+  auto q3 = PlanSpec::Parse(TPCHPlan("q3", 1));
+  CHECK(q3.table_.rows_ == tpch::kLineitem);
+  CHECK(q3.hash_tables_.size() == 2 && q3.hash_tables_[1].rows_ == tpch::kCustomer / 5);
+  CHECK_THROWS(TPCHPlan("q1", 1));
+  CHECK_THROWS(TPCHPlan("q3", 0));
+}
+
+int main() {
+  TEST(Example);
+  TEST(Options);
+  TEST(Errors);
+  TEST(Plans);
+  return Result();
+}
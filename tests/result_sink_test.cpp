@@ -0,0 +1,111 @@
+#include "test.h"
+#include "../csv_reader.h"
+#include "../table_file.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+// strings that a CSV field has to quote, or not
+const vector<string> kTexts = {"plain", "with,comma", "say \"hi\"", "\"", "", "trailing,", "x"};
+
+// Tuples of an INTEGER, a DOUBLE and a STRING column, over several segments and a partial one.
+vector<vector<Attribute>> MakeRows(const vector<string> &texts) {
+  vector<vector<Attribute>> rows;
+  for (size_t i = 0; i < 3 * kBlockSize + 17; ++i) {
+    rows.push_back({i * 7, i * 0.1, texts[i % texts.size()] + std::to_string(i % 5)});
+  }
+  return rows;
+}
+
+// Sinks [table] to [sink] in chunks, alternating between two pipelines, as the morsels of two threads would.
+void SinkTable(DataCollection &table, PhysicalFileSink &sink) {
+  auto left = sink.GetState(), right = sink.GetState();
+  for (size_t start = 0, i = 0; start < table.NumTuples(); start += 1000, ++i) {
+    auto chunk = table.FetchChunk(start, std::min(start + 1000, table.NumTuples()));
+    sink.Sink(chunk, i % 2 == 0 ? *left : *right);
+  }
+  sink.Finalize(*left);
+  sink.Finalize(*right);
+  sink.Close();
+}
+
+const vector<AttributeType> kTypes = {AttributeType::INTEGER, AttributeType::DOUBLE, AttributeType::STRING};
+
+// The binary result file is a table file: MappedTable reads back the tuples, strings with line breaks included.
+void BinaryRoundTrip() {
+  auto texts = kTexts;
+  texts.push_back("line\nbreak\r");
+  auto input = MakeTable(kTypes, MakeRows(texts));
+  TempFile file("result.table");
+  PhysicalFileSink sink(kTypes, file.Path(), ResultFormat::BINARY);
+  SinkTable(*input, sink);
+
+  CHECK(IsTableFile(file.Path()));
+  MappedTable table(file.Path());
+  CHECK(table.NumTuples() == input->NumTuples());
+  CHECK(table.Types() == kTypes);
+  CHECK(SortedRows(table) == SortedRows(*input));
+}
+
+// The CSV result file reads back with the CSV reader, with the quoted fields unquoted.
+void CSVRoundTrip() {
+  auto input = MakeTable(kTypes, MakeRows(kTexts));
+  TempFile file("result.csv");
+  PhysicalFileSink sink(kTypes, file.Path(), ResultFormat::CSV);
+  SinkTable(*input, sink);
+
+  auto table = ReadCSV(file.Path(), ',', kTypes);
+  CHECK(table->NumTuples() == input->NumTuples());
+  CHECK(SortedRows(*table) == SortedRows(*input));
+}
+
+// The delimiter of the file is quoted, and a comma is not.
+void CSVDelimiter() {
+  auto input = MakeTable(kTypes, MakeRows({"a|b", "a,b", "|"}));
+  TempFile file("result.tsv");
+  PhysicalFileSink sink(kTypes, file.Path(), ResultFormat::CSV, '|');
+  SinkTable(*input, sink);
+
+  auto table = ReadCSV(file.Path(), '|', kTypes);
+  CHECK(SortedRows(*table) == SortedRows(*input));
+}
+
+// A table written with WriteTable and a result file with the same tuples have the same contents.
+void WriteTableMatchesSink() {
+  auto input = MakeTable(kTypes, MakeRows(kTexts));
+  TempFile written("written.table"), sunk("sunk.table");
+  WriteTable(*input, written.Path());
+  PhysicalFileSink sink(kTypes, sunk.Path(), ResultFormat::BINARY);
+  SinkTable(*input, sink);
+
+  MappedTable left(written.Path()), right(sunk.Path());
+  CHECK(Rows(left) == Rows(*input));
+  CHECK(SortedRows(left) == SortedRows(right));
+}
+
+// An empty result is an empty table, as is an empty table written with WriteTable.
+void EmptyResult() {
+  TempFile file("empty.table"), written("empty_written.table");
+  PhysicalFileSink sink(kTypes, file.Path(), ResultFormat::BINARY);
+  auto state = sink.GetState();
+  sink.Finalize(*state);
+  sink.Close();
+  DataCollection empty(kTypes);
+  WriteTable(empty, written.Path());
+
+  for (auto *path : {&file.Path(), &written.Path()}) {
+    MappedTable table(*path);
+    CHECK(table.NumTuples() == 0);
+    CHECK(table.Types() == kTypes);
+    CHECK(Rows(table).empty());
+  }
+}
+
+int main() {
+  TEST(BinaryRoundTrip);
+  TEST(CSVRoundTrip);
+  TEST(CSVDelimiter);
+  TEST(WriteTableMatchesSink);
+  TEST(EmptyResult);
+  return Result();
+}
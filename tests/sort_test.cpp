@@ -0,0 +1,124 @@
+#include "test.h"
+#include "../sort.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+const vector<AttributeType> kTypes = {AttributeType::INTEGER, AttributeType::DOUBLE, AttributeType::STRING};
+
+// Tuples with many ties in each column: small integers, negative and positive doubles, and strings that differ
+// before, at, and after the prefix of the sort key.
+vector<vector<Attribute>> MakeRows(size_t n_rows) {
+  const vector<string> prefixes = {"", "a", "b", "abcdefghijklmnop", "abcdefghijklmnopq", "abcdefghijklmno"};
+  vector<vector<Attribute>> rows;
+  for (size_t i = 0; i < n_rows; ++i) {
+    size_t a = Philox::Uniform(5, 0, i, 0, 20), b = Philox::Uniform(5, 1, i, 0, 40);
+    size_t c = Philox::Uniform(5, 2, i, 0, 17);
+    string text = prefixes[c % prefixes.size()] + (c % 3 == 0 ? "" : std::to_string(c));
+    rows.push_back({a, (double(b) - 20) * 0.75, text});
+  }
+  return rows;
+}
+
+// the order of the tuples by [order_by], as a SQL engine would compare them
+bool Before(const vector<Attribute> &left, const vector<Attribute> &right, const vector<SortSpec> &order_by) {
+  for (auto &spec : order_by) {
+    auto &l = left[spec.col_id_], &r = right[spec.col_id_];
+    if (l == r) continue;
+    return spec.desc_ ? r < l : l < r;
+  }
+  return false;
+}
+
+// the values of the sort columns of [rows]
+vector<vector<Attribute>> Keys(const vector<vector<Attribute>> &rows, const vector<SortSpec> &order_by) {
+  vector<vector<Attribute>> keys;
+  for (auto &row : rows) {
+    auto &key = keys.emplace_back();
+    for (auto &spec : order_by) key.push_back(row[spec.col_id_]);
+  }
+  return keys;
+}
+
+// Sinks [input] into [sink] from three pipelines, in chunks of different sizes, and fetches the result.
+vector<vector<Attribute>> SortTable(DataCollection &input, SortedSink &sink) {
+  vector<unique_ptr<OperatorState>> states;
+  for (size_t i = 0; i < 3; ++i) states.push_back(sink.GetState());
+  for (size_t start = 0, i = 0; start < input.NumTuples(); ++i) {
+    size_t end = std::min(start + 100 + i * 37 % kBlockSize, input.NumTuples());
+    auto chunk = input.FetchChunk(start, end);
+    sink.Sink(chunk, *states[i % 3]);
+    start = end;
+  }
+  for (auto &state : states) sink.Finalize(*state);
+  DataCollection result(input.Types());
+  sink.Fetch(result);
+  return Rows(result);
+}
+
+const vector<string> kOrders = {"0", "1", "2", "0:desc", "1:desc", "2:desc", "2,0:desc,1", "1:desc,2:asc,0",
+                                "0,1,2"};
+
+// ORDER BY: all tuples, in the order of the sort columns, whatever the pipelines that sink them.
+void Order() {
+  auto rows = MakeRows(5 * kBlockSize + 11);
+  auto input = MakeTable(kTypes, rows);
+  for (auto &text : kOrders) {
+    auto order_by = SortSpec::ParseList(text);
+    auto sink = CreateSortedSink(kTypes, order_by, 0);
+    CHECK(dynamic_cast<PhysicalOrder *>(sink.get()) != nullptr);
+    auto result = SortTable(*input, *sink);
+
+    auto expected = rows;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](auto &left, auto &right) { return Before(left, right, order_by); });
+    CHECK(Keys(result, order_by) == Keys(expected, order_by));
+    std::sort(result.begin(), result.end());
+    std::sort(expected.begin(), expected.end());
+    CHECK(result == expected);
+  }
+}
+
+// ORDER BY ... LIMIT: the first tuples of the order, also with a limit past the number of tuples.
+void TopN() {
+  auto rows = MakeRows(3 * kBlockSize + 5);
+  auto input = MakeTable(kTypes, rows);
+  auto all = rows;
+  std::sort(all.begin(), all.end());
+  for (auto &text : kOrders) {
+    auto order_by = SortSpec::ParseList(text);
+    auto expected = rows;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](auto &left, auto &right) { return Before(left, right, order_by); });
+    for (size_t limit : {size_t(1), size_t(10), size_t(1000), rows.size() + 10}) {
+      auto sink = CreateSortedSink(kTypes, order_by, limit);
+      CHECK(dynamic_cast<PhysicalTopN *>(sink.get()) != nullptr);
+      auto result = SortTable(*input, *sink);
+      auto first = expected;
+      first.resize(std::min(limit, rows.size()));
+      CHECK(Keys(result, order_by) == Keys(first, order_by));
+      // and each of them is a tuple of the input
+      std::sort(result.begin(), result.end());
+      CHECK(std::includes(all.begin(), all.end(), result.begin(), result.end()));
+    }
+  }
+}
+
+void ParseSortSpecs() {
+  auto order_by = SortSpec::ParseList("4:desc,1,2:asc");
+  CHECK(order_by.size() == 3);
+  CHECK(order_by[0].col_id_ == 4 && order_by[0].desc_);
+  CHECK(order_by[1].col_id_ == 1 && !order_by[1].desc_);
+  CHECK(order_by[2].col_id_ == 2 && !order_by[2].desc_);
+  CHECK(order_by[0].Name() == "4:desc");
+  CHECK_THROWS(SortSpec::ParseList(""));
+  CHECK_THROWS(SortSpec::Parse("1:up"));
+  CHECK_THROWS(PhysicalTopN(kTypes, SortSpec::ParseList("1"), 0));
+}
+
+int main() {
+  TEST(ParseSortSpecs);
+  TEST(Order);
+  TEST(TopN);
+  return Result();
+}
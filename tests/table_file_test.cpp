@@ -0,0 +1,129 @@
+#include <fstream>
+
+#include "test.h"
+#include "../table_file.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+const vector<ColumnSpec> kColumns = {ColumnSpec::Uniform(0, 1000000), ColumnSpec::String("some_text"),
+                                     ColumnSpec::Key(0, 99, KeyDistribution::Parse("zipf"))};
+
+// A table saved by CreateTable scans back from the table file with the same tuples, in order.
+void SaveAndLoad() {
+  TempFile file("saved.table");
+  auto generated = CreateTable(kColumns, 3 * kBlockSize + 5, 3, "", file.Path());
+  CHECK(IsTableFile(file.Path()));
+  auto loaded = CreateTable(kColumns, 0, 0, file.Path(), "");
+  CHECK(dynamic_cast<MappedTable *>(loaded.get()) != nullptr);
+  CHECK(loaded->NumTuples() == generated->NumTuples());
+  CHECK(Rows(*loaded) == Rows(*generated));
+
+  // the columns must match the query
+  vector<ColumnSpec> other = {ColumnSpec::Uniform(0, 9)};
+  CHECK_THROWS(CreateTable(other, 0, 0, file.Path(), ""));
+}
+
+// A scan of any range of tuples, as a morsel would, decodes the same tuples as the table, across the segments.
+void ScanRanges() {
+  TempFile file("ranges.table");
+  auto table = CreateTable(kColumns, 4 * kBlockSize, 3, "", file.Path());
+  auto &collection = static_cast<DataCollection &>(*table);
+  MappedTable mapped(file.Path());
+  DataChunk chunk(mapped.Types());
+  for (size_t start : {size_t(0), size_t(1), kBlockSize - 3, kBlockSize, 3 * kBlockSize + 1}) {
+    size_t end = std::min(start + kBlockSize, mapped.NumTuples());
+    mapped.ScanChunk(start, end, chunk);
+    CHECK(chunk.count_ == end - start);
+    for (size_t i = 0; i < chunk.count_; ++i) {
+      for (size_t c = 0; c < kColumns.size(); ++c) {
+        CHECK(chunk.data_[c].GetValue(chunk.data_[c].selection_vector_[i]) == collection.GetValue(start + i, c));
+      }
+    }
+  }
+}
+
+// A file written with a smaller block size is read with the larger one, but not the other way around.
+void BlockSizes() {
+  TempFile file("small_blocks.table");
+  size_t block_size = kBlockSize;
+  kBlockSize = block_size / 4;
+  auto table = CreateTable(kColumns, block_size + 7, 3, "", file.Path());
+  auto rows = Rows(*table);
+  kBlockSize = block_size;
+
+  MappedTable mapped(file.Path());
+  CHECK(Rows(mapped) == rows);
+
+  TempFile large("large_blocks.table");
+  CreateTable(kColumns, 10, 3, "", large.Path());
+  kBlockSize = block_size / 2;
+  CHECK_THROWS(MappedTable{large.Path()});
+  kBlockSize = block_size;
+}
+
+// A file that is not a table file, or is cut short, is rejected.
+void Corrupt() {
+  TempFile csv("not_a_table.csv");
+  std::ofstream(csv.Path()) << "1,2,3\n";
+  CHECK(!IsTableFile(csv.Path()));
+  CHECK_THROWS(MappedTable{csv.Path()});
+
+  TempFile file("truncated.table");
+  CreateTable(kColumns, 3 * kBlockSize, 3, "", file.Path());
+  std::filesystem::resize_file(file.Path(), table_file::kPageSize * 2);
+  CHECK(IsTableFile(file.Path()));
+  CHECK_THROWS(MappedTable{file.Path()});
+}
+
+// Overwrites the bytes at [offset] of the file [path] with [value].
+template<class T>
+void Patch(const string &path, size_t offset, const T &value) {
+  std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+  file.seekp(offset);
+  file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// A header, column header or segment that points past the file or its segment is rejected instead of read.
+void Forged() {
+  using namespace table_file;
+  // a header with more column headers than the file holds
+  TempFile header("forged_header.table");
+  FileHeader forged{};
+  std::memcpy(forged.magic_, kMagic, sizeof(kMagic));
+  forged.version_ = kVersion;
+  forged.n_cols_ = 100000000;
+  forged.block_size_ = kBlockSize;
+  std::ofstream(header.Path(), std::ios::binary).write(reinterpret_cast<const char *>(&forged), sizeof(forged));
+  CHECK_THROWS(MappedTable{header.Path()});
+
+  // an unknown column type
+  TempFile type("forged_type.table");
+  CreateTable(kColumns, 10, 3, "", type.Path());
+  Patch(type.Path(), sizeof(FileHeader) + sizeof(ColumnHeader), uint8_t(7));
+  CHECK_THROWS(MappedTable{type.Path()});
+
+  // a segment shorter than its columns
+  TempFile bytes("forged_bytes.table");
+  CreateTable(kColumns, 10, 3, "", bytes.Path());
+  MappedTable{bytes.Path()};
+  FileHeader file_header{};
+  std::ifstream(bytes.Path(), std::ios::binary).read(reinterpret_cast<char *>(&file_header), sizeof(file_header));
+  Patch(bytes.Path(), file_header.directory_offset_ + offsetof(SegmentEntry, bytes_), uint64_t(16));
+  CHECK_THROWS(MappedTable{bytes.Path()});
+
+  // a string past the characters of its column: the offsets follow the 10 integers of the first column
+  TempFile offsets("forged_offsets.table");
+  CreateTable(kColumns, 10, 3, "", offsets.Path());
+  Patch(offsets.Path(), kPageSize + 10 * sizeof(uint64_t) + 10 * sizeof(uint32_t), uint32_t(1) << 30);
+  CHECK_THROWS(MappedTable{offsets.Path()});
+}
+
+int main() {
+  TEST(SaveAndLoad);
+  TEST(ScanRanges);
+  TEST(BlockSizes);
+  TEST(Corrupt);
+  TEST(Forged);
+  return Result();
+}
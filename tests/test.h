@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Compaction
+//
+// test.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <unistd.h>
+
+#include "../base.h"
+#include "../data_collection.h"
+#include "../setting.h"
+
+// The checks of the behaviour tests: each test is an executable (see CMakeLists.txt) that runs its cases, reports the
+// failed checks, and fails if there are any. A test includes this header once, and with it the globals of setting.h.
+namespace compaction::test {
+inline size_t n_failures = 0;
+
+// a file in the temporary directory, removed at the end of the test
+class TempFile {
+ public:
+  explicit TempFile(const string &name)
+      : path_((std::filesystem::temp_directory_path() /
+               ("compaction_" + std::to_string(getpid()) + "_" + name)).string()) {}
+
+  ~TempFile() { std::remove(path_.c_str()); }
+
+  inline const string &Path() const { return path_; }
+
+ private:
+  string path_;
+};
+
+// the tuples of [table] in the order of the scan
+inline vector<vector<Attribute>> Rows(Table &table) {
+  vector<vector<Attribute>> rows;
+  DataChunk chunk(table.Types());
+  for (size_t start = 0; start < table.NumTuples(); start += kBlockSize) {
+    table.ScanChunk(start, std::min(start + kBlockSize, table.NumTuples()), chunk);
+    for (size_t i = 0; i < chunk.count_; ++i) {
+      auto &row = rows.emplace_back();
+      for (auto &col : chunk.data_) row.push_back(col.GetValue(col.selection_vector_[i]));
+    }
+  }
+  return rows;
+}
+
+// the tuples of [table] sorted, for the results whose order is not kept
+inline vector<vector<Attribute>> SortedRows(Table &table) {
+  auto rows = Rows(table);
+  std::sort(rows.begin(), rows.end());
+  return rows;
+}
+
+// a collection of the tuples [rows]
+inline unique_ptr<DataCollection> MakeTable(const vector<AttributeType> &types, vector<vector<Attribute>> rows) {
+  auto table = std::make_unique<DataCollection>(types);
+  for (auto &row : rows) table->AppendTuple(row);
+  return table;
+}
+
+inline void Run(const char *name, const std::function<void()> &test) {
+  size_t failures = n_failures;
+  try {
+    test();
+  } catch (std::exception &e) {
+    std::cerr << name << ": unexpected exception: " << e.what() << "\n";
+    n_failures++;
+  }
+  std::cerr << (n_failures == failures ? "[ OK ] " : "[FAIL] ") << name << "\n";
+}
+
+inline int Result() {
+  if (n_failures > 0) std::cerr << n_failures << " checks failed\n";
+  return n_failures == 0 ? 0 : 1;
+}
+}
+
+#define CHECK(condition)                                                                  \
+  do {                                                                                    \
+    if (!(condition)) {                                                                   \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n";     \
+      compaction::test::n_failures++;                                                     \
+    }                                                                                     \
+  } while (0)
+
+// checks that [statement] throws std::runtime_error
+#define CHECK_THROWS(statement)                                                           \
+  do {                                                                                    \
+    bool thrown = false;                                                                  \
+    try {                                                                                 \
+      statement;                                                                          \
+    } catch (std::runtime_error &) {                                                      \
+      thrown = true;                                                                      \
+    }                                                                                     \
+    if (!thrown) {                                                                        \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": no exception: " #statement "\n";     \
+      compaction::test::n_failures++;                                                     \
+    }                                                                                     \
+  } while (0)
+
+#define TEST(name) compaction::test::Run(#name, name)
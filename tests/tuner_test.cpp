@@ -0,0 +1,170 @@
+#include <thread>
+
+#include "test.h"
+#include "../negative_feedback.hpp"
+#include "../plan.h"
+
+using namespace compaction;
+using namespace compaction::test;
+
+// The signatures of the compactors of a plan tell the strategies, the block sizes and the plans apart.
+void Signatures() {
+  auto plan = PlanSpec::Load("plans/filter_and_join.plan");
+  auto skewed = PlanSpec::Load("plans/skewed.plan");
+  string physical = plan.Signature(1, false);
+  CHECK(physical != plan.Signature(1, true));
+  CHECK(physical != skewed.Signature(1, false));
+  CHECK(physical != plan.Signature(2, false));
+
+  size_t block_size = kBlockSize;
+  kBlockSize = block_size / 2;
+  CHECK(physical != plan.Signature(1, false));
+  kBlockSize = block_size;
+  CHECK(physical == plan.Signature(1, false));
+}
+
+// A saved state warm-starts the compactors with its signature, policy and arms only: a state saved under one
+// strategy does not warm-start another.
+void SaveAndLoad() {
+  auto plan = PlanSpec::Load("plans/filter_and_join.plan");
+  string physical = plan.Signature(1, false), logical = plan.Signature(1, true);
+  TempFile file("tuner.state");
+  auto &tuner = CompactTuner::Get();
+  tuner.Initialize(TunerType::UCB, physical);
+  tuner.Initialize(TunerType::THOMPSON, physical);
+  tuner.Save(file.Path());
+  tuner.Reset();
+
+  tuner.Initialize(TunerType::UCB, logical);
+  tuner.Initialize(TunerType::THOMPSON, logical);
+  CHECK(tuner.Load(file.Path()) == 0);
+  tuner.Reset();
+
+  tuner.Initialize(TunerType::UCB, physical);
+  tuner.Initialize(TunerType::CONTEXTUAL, physical);
+  tuner.Initialize(TunerType::THOMPSON, physical, {0, 512});
+  CHECK(tuner.Load(file.Path()) == 1);
+  tuner.Reset();
+
+  // a missing file warm-starts nothing, and a saved file keeps the states of the other signatures
+  CHECK(tuner.Load(file.Path() + ".missing") == 0);
+  tuner.Initialize(TunerType::UCB, logical);
+  tuner.Save(file.Path());
+  tuner.Reset();
+  tuner.Initialize(TunerType::UCB, physical);
+  tuner.Initialize(TunerType::UCB, logical);
+  CHECK(tuner.Load(file.Path()) == 2);
+  tuner.Reset();
+}
+
+// Feeds [policy] the costs of [n] chunks: a downstream cost of [down_fixed] s per chunk and 1e-8 s per tuple, and a
+// compaction cost of [copy_fixed] s per chunk and 1e-9 s per tuple. The chunks entering the compactor have 64 tuples.
+void ObserveCosts(CostModelPolicy &policy, size_t n, double down_fixed, double copy_fixed) {
+  const size_t down_sizes[] = {64, 512, 1024, 2048}, copy_sizes[] = {16, 32, 64};
+  for (size_t i = 0; i < n; ++i) {
+    policy.ObserveChunk(64);
+    size_t down = down_sizes[i % 4], copy = copy_sizes[i % 3];
+    policy.ObserveDownstream(down, down_fixed + 1e-8 * down);
+    policy.ObserveCompact(copy, copy_fixed + 1e-9 * copy);
+  }
+}
+
+// The cost model alternates between the smallest and the largest threshold during the warm-up, then fits the costs
+// every 64 downstream observations: a high cost per downstream chunk picks the smallest threshold that compacts the
+// chunks, and a refit follows a workload whose compaction becomes the expensive part.
+void CostModelFit() {
+  TunerContext context;
+  CostModelPolicy policy({0, 128, 1024});
+  for (size_t i = 0; i < 8; ++i) CHECK(policy.SelectArm(context) == (i % 2 == 0 ? 0 : 2));
+
+  // too few observations to refit
+  ObserveCosts(policy, 63, 1e-4, 1e-7);
+  CHECK(policy.SelectArm(context) == 0);
+  ObserveCosts(policy, 1, 1e-4, 1e-7);
+  CHECK(policy.SelectArm(context) == 1);
+  CHECK(policy.SelectArm(context) == 1);
+
+  // saving fits a copy, and leaves the policy as it is
+  std::ostringstream first, second;
+  policy.Save(first);
+  policy.Save(second);
+  CHECK(first.str() == second.str());
+
+  // the next refit follows the new costs
+  ObserveCosts(policy, 64, 0, 1e-4);
+  CHECK(policy.SelectArm(context) == 0);
+}
+
+// Plays [n] epochs of [policy] in [context], where the arm [best] has a mean reward of 1 and the others of 0.5, with
+// a uniform noise of +-0.1. Returns how many of the last 100 epochs picked [best].
+size_t Play(TunerPolicy &policy, const TunerContext &context, size_t best, size_t n, std::mt19937 &gen) {
+  std::uniform_real_distribution<double> noise(-0.1, 0.1);
+  size_t n_best = 0;
+  for (size_t i = 0; i < n; ++i) {
+    size_t arm = policy.SelectArm(context);
+    policy.UpdateArm(context, arm, (arm == best ? 1 : 0.5) + noise(gen));
+    if (i + 100 >= n) n_best += arm == best;
+  }
+  return n_best;
+}
+
+// The bandits settle on the arm with the best reward; the contextual bandit on the best arm of each context.
+void ArmChoice() {
+  std::mt19937 gen(42);
+  TunerContext context;
+  auto ucb = CreatePolicy(TunerType::UCB, {0, 256, 512});
+  CHECK(Play(*ucb, context, 2, 1000, gen) >= 90);
+  auto thompson = CreatePolicy(TunerType::THOMPSON, {0, 256, 512});
+  CHECK(Play(*thompson, context, 1, 1000, gen) >= 90);
+
+  // sparse chunks are best compacted, full chunks are best left alone
+  TunerContext sparse{0.1, 1}, full{0.9, 1};
+  auto contextual = CreatePolicy(TunerType::CONTEXTUAL, {0, 256, 512});
+  size_t n_sparse = 0, n_full = 0;
+  for (size_t round = 0; round < 10; ++round) {
+    n_sparse = Play(*contextual, sparse, 2, 100, gen);
+    n_full = Play(*contextual, full, 0, 100, gen);
+  }
+  CHECK(n_sparse >= 90);
+  CHECK(n_full >= 90);
+}
+
+// Plays [n] epochs of one call each on the compactor [id], and returns the merged epochs after each of them.
+vector<size_t> PlayEpochs(idx_t id, size_t n) {
+  auto &tuner = CompactTuner::Get();
+  vector<size_t> merged;
+  for (size_t i = 0; i < n; ++i) {
+    tuner.UpdateArm(id, tuner.SelectArm(id), 1);
+    merged.push_back(tuner.MergedEpochs(id));
+  }
+  return merged;
+}
+
+// Each thread tunes with its own copy of the policy, and merges its epochs into the global policy every 4 epochs.
+void LocalSync() {
+  auto &tuner = CompactTuner::Get();
+  tuner.SetEpoch(1);
+  idx_t id = tuner.Initialize(TunerType::UCB);
+
+  vector<size_t> first, second;
+  std::thread([&] { first = PlayEpochs(id, 6); }).join();
+  CHECK(first == vector<size_t>({0, 0, 0, 4, 4, 4}));
+  std::thread([&] { second = PlayEpochs(id, 6); }).join();
+  CHECK(second == vector<size_t>({4, 4, 4, 8, 8, 8}));
+
+  // saving merges the epochs of the threads since their last sync
+  TempFile file("tuner.state");
+  tuner.Save(file.Path());
+  CHECK(tuner.MergedEpochs(id) == 12);
+  tuner.Reset();
+  tuner.SetEpoch(16);
+}
+
+int main() {
+  TEST(Signatures);
+  TEST(SaveAndLoad);
+  TEST(CostModelFit);
+  TEST(ArmChoice);
+  TEST(LocalSync);
+  return Result();
+}
@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// tpch.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cmath>
+#include <sstream>
+
+#include "base.h"
+
+namespace compaction {
+
+// Plans modeled on the joins of TPC-H queries, at a scale factor: the probe table is lineitem (or orders), and the
+// hash tables are orders, customer, part and supplier (or lineitem), with the TPC-H row counts. A HashTable holds
+// synthetic tuples, so a query does not evaluate the TPC-H predicates; it reproduces their effect instead:
+//
+// - A dimension with a predicate is built with only the rows that pass it, and the probe keys are drawn from all of
+//   its keys, so the join keeps the fraction of the probe tuples that TPC-H keeps.
+// - A predicate on the probe table is a filter on a date column (in days from 1992-01-01) or a category column. The
+//   values are uniform, so "less-than" keeps the same fraction as the range of the query.
+// - The foreign keys are uniform over the keys of the dimension, e.g., 4 lineitems per order on average. lineitem
+//   also has the customer of its order (as a star schema would); it is drawn on its own, not per order.
+// - The payloads are strings of about the width of the columns the query reads from the dimension.
+//
+// The plans are plan files (see plan.h), so that they can be printed, edited and run as such.
+namespace tpch {
+// the rows of the tables at the scale factor 1
+constexpr size_t kLineitem = 6000000;
+constexpr size_t kOrders = 1500000;
+constexpr size_t kCustomer = 150000;
+constexpr size_t kPart = 200000;
+constexpr size_t kSupplier = 10000;
+// the days from 1992-01-01 to the last order date (1998-08-02), and to the last ship date (1998-12-01)
+constexpr size_t kOrderDays = 2406;
+constexpr size_t kShipDays = 2526;
+
+// [rows] at the scale factor [sf], a multiple of [multiple], and at least one [multiple]
+inline size_t Scale(double rows, double sf, size_t multiple = 1) {
+  return std::max<size_t>(1, std::llround(rows * sf / multiple)) * multiple;
+}
+
+// lineitem: l_orderkey, l_custkey, l_partkey, l_suppkey, l_shipdate, l_quantity, l_extendedprice, l_discount (percent),
+// l_returnflag, l_comment
+inline void Lineitem(std::ostream &plan, double sf) {
+  plan << "table rows=" << Scale(kLineitem, sf) << " seed=2\n"
+       << "column uniform min=0 max=" << Scale(kOrders, sf) - 1 << "\n"
+       << "column uniform min=0 max=" << Scale(kCustomer, sf) - 1 << "\n"
+       << "column uniform min=0 max=" << Scale(kPart, sf) - 1 << "\n"
+       << "column uniform min=0 max=" << Scale(kSupplier, sf) - 1 << "\n"
+       << "column uniform min=0 max=" << kShipDays - 1 << "\n"
+       << "column uniform min=1 max=50\n"
+       << "column uniform min=901 max=104950\n"
+       << "column uniform min=0 max=10\n"
+       << "column uniform min=0 max=2\n"
+       << "column string value=furiously_regular_deposits\n";
+}
+
+// Q3 (shipping priority): the revenue of the orders of BUILDING customers before 1995-03-15, with the lineitems
+// shipped after it
+inline void Q3(std::ostream &plan, double sf) {
+  Lineitem(plan, sf);
+  plan << "# o_orderdate < 1995-03-15: 1169 of the days\n"
+       << "hashtable orders rows=" << Scale(kOrders * 1169.0 / kOrderDays, sf) << " payload=8\n"
+       << "# c_mktsegment = 'BUILDING': 1 of 5 segments\n"
+       << "hashtable customer rows=" << Scale(kCustomer / 5.0, sf) << " payload=10\n"
+       << "# l_shipdate > 1995-03-15: 1357 of the days\n"
+       << "filter column=4 less-than=1357\n"
+       << "compact\n"
+       << "join orders column=0\n"
+       << "compact\n"
+       << "join customer column=1\n"
+       << "compact\n"
+       << "project #6 * (100 - #7)\n"
+       << "aggregate count,sum(14) group-by=0\n";
+}
+
+// Q4 (order priority checking): the orders of a quarter per priority, joined with their late lineitems. The join
+// returns every late lineitem of an order, rather than whether there is one.
+inline void Q4(std::ostream &plan, double sf) {
+  // o_orderkey in order: the keys 0, 4, 8, ... of the lineitem hash table
+  size_t orders = Scale(kOrders, sf);
+  plan << "table rows=" << orders << " seed=2\n"
+       << "column key min=0 max=" << 4 * (orders - 1) << " step=4 dist=constant\n"
+       << "column uniform min=0 max=" << Scale(kCustomer, sf) - 1 << "\n"
+       << "column uniform min=0 max=" << kOrderDays - 1 << "\n"
+       << "column uniform min=0 max=4\n"
+       << "column string value=pending_accounts_haggle\n"
+       << "# l_commitdate < l_receiptdate: 63% of the lineitems, modeled as the lineitems of 63% of the orders\n"
+       << "hashtable lineitem rows=" << Scale(kOrders * 0.63 * 4, sf, 4) << " chunk-factor=4 fan-out=uniform\n"
+       << "# o_orderdate in [1993-07-01, 1993-10-01): 92 of the days\n"
+       << "filter column=2 less-than=92\n"
+       << "compact\n"
+       << "join lineitem column=0\n"
+       << "compact\n"
+       << "aggregate count group-by=3\n";
+}
+
+// Q5 (local supplier volume): the revenue of 1994 of the customers and suppliers of a nation in ASIA. The suppliers
+// of the nation of the customer are modeled as 1 of 25 suppliers.
+inline void Q5(std::ostream &plan, double sf) {
+  Lineitem(plan, sf);
+  plan << "# o_orderdate in 1994: 365 of the days\n"
+       << "hashtable orders rows=" << Scale(kOrders * 365.0 / kOrderDays, sf) << " payload=8\n"
+       << "# r_name = 'ASIA': 1 of 5 regions\n"
+       << "hashtable customer rows=" << Scale(kCustomer / 5.0, sf) << " payload=10\n"
+       << "# s_nationkey = c_nationkey: 1 of 25 nations\n"
+       << "hashtable supplier rows=" << Scale(kSupplier / 25.0, sf) << " payload=10\n"
+       << "join orders column=0\n"
+       << "compact\n"
+       << "join customer column=1\n"
+       << "compact\n"
+       << "join supplier column=3\n"
+       << "compact\n"
+       << "project #6 * (100 - #7)\n"
+       << "aggregate count,sum(16) group-by=3\n";
+}
+
+// Q9 (product type profit): the revenue per ship year of the green parts, joined with their suppliers and orders
+inline void Q9(std::ostream &plan, double sf) {
+  Lineitem(plan, sf);
+  plan << "# p_name like '%green%': 5 of 92 colors\n"
+       << "hashtable part rows=" << Scale(kPart * 5.0 / 92, sf) << " payload=24\n"
+       << "hashtable supplier rows=" << Scale(kSupplier, sf) << " payload=10\n"
+       << "hashtable orders rows=" << Scale(kOrders, sf) << " payload=8\n"
+       << "join part column=2\n"
+       << "compact\n"
+       << "join supplier column=3\n"
+       << "join orders column=0\n"
+       << "project #6 * (100 - #7); #4 / 365\n"
+       << "aggregate count,sum(16) group-by=17\n";
+}
+}
+
+// the queries that TPCHPlan knows
+inline const vector<string> &TPCHQueries() {
+  static const vector<string> queries = {"q3", "q4", "q5", "q9"};
+  return queries;
+}
+
+// The plan file of the TPC-H-style [query] at the scale factor [scale_factor].
+inline string TPCHPlan(const string &query, double scale_factor) {
+  if (scale_factor <= 0) throw std::runtime_error("The scale factor must be positive");
+  std::stringstream plan;
+  plan << "# TPC-H-style " << query << " at the scale factor " << scale_factor << "\n";
+  if (query == "q3") tpch::Q3(plan, scale_factor);
+  else if (query == "q4") tpch::Q4(plan, scale_factor);
+  else if (query == "q5") tpch::Q5(plan, scale_factor);
+  else if (query == "q9") tpch::Q9(plan, scale_factor);
+  else throw std::runtime_error("Unknown TPC-H query: " + query + " (q3, q4, q5, or q9)");
+  return plan.str();
+}
+}
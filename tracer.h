@@ -0,0 +1,148 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// tracer.h
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <fstream>
+#include <mutex>
+
+#include "base.h"
+#include "profiler.h"
+
+namespace compaction {
+
+// Records a timeline of the pipeline execution, and writes it in the Chrome trace-event format (chrome://tracing or
+// https://ui.perfetto.dev). Each operator invocation is a begin/end pair that carries its pipeline level, the input
+// and output chunk sizes, and the compaction threshold.
+//
+// Each thread writes into its own ring buffer without locks. A buffer starts small and doubles up to its capacity; once
+// it is full, the oldest events are overwritten.
+class Tracer {
+ public:
+  // the value of a missing argument
+  static constexpr uint32_t kNone = UINT32_MAX;
+
+  static Tracer &Get() {
+    static Tracer instance;
+    return instance;
+  }
+
+  // Must be called before any thread starts tracing. [capacity] is the most events kept per thread.
+  inline void Enable(const string &path, size_t capacity = 1 << 20) {
+    path_ = path;
+    capacity_ = std::max(capacity, size_t(2));
+    enabled_ = true;
+  }
+
+  inline bool Enabled() const { return enabled_; }
+
+  // [name] must be a string literal: only the pointer is kept.
+  inline void Begin(const char *name, size_t level, size_t n_input, size_t threshold = kNone) {
+    if (enabled_) Local().Push({name, Now(), uint32_t(level), uint32_t(n_input), kNone, uint32_t(threshold), 'B'});
+  }
+
+  inline void End(const char *name, size_t level, size_t n_output = kNone) {
+    if (enabled_) Local().Push({name, Now(), uint32_t(level), kNone, uint32_t(n_output), kNone, 'E'});
+  }
+
+  // An event without duration, e.g., a tuner decision.
+  inline void Instant(const char *name, size_t level, size_t threshold) {
+    if (enabled_) Local().Push({name, Now(), uint32_t(level), kNone, kNone, uint32_t(threshold), 'i'});
+  }
+
+  // Writes the events of all threads. Must be called when no thread is tracing.
+  inline void ToJSON() {
+    if (!enabled_) return;
+    lock_guard<mutex> lock(mutex_);
+
+    std::ofstream out(path_);
+    if (!out.is_open()) throw std::runtime_error("Unable to open file " + path_);
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    bool first = true;
+    for (size_t tid = 0; tid < buffers_.size(); ++tid) {
+      auto &buffer = *buffers_[tid];
+      size_t n_event = std::min(buffer.n_push_, buffer.events_.size());
+      size_t start = buffer.n_push_ - n_event;
+      // the 'B' events that are not ended yet. An 'E' without one lost its 'B' to the wrap-around, and is dropped.
+      size_t depth = 0;
+      for (size_t i = start; i < buffer.n_push_; ++i) {
+        auto &event = buffer.events_[i % buffer.events_.size()];
+        if (event.phase_ == 'B') {
+          depth++;
+        } else if (event.phase_ == 'E') {
+          if (depth == 0) continue;
+          depth--;
+        }
+        out << (first ? "\n" : ",\n") << "{\"name\": \"" << event.name_ << "\", \"ph\": \"" << event.phase_
+            << "\", \"ts\": " << std::fixed << (event.ts_ - base_ts_) / 1e3 << ", \"pid\": 0, \"tid\": " << tid;
+        if (event.phase_ == 'i') out << ", \"s\": \"t\"";
+        out << ", \"args\": {\"level\": " << event.level_;
+        if (event.n_input_ != kNone) out << ", \"input\": " << event.n_input_;
+        if (event.n_output_ != kNone) out << ", \"output\": " << event.n_output_;
+        if (event.threshold_ != kNone) out << ", \"threshold\": " << event.threshold_;
+        out << "}}";
+        first = false;
+      }
+    }
+    out << "\n]}\n";
+  }
+
+ private:
+  struct TraceEvent {
+    const char *name_;
+    double ts_;  // in ns
+    uint32_t level_;
+    uint32_t n_input_;
+    uint32_t n_output_;
+    uint32_t threshold_;
+    char phase_;
+  };
+
+  // the events a buffer has room for at first
+  static constexpr size_t kInitialEvents = 4096;
+
+  struct RingBuffer {
+    vector<TraceEvent> events_;
+    size_t capacity_;
+    size_t n_push_ = 0;
+
+    explicit RingBuffer(size_t capacity) : capacity_(capacity) { events_.reserve(std::min(capacity, kInitialEvents)); }
+
+    // Until the buffer is full, events_ holds the events in order; then event n is at n % capacity_.
+    inline void Push(const TraceEvent &event) {
+      if (events_.size() < capacity_) events_.push_back(event);
+      else events_[n_push_ % capacity_] = event;
+      n_push_++;
+    }
+  };
+
+  Tracer() : base_ts_(Now()) {}
+
+  static inline double Now() { return CycleClock::now().time_since_epoch().count(); }
+
+  inline RingBuffer &Local() {
+    thread_local RingBuffer *local = nullptr;
+    if (local == nullptr) {
+      // The buffers outlive the threads, so that they can be written after the threads have finished.
+      auto buffer = std::make_unique<RingBuffer>(capacity_);
+      local = buffer.get();
+      lock_guard<mutex> lock(mutex_);
+      buffers_.push_back(std::move(buffer));
+    }
+    return *local;
+  }
+
+  bool enabled_ = false;
+  string path_;
+  size_t capacity_ = 1 << 20;
+  double base_ts_;
+
+  mutex mutex_;
+  vector<unique_ptr<RingBuffer>> buffers_;
+};
+}
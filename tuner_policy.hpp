@@ -0,0 +1,96 @@
+//===----------------------------------------------------------------------===//
+//                         Compaction
+//
+// tuner_policy.hpp
+//
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace compaction {
+
+// The policies that can pick the threshold of a dynamic compactor.
+enum class TunerType : uint8_t {
+  UCB = 0,
+  THOMPSON = 1,
+  CONTEXTUAL = 2,
+  COST_MODEL = 3
+};
+
+inline std::string TunerName(TunerType type) {
+  switch (type) {
+    case TunerType::UCB: return "ucb";
+    case TunerType::THOMPSON: return "thompson";
+    case TunerType::CONTEXTUAL: return "contextual";
+    case TunerType::COST_MODEL: return "cost_model";
+  }
+  return "unknown";
+}
+
+// What the tuner observed in the last epoch, at the operator in front of the compactor.
+struct TunerContext {
+  // average input chunk size / kBlockSize
+  double fullness_ = 1;
+  // output tuples / input tuples
+  double fan_out_ = 1;
+};
+
+// A policy picks one of the arms (compaction thresholds) for an epoch, and learns from the reward of the epoch.
+class TunerPolicy {
+ public:
+  virtual ~TunerPolicy() = default;
+
+  virtual size_t SelectArm(const TunerContext &context) = 0;
+
+  virtual void UpdateArm(const TunerContext &context, size_t arm, double reward) = 0;
+
+  // An epoch that another thread played with [arm]: account the selection, then learn from the reward.
+  virtual void Replay(const TunerContext &context, size_t arm, double reward) { UpdateArm(context, arm, reward); }
+
+  virtual std::unique_ptr<TunerPolicy> Clone() const = 0;
+
+  // Policies that model the costs instead of the rewards need to see each chunk.
+  virtual bool ObserveCosts() const { return false; }
+
+  // A chunk of [n_tuples] arrives at the compactor.
+  virtual void ObserveChunk(size_t /*n_tuples*/) {}
+
+  // The compactor copies a chunk of [n_tuples] into its cache.
+  virtual void ObserveCompact(size_t /*n_tuples*/, double /*time*/) {}
+
+  // The rest of the pipeline processes a chunk of [n_tuples].
+  virtual void ObserveDownstream(size_t /*n_tuples*/, double /*time*/) {}
+
+  virtual void Print(const std::vector<size_t> &values) = 0;
+
+  virtual void Log2Csv(std::string /*addr*/) {}
+
+  // The learned state, as whitespace-separated tokens, so that a later run can start from it.
+  virtual void Save(std::ostream &out) const = 0;
+
+  // Loads a saved state, and shortens the exploration. Returns false if the state does not fit this policy.
+  virtual bool Load(std::istream &in) = 0;
+};
+
+template<typename T>
+inline void SaveVector(std::ostream &out, const std::vector<T> &values) {
+  out << values.size();
+  for (auto &value : values) out << ' ' << value;
+  out << ' ';
+}
+
+template<typename T>
+inline bool LoadVector(std::istream &in, std::vector<T> &values) {
+  size_t size;
+  if (!(in >> size) || size != values.size()) return false;
+  for (auto &value : values) in >> value;
+  return bool(in);
+}
+}